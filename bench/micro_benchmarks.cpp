@@ -0,0 +1,310 @@
+/**
+* Microbenchmarks for the primitives on the request path: object pool,
+* MPSC queue, request decode and ack/error/result formatting, each next to a
+* plain reference (new/delete, mutex + deque, fmt::format_to).
+*
+* Build with -DENABLE_MICROBENCH=ON; `cmake --build . --target bench` runs
+* the suite and writes bench_results.json (diff two runs with Google
+* Benchmark's tools/compare.py).
+*/
+#include "headers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    template<size_t N>
+    struct Obj
+    {
+        std::byte bytes[N];
+    };
+
+    template<size_t N>
+    LockFreeObjectPool<Obj<N>>& shared_pool()
+    {
+        static LockFreeObjectPool<Obj<N>> pool(4096);
+        return pool;
+    }
+
+    // acquire/release `batch` objects per iteration on every thread
+    template<size_t N>
+    void BM_Pool_AcquireRelease(benchmark::State& state)
+    {
+        auto& pool = shared_pool<N>();
+        ThreadLocalPoolGuard guard(pool);
+        std::vector<Obj<N>*> held((size_t)state.range(0));
+        for (auto _ : state)
+        {
+            for (auto& p : held) p = pool.acquire();
+            benchmark::DoNotOptimize(held.data());
+            for (auto* p : held) pool.release(p);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template<size_t N>
+    void BM_NewDelete(benchmark::State& state)
+    {
+        std::vector<Obj<N>*> held((size_t)state.range(0));
+        for (auto _ : state)
+        {
+            for (auto& p : held) p = new Obj<N>;
+            benchmark::DoNotOptimize(held.data());
+            for (auto* p : held) delete p;
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+#define POOL_BENCHMARK(fn, size) \
+    BENCHMARK_TEMPLATE(fn, size)->Arg(1)->Arg(64)->ThreadRange(1, 8)->UseRealTime()
+
+    POOL_BENCHMARK(BM_Pool_AcquireRelease, 16);
+    POOL_BENCHMARK(BM_Pool_AcquireRelease, 64);
+    POOL_BENCHMARK(BM_Pool_AcquireRelease, 256);
+    POOL_BENCHMARK(BM_Pool_AcquireRelease, 1024);
+    POOL_BENCHMARK(BM_NewDelete, 16);
+    POOL_BENCHMARK(BM_NewDelete, 64);
+    POOL_BENCHMARK(BM_NewDelete, 256);
+    POOL_BENCHMARK(BM_NewDelete, 1024);
+
+    // reference: what MpscQueue replaces
+    template<typename T>
+    class MutexQueue
+    {
+        std::mutex m_mutex;
+        std::deque<T> m_items;
+    public:
+        void push(T&& item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back(std::move(item));
+        }
+        std::optional<T> pop()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_items.empty()) return std::nullopt;
+            std::optional<T> item(std::move(m_items.front()));
+            m_items.pop_front();
+            return item;
+        }
+    };
+
+    template<typename Q>
+    Q& shared_queue()
+    {
+        static Q queue;
+        return queue;
+    }
+
+    // thread 0 consumes, the other threads produce; the consumer pops one
+    // item per producer per iteration so pushes and pops stay balanced
+    template<typename Q>
+    void BM_Queue_PushPop(benchmark::State& state)
+    {
+        auto& queue = shared_queue<Q>();
+        const int producers = state.threads() - 1;
+        if (state.thread_index() == 0)
+        {
+            for (auto _ : state)
+            {
+                for (int n = 0; n < producers; )
+                {
+                    if (auto item = queue.pop())
+                    {
+                        benchmark::DoNotOptimize(*item);
+                        ++n;
+                    }
+                }
+            }
+        }
+        else
+        {
+            uint64_t value = 0;
+            for (auto _ : state)
+                queue.push(uint64_t(value++));
+            state.SetItemsProcessed(state.iterations());
+        }
+    }
+
+    BENCHMARK_TEMPLATE(BM_Queue_PushPop, MpscQueue<uint64_t>)->DenseThreadRange(2, 9, 1)->UseRealTime();
+    BENCHMARK_TEMPLATE(BM_Queue_PushPop, MutexQueue<uint64_t>)->DenseThreadRange(2, 9, 1)->UseRealTime();
+
+    zmq::message_t make_frame(MethodID mid, size_t payload_size)
+    {
+        zmq::message_t msg(sizeof(ParamsBase) + payload_size);
+        const ParamsBase header { 42, (TMethodID)mid };
+        std::memcpy(msg.data(), &header, sizeof(header));
+        std::memset(static_cast<char*>(msg.data()) + sizeof(header), 'x', payload_size);
+        return msg;
+    }
+
+    // decode of a received frame; includes taking a copy of the frame
+    // (refcounted above 33 bytes, inline below) to stand in for recv()
+    template<MethodID MID>
+    void BM_Decode(benchmark::State& state)
+    {
+        const size_t payload_size = MID == MethodID::GStreamer_Pipeline_Start ? (size_t)state.range(0) : sizeof(TPipelineID);
+        zmq::message_t frame = make_frame(MID, payload_size);
+        for (auto _ : state)
+        {
+            zmq::message_t msg;
+            msg.copy(frame);
+            auto params = decode_params<MID>(std::move(msg));
+            benchmark::DoNotOptimize(params);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK_TEMPLATE(BM_Decode, MethodID::GStreamer_Pipeline_Start)->Arg(16)->Arg(256)->Arg(4096);
+    BENCHMARK_TEMPLATE(BM_Decode, MethodID::GStreamer_Pipeline_Stop)->Arg(0);
+    BENCHMARK_TEMPLATE(BM_Decode, MethodID::GStreamer_Pipeline_Pause)->Arg(0);
+    BENCHMARK_TEMPLATE(BM_Decode, MethodID::GStreamer_Pipeline_Resume)->Arg(0);
+
+    // splitting an rpc.batch frame of range(0) Stop records, each taking a
+    // reference counted share of the frame
+    void BM_DecodeBatch(benchmark::State& state)
+    {
+        const size_t count = (size_t)state.range(0);
+        const size_t recordSize = sizeof(ParamsBase) + sizeof(TPipelineID);
+        zmq::message_t frame(sizeof(ParamsBase) + sizeof(TBatchCount) + count * (sizeof(TRecordSize) + recordSize));
+        char* pData = static_cast<char*>(frame.data());
+        const ParamsBase header { 42, (TMethodID)MethodID::RPC_Batch };
+        const TBatchCount nRecords = (TBatchCount)count;
+        std::memcpy(pData, &header, sizeof(header));
+        std::memcpy(pData + sizeof(header), &nRecords, sizeof(nRecords));
+        pData += sizeof(header) + sizeof(nRecords);
+        for (size_t i = 0; i < count; ++i, pData += sizeof(TRecordSize) + recordSize)
+        {
+            const TRecordSize size = (TRecordSize)recordSize;
+            const ParamsBase record { i + 1, (TMethodID)MethodID::GStreamer_Pipeline_Stop };
+            const TPipelineID pipeline_id = (TPipelineID)i;
+            std::memcpy(pData, &size, sizeof(size));
+            std::memcpy(pData + sizeof(size), &record, sizeof(record));
+            std::memcpy(pData + sizeof(size) + sizeof(record), &pipeline_id, sizeof(pipeline_id));
+        }
+
+        std::vector<std::string_view> records;
+        for (auto _ : state)
+        {
+            decode_batch(frame.to_string_view(), records);
+            for (std::string_view record : records)
+            {
+                zmq::message_t shared;
+                shared.copy(frame);
+                auto params = decode_params<MethodID::GStreamer_Pipeline_Stop>(std::move(shared), record);
+                benchmark::DoNotOptimize(params);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_DecodeBatch)->Arg(1)->Arg(16)->Arg(256);
+
+    void BM_FormatAck(benchmark::State& state)
+    {
+        TReqID req_id = 0x123456789abcdef0;
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            jsonrpc::write_ack(buf, req_id++);
+            benchmark::DoNotOptimize(buf.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_FormatAck);
+
+    // reference: the fmt::format_to based formatting the writer replaced
+    void BM_FormatAck_Fmt(benchmark::State& state)
+    {
+        TReqID req_id = 0x123456789abcdef0;
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            fmt::format_to(std::back_inserter(buf), R"({{"jsonrpc":"2.0","ack":1,"id":{}}})", req_id++);
+            benchmark::DoNotOptimize(buf.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_FormatAck_Fmt);
+
+    // ack formatting plus the zero-copy hand over to a ZMQ message and its release
+    void BM_FormatAck_ToMessage(benchmark::State& state)
+    {
+        TReqID req_id = 0x123456789abcdef0;
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            jsonrpc::write_ack(buf, req_id++);
+            zmq::message_t msg = std::move(buf).to_message();
+            benchmark::DoNotOptimize(msg.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_FormatAck_ToMessage);
+
+    // hand over of a reply of range(0) bytes: inline up to SlabBuffer::MAX_INLINE_SIZE,
+    // zero-copy (plus libzmq's content_t allocation) above
+    void BM_ToMessage(benchmark::State& state)
+    {
+        const std::string bytes((size_t)state.range(0), 'x');
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            buf.append(bytes);
+            zmq::message_t msg = std::move(buf).to_message();
+            benchmark::DoNotOptimize(msg.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_ToMessage)->Arg(16)->Arg(SlabBuffer::MAX_INLINE_SIZE)->Arg(64)->Arg(256)->Arg(4096);
+
+    void BM_FormatError(benchmark::State& state)
+    {
+        TReqID req_id = 0x123456789abcdef0;
+        const zmq::error_t err(EAGAIN);
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            jsonrpc::write_error(buf, req_id++, err.num(), err.what());
+            benchmark::DoNotOptimize(buf.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_FormatError);
+
+    // error message that needs escaping; range(0) is its length
+    void BM_FormatError_Escaped(benchmark::State& state)
+    {
+        std::string message((size_t)state.range(0), 'a');
+        for (size_t i = 0; i < message.size(); i += 32) message[i] = '"';
+        TReqID req_id = 0x123456789abcdef0;
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            jsonrpc::write_error(buf, req_id++, jsonrpc::INTERNAL_ERROR, message);
+            benchmark::DoNotOptimize(buf.data());
+        }
+        state.SetBytesProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_FormatError_Escaped)->Arg(16)->Arg(256)->Arg(4096);
+
+    void BM_FormatResult(benchmark::State& state)
+    {
+        TReqID req_id = 0x123456789abcdef0;
+        const Result<MethodID::GStreamer_Pipeline_Start> result { 42 };
+        for (auto _ : state)
+        {
+            SlabBuffer buf;
+            jsonrpc::write_result(buf, req_id++, result);
+            benchmark::DoNotOptimize(buf.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_FormatResult);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,509 @@
+/**
+* zmq-dispatch-bench: open-loop load generator for zmq-task-dispatcher.
+*
+* Sends binary ParamsBase requests at a fixed rate, regardless of how fast
+* the server answers, and correlates the JSON-RPC acks and results by req_id.
+* Latencies are measured from the *intended* send time of each request, so a
+* stalled server (or a stalled sender) shows up in the percentiles instead of
+* silently lowering the offered load (coordinated omission). The uncorrected
+* numbers, measured from the actual send time, are reported next to them.
+*
+* With --transport inproc the dispatcher runs embedded in this process
+* (DispatcherServer on its own thread), which takes the network out of the
+* measurement.
+*
+* --busy-poll US runs the embedded dispatcher in the hybrid spin-then-block
+* ingress mode, --worker-publish in the direct (per worker) publishing mode.
+*
+* With --batch N, every N consecutive requests go out as one rpc.batch frame
+* when the last of them is due, and are acked by one batch ack.
+*
+* Usage:
+*   zmq-dispatch-bench [--transport tcp|ipc|inproc] [--host localhost]
+*                      [--cmd <endpoint>] [--pub <endpoint>]
+*                      [--rate 10000] [--duration 10] [--warmup 1] [--drain-ms 2000]
+*                      [--mix start:1,stop:1] [--payload 64 | 16-1024] [--batch 1] [--seed 1] [--json]
+*                      [--busy-poll 0] [--worker-publish]
+*/
+#include "headers.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <memory>
+#include <charconv>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr size_t NUM_METHODS = (size_t)MethodID::Unknown;
+    constexpr TReqID PROBE_ID_BASE = TReqID(1) << 62;   // ids used before the measured run
+    constexpr TReqID BATCH_ID_BASE = TReqID(1) << 61;   // batch id = BATCH_ID_BASE + index of its first request
+
+    struct Options
+    {
+        std::string transport = "tcp";
+        std::string host = "localhost";
+        std::string cmdEndpoint;    // server SUB socket (we publish requests to it)
+        std::string pubEndpoint;    // server PUB socket (we receive acks/results)
+        double rate = 10000;        // requests per second
+        double duration = 10;       // measured seconds
+        double warmup = 1;          // seconds sent before the measurement starts
+        int drainMs = 2000;         // time to wait for outstanding results
+        std::vector<std::pair<MethodID, unsigned>> mix { { MethodID::GStreamer_Pipeline_Start, 1 } };
+        size_t payloadMin = 64;
+        size_t payloadMax = 64;
+        size_t batch = 1;           // requests per frame
+        int64_t busyPollUs = 0;     // inproc: the embedded dispatcher's spin budget
+        bool workerPublish = false; // inproc: the embedded dispatcher publishes from the workers
+        uint64_t seed = 1;
+        bool json = false;
+    };
+
+    // one planned request; the schedule is generated before the run
+    struct Planned
+    {
+        MethodID method;
+        uint32_t payloadSize;
+    };
+
+    struct Results
+    {
+        metrics::Histogram ackCorrected, ackRaw;
+        metrics::Histogram resultCorrected, resultRaw;
+        metrics::Histogram perMethod[NUM_METHODS];   // corrected result latency
+        uint64_t acks = 0, results = 0, errors = 0, unknown = 0;
+    };
+
+    [[noreturn]] void usage(const char* szError)
+    {
+        std::cerr << "zmq-dispatch-bench: " << szError << "\n"
+            << "usage: zmq-dispatch-bench [--transport tcp|ipc|inproc] [--host H] [--cmd EP] [--pub EP]\n"
+            << "                          [--rate N] [--duration S] [--warmup S] [--drain-ms MS]\n"
+            << "                          [--mix name:weight,...] [--payload N|MIN-MAX] [--batch N] [--seed N] [--json]\n"
+            << "                          [--busy-poll US] [--worker-publish]\n";
+        std::exit(2);
+    }
+
+    // accepts the method name or its last word, case-insensitively ("GStreamer_Pipeline_Start", "start"), or the numeric id
+    MethodID parse_method(std::string_view name)
+    {
+        auto iequals = [](std::string_view a, std::string_view b) {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+                [](char x, char y) { return std::tolower((unsigned char)x) == std::tolower((unsigned char)y); });
+        };
+        for (TMethodID mid = 0; mid < NUM_METHODS; ++mid)
+        {
+            const std::string_view full = method_name((MethodID)mid);
+            const size_t sep = full.find_last_of("_.");
+            if (iequals(name, full) || (sep != std::string_view::npos && iequals(name, full.substr(sep + 1))))
+                return (MethodID)mid;
+        }
+        unsigned id = 0;
+        auto [p, ec] = std::from_chars(name.data(), name.data() + name.size(), id);
+        if (ec == std::errc {} && p == name.data() + name.size() && id < NUM_METHODS)
+            return (MethodID)id;
+        usage("unknown method in --mix");
+    }
+
+    template<typename T>
+    T parse_number(std::string_view s, const char* szWhat)
+    {
+        T v {};
+        auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (ec != std::errc {} || p != s.data() + s.size()) usage(szWhat);
+        return v;
+    }
+
+    Options parse_options(int argc, char** argv)
+    {
+        Options opt;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            auto next = [&]() -> std::string_view {
+                if (i + 1 >= argc) usage("missing option value");
+                return argv[++i];
+            };
+            if (arg == "--transport") opt.transport = next();
+            else if (arg == "--host") opt.host = next();
+            else if (arg == "--cmd") opt.cmdEndpoint = next();
+            else if (arg == "--pub") opt.pubEndpoint = next();
+            else if (arg == "--rate") opt.rate = parse_number<double>(next(), "bad --rate");
+            else if (arg == "--duration") opt.duration = parse_number<double>(next(), "bad --duration");
+            else if (arg == "--warmup") opt.warmup = parse_number<double>(next(), "bad --warmup");
+            else if (arg == "--drain-ms") opt.drainMs = parse_number<int>(next(), "bad --drain-ms");
+            else if (arg == "--worker-publish") opt.workerPublish = true;
+            else if (arg == "--busy-poll") opt.busyPollUs = parse_number<int64_t>(next(), "bad --busy-poll");
+            else if (arg == "--batch") opt.batch = parse_number<size_t>(next(), "bad --batch");
+            else if (arg == "--seed") opt.seed = parse_number<uint64_t>(next(), "bad --seed");
+            else if (arg == "--json") opt.json = true;
+            else if (arg == "--payload")
+            {
+                const std::string_view v = next();
+                const size_t dash = v.find('-');
+                opt.payloadMin = parse_number<size_t>(v.substr(0, dash), "bad --payload");
+                opt.payloadMax = dash == std::string_view::npos ? opt.payloadMin : parse_number<size_t>(v.substr(dash + 1), "bad --payload");
+                if (opt.payloadMax < opt.payloadMin) usage("bad --payload range");
+            }
+            else if (arg == "--mix")
+            {
+                opt.mix.clear();
+                std::string_view list = next();
+                while (!list.empty())
+                {
+                    const size_t comma = list.find(',');
+                    const std::string_view item = list.substr(0, comma);
+                    list = comma == std::string_view::npos ? std::string_view {} : list.substr(comma + 1);
+                    const size_t colon = item.find(':');
+                    const unsigned weight = colon == std::string_view::npos ? 1 : parse_number<unsigned>(item.substr(colon + 1), "bad --mix weight");
+                    if (weight) opt.mix.emplace_back(parse_method(item.substr(0, colon)), weight);
+                }
+                if (opt.mix.empty()) usage("empty --mix");
+            }
+            else usage("unknown option");
+        }
+        if (opt.rate <= 0 || opt.duration <= 0 || opt.warmup < 0) usage("rate and duration must be positive");
+        if (opt.batch == 0) usage("--batch must be at least 1");
+
+        if (opt.transport == "tcp")
+        {
+            if (opt.cmdEndpoint.empty()) opt.cmdEndpoint = "tcp://" + opt.host + ":5555";
+            if (opt.pubEndpoint.empty()) opt.pubEndpoint = "tcp://" + opt.host + ":5556";
+        }
+        else if (opt.transport == "ipc")
+        {
+            if (opt.cmdEndpoint.empty()) opt.cmdEndpoint = "ipc:///tmp/zmq-task-dispatcher-cmd";
+            if (opt.pubEndpoint.empty()) opt.pubEndpoint = "ipc:///tmp/zmq-task-dispatcher-pub";
+        }
+        else if (opt.transport == "inproc")
+        {
+            // inproc endpoints only exist inside one context: the dispatcher runs in this process
+            if (opt.cmdEndpoint.empty()) opt.cmdEndpoint = "inproc://zmq-task-dispatcher-cmd";
+            if (opt.pubEndpoint.empty()) opt.pubEndpoint = "inproc://zmq-task-dispatcher-pub";
+        }
+        else usage("unknown --transport");
+        return opt;
+    }
+
+    std::vector<Planned> make_schedule(const Options& opt, size_t count)
+    {
+        std::mt19937_64 rng(opt.seed);
+        std::vector<unsigned> weights;
+        for (const auto& [mid, w] : opt.mix) weights.push_back(w);
+        std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+        std::uniform_int_distribution<size_t> size(opt.payloadMin, opt.payloadMax);
+
+        std::vector<Planned> schedule(count);
+        for (Planned& p : schedule)
+        {
+            p.method = opt.mix[pick(rng)].first;
+            // the pipeline id methods carry a fixed TPipelineID payload
+            p.payloadSize = p.method == MethodID::GStreamer_Pipeline_Start ? (uint32_t)size(rng) : (uint32_t)sizeof(TPipelineID);
+        }
+        return schedule;
+    }
+
+    zmq::message_t make_request(TReqID req_id, const Planned& p)
+    {
+        zmq::message_t msg(sizeof(ParamsBase) + p.payloadSize);
+        char* pData = static_cast<char*>(msg.data());
+        const ParamsBase header { req_id, (TMethodID)p.method };
+        std::memcpy(pData, &header, sizeof(header));
+        if (p.method == MethodID::GStreamer_Pipeline_Start)
+            std::memset(pData + sizeof(header), 'x', p.payloadSize);
+        else
+        {
+            const TPipelineID pipeline_id = (TPipelineID)req_id;
+            std::memcpy(pData + sizeof(header), &pipeline_id, sizeof(pipeline_id));
+        }
+        return msg;
+    }
+
+    // one rpc.batch frame for the requests [first, first + count)
+    zmq::message_t make_batch(size_t first, size_t count, const std::vector<Planned>& schedule)
+    {
+        size_t size = sizeof(ParamsBase) + sizeof(TBatchCount);
+        for (size_t idx = first; idx < first + count; ++idx)
+            size += sizeof(TRecordSize) + sizeof(ParamsBase) + schedule[idx].payloadSize;
+
+        zmq::message_t msg(size);
+        char* pData = static_cast<char*>(msg.data());
+        const ParamsBase header { BATCH_ID_BASE + first, (TMethodID)MethodID::RPC_Batch };
+        const TBatchCount nRecords = (TBatchCount)count;
+        std::memcpy(pData, &header, sizeof(header));
+        std::memcpy(pData + sizeof(header), &nRecords, sizeof(nRecords));
+        pData += sizeof(header) + sizeof(nRecords);
+        for (size_t idx = first; idx < first + count; ++idx)
+        {
+            const zmq::message_t record = make_request(idx + 1, schedule[idx]);
+            const TRecordSize recordSize = (TRecordSize)record.size();
+            std::memcpy(pData, &recordSize, sizeof(recordSize));
+            std::memcpy(pData + sizeof(recordSize), record.data(), record.size());
+            pData += sizeof(recordSize) + record.size();
+        }
+        return msg;
+    }
+
+    enum class ReplyKind { Ack, Result, Error, Other };
+
+    // the server replies with compact JSON-RPC frames; only the id and the kind are needed
+    ReplyKind parse_reply(std::string_view frame, TReqID& req_id)
+    {
+        const size_t pos = frame.find(R"("id":)");
+        if (pos == std::string_view::npos) return ReplyKind::Other;
+        const char* p = frame.data() + pos + 5;
+        if (std::from_chars(p, frame.data() + frame.size(), req_id).ec != std::errc {}) return ReplyKind::Other;
+        if (frame.find(R"("ack")") != std::string_view::npos) return ReplyKind::Ack;
+        if (frame.find(R"("error")") != std::string_view::npos) return ReplyKind::Error;
+        if (frame.find(R"("result")") != std::string_view::npos) return ReplyKind::Result;
+        return ReplyKind::Other;
+    }
+
+    // sends probes until the server answers, so the SUB subscription is in place
+    bool wait_for_server(zmq::socket_t& pub, zmq::socket_t& sub)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        for (TReqID probe = PROBE_ID_BASE; std::chrono::steady_clock::now() < deadline; ++probe)
+        {
+            zmq::message_t msg(sizeof(ParamsBase));
+            const ParamsBase header { probe, (TMethodID)MethodID::RPC_Stats };
+            std::memcpy(msg.data(), &header, sizeof(header));
+            pub.send(std::move(msg), zmq::send_flags::none);
+
+            std::vector<zmq::pollitem_t> items = { { sub, 0, ZMQ_POLLIN, 0 } };
+            zmq::poll(items, std::chrono::milliseconds(200));
+            zmq::message_t reply;
+            while (sub.recv(reply, zmq::recv_flags::dontwait))
+            {
+                TReqID id = 0;
+                if (parse_reply(reply.to_string_view(), id) != ReplyKind::Other && id >= PROBE_ID_BASE)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    struct Summary
+    {
+        metrics::HistogramSnapshot snap;
+        explicit Summary(const metrics::Histogram& h) { snap.merge(h); }
+    };
+
+    void print_line(std::string_view name, const metrics::Histogram& h)
+    {
+        const Summary s(h);
+        auto us = [](uint64_t ns) { return (double)ns / 1000.0; };
+        fmt::print("  {:<28} n={:<9} p50={:>9.1f} p90={:>9.1f} p99={:>9.1f} p99.9={:>9.1f} p99.99={:>9.1f} max={:>9.1f} us\n",
+            name, s.snap.count, us(s.snap.percentile(50)), us(s.snap.percentile(90)), us(s.snap.percentile(99)),
+            us(s.snap.percentile(99.9)), us(s.snap.percentile(99.99)), us(s.snap.max));
+    }
+
+    void print_json_latency(std::string& out, std::string_view name, const metrics::Histogram& h)
+    {
+        const Summary s(h);
+        fmt::format_to(std::back_inserter(out),
+            R"("{}":{{"count":{},"p50_us":{:.1f},"p90_us":{:.1f},"p99_us":{:.1f},"p999_us":{:.1f},"p9999_us":{:.1f},"max_us":{:.1f}}})",
+            name, s.snap.count, s.snap.percentile(50) / 1000.0, s.snap.percentile(90) / 1000.0, s.snap.percentile(99) / 1000.0,
+            s.snap.percentile(99.9) / 1000.0, s.snap.percentile(99.99) / 1000.0, s.snap.max / 1000.0);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const Options opt = parse_options(argc, argv);
+
+    const size_t nWarmup = (size_t)(opt.rate * opt.warmup);
+    const size_t nTotal = nWarmup + (size_t)(opt.rate * opt.duration);
+    const std::vector<Planned> schedule = make_schedule(opt, nTotal);
+    const double periodNs = 1e9 / opt.rate;
+
+    zmq::context_t ctx { 1 };
+
+    std::unique_ptr<DispatcherServer> pServer;
+    std::thread serverThread;
+    if (opt.transport == "inproc")
+    {
+        pServer = std::make_unique<DispatcherServer>(ctx, DispatcherServer::Options {
+            .cmd_address = opt.cmdEndpoint, .pub_address = opt.pubEndpoint, .busy_poll_us = opt.busyPollUs, .worker_publish = opt.workerPublish });
+        serverThread = std::thread([&] { pServer->run(); });
+    }
+    auto stop_server = [&] {
+        if (!pServer) return;
+        pServer->stop();
+        serverThread.join();
+        pServer.reset();
+    };
+
+    zmq::socket_t pub(ctx, ZMQ_PUB);
+    pub.set(zmq::sockopt::sndhwm, 0);      // never drop on our side; overload shows up as server drops
+    pub.set(zmq::sockopt::linger, 0);
+    pub.connect(opt.cmdEndpoint);
+
+    zmq::socket_t sub(ctx, ZMQ_SUB);
+    sub.set(zmq::sockopt::rcvhwm, 0);
+    sub.set(zmq::sockopt::rcvbuf, 4 * 1024 * 1024);
+    sub.set(zmq::sockopt::linger, 0);
+    sub.set(zmq::sockopt::subscribe, "");
+    sub.connect(opt.pubEndpoint);
+
+    if (!wait_for_server(pub, sub))
+    {
+        std::cerr << "No reply from the server on " << opt.cmdEndpoint << " / " << opt.pubEndpoint << std::endl;
+        stop_server();
+        return 1;
+    }
+
+    // req_id = index + 1; the send time is published per request for the raw latency
+    std::vector<std::atomic<uint64_t>> sentAt(nTotal);
+    std::vector<uint8_t> acked(nTotal), answered(nTotal);
+    std::atomic<size_t> nSent { 0 };
+    std::atomic<bool> bSendDone { false };
+    const uint64_t t0 = metrics::now_ns() + 10'000'000;   // start 10 ms from now
+    auto intended_at = [&](size_t idx) { return t0 + (uint64_t)((double)idx * periodNs); };
+
+    Results res;
+    std::thread receiver([&] {
+        std::vector<zmq::pollitem_t> items = { { sub, 0, ZMQ_POLLIN, 0 } };
+        uint64_t drainDeadline = 0;
+        size_t nOutstanding = nTotal;
+        while (nOutstanding)
+        {
+            zmq::poll(items, std::chrono::milliseconds(50));
+            zmq::message_t reply;
+            while (sub.recv(reply, zmq::recv_flags::dontwait))
+            {
+                const uint64_t now = metrics::now_ns();
+                auto on_ack = [&](size_t idx) {
+                    if (acked[idx]) return;
+                    acked[idx] = 1;
+                    ++res.acks;
+                    if (idx >= nWarmup)
+                    {
+                        res.ackCorrected.record(now - intended_at(idx));
+                        res.ackRaw.record(now - sentAt[idx].load(std::memory_order_relaxed));
+                    }
+                };
+                TReqID req_id = 0;
+                const ReplyKind kind = parse_reply(reply.to_string_view(), req_id);
+                if (kind == ReplyKind::Ack && req_id >= BATCH_ID_BASE && req_id < BATCH_ID_BASE + nTotal)
+                {
+                    // one ack for all requests of the batch
+                    const size_t first = req_id - BATCH_ID_BASE;
+                    for (size_t idx = first; idx < std::min(first + opt.batch, nTotal); ++idx)
+                        on_ack(idx);
+                    continue;
+                }
+                if (kind == ReplyKind::Other || req_id == 0 || req_id > nTotal)
+                {
+                    ++res.unknown;   // probes, notifications, foreign clients
+                    continue;
+                }
+                const size_t idx = req_id - 1;
+                const bool bMeasured = idx >= nWarmup;
+                const uint64_t intended = intended_at(idx);
+                const uint64_t actual = sentAt[idx].load(std::memory_order_relaxed);
+                if (kind == ReplyKind::Ack)
+                {
+                    on_ack(idx);
+                    continue;
+                }
+                if (answered[idx]) continue;
+                answered[idx] = 1;
+                --nOutstanding;
+                kind == ReplyKind::Error ? ++res.errors : ++res.results;
+                if (bMeasured)
+                {
+                    res.resultCorrected.record(now - intended);
+                    res.resultRaw.record(now - actual);
+                    res.perMethod[(size_t)schedule[idx].method].record(now - intended);
+                }
+            }
+            if (bSendDone.load(std::memory_order_acquire))
+            {
+                const uint64_t now = metrics::now_ns();
+                if (!drainDeadline) drainDeadline = now + (uint64_t)opt.drainMs * 1'000'000;
+                if (now >= drainDeadline) break;
+            }
+        }
+    });
+
+    // open loop: request i goes out at t0 + i * period, however late the replies are
+    // (with --batch, a frame goes out when its last request is due)
+    size_t nSendFailures = 0;
+    for (size_t first = 0; first < nTotal; first += opt.batch)
+    {
+        const size_t count = std::min(opt.batch, nTotal - first);
+        const uint64_t due = intended_at(first + count - 1);
+        for (uint64_t now = metrics::now_ns(); now < due; now = metrics::now_ns())
+        {
+            // sleep when far ahead, spin for the last stretch
+            if (due - now > 200'000)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - 100'000));
+        }
+        zmq::message_t msg = opt.batch > 1 ? make_batch(first, count, schedule) : make_request(first + 1, schedule[first]);
+        const uint64_t sentNow = metrics::now_ns();
+        for (size_t idx = first; idx < first + count; ++idx)
+            sentAt[idx].store(sentNow, std::memory_order_relaxed);
+        if (!pub.send(std::move(msg), zmq::send_flags::dontwait))
+            ++nSendFailures;
+        nSent.store(first + count, std::memory_order_relaxed);
+    }
+    const uint64_t sendElapsed = metrics::now_ns() - t0;
+    bSendDone.store(true, std::memory_order_release);
+    receiver.join();
+    stop_server();
+
+    const size_t nMeasured = nTotal - nWarmup;
+    uint64_t nLost = 0;
+    for (size_t idx = nWarmup; idx < nTotal; ++idx)
+        if (!answered[idx]) ++nLost;
+    const double measuredSecs = (double)nMeasured * periodNs / 1e9;
+    const double achieved = (double)(nMeasured - nLost) / measuredSecs;
+
+    if (opt.json)
+    {
+        std::string out;
+        fmt::format_to(std::back_inserter(out),
+            R"({{"endpoint":"{}","offered_rps":{:.1f},"achieved_rps":{:.1f},"sent":{},"send_failures":{},"acks":{},"results":{},"errors":{},"lost":{},"send_lag_ms":{:.3f},"latency":{{)",
+            opt.cmdEndpoint, opt.rate, achieved, nSent.load(), nSendFailures, res.acks, res.results, res.errors, nLost,
+            ((double)sendElapsed - (double)(nTotal - 1) * periodNs) / 1e6);
+        print_json_latency(out, "ack", res.ackCorrected);
+        out.push_back(',');
+        print_json_latency(out, "ack_uncorrected", res.ackRaw);
+        out.push_back(',');
+        print_json_latency(out, "result", res.resultCorrected);
+        out.push_back(',');
+        print_json_latency(out, "result_uncorrected", res.resultRaw);
+        out.append(R"(},"methods":{)");
+        bool bFirst = true;
+        for (size_t mid = 0; mid < NUM_METHODS; ++mid)
+        {
+            if (!Summary(res.perMethod[mid]).snap.count) continue;
+            if (!bFirst) out.push_back(',');
+            bFirst = false;
+            print_json_latency(out, method_name((MethodID)mid), res.perMethod[mid]);
+        }
+        out.append("}}");
+        fmt::print("{}\n", out);
+        return 0;
+    }
+
+    fmt::print("target {}  offered {:.0f} req/s for {:.1f} s (+{:.1f} s warmup)\n", opt.cmdEndpoint, opt.rate, opt.duration, opt.warmup);
+    fmt::print("  achieved {:.0f} req/s, sent {}, send failures {}, acks {}, results {}, errors {}, lost {} ({:.3f}%)\n",
+        achieved, nSent.load(), nSendFailures, res.acks, res.results, res.errors, nLost, 100.0 * (double)nLost / (double)nMeasured);
+    fmt::print("latency (corrected for coordinated omission, from the intended send time):\n");
+    print_line("ack", res.ackCorrected);
+    print_line("result", res.resultCorrected);
+    for (size_t mid = 0; mid < NUM_METHODS; ++mid)
+        if (Summary(res.perMethod[mid]).snap.count)
+            print_line(fmt::format("result {}", method_name((MethodID)mid)), res.perMethod[mid]);
+    fmt::print("latency (uncorrected, from the actual send time):\n");
+    print_line("ack", res.ackRaw);
+    print_line("result", res.resultRaw);
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+* zmq-journal-replay: streams a request journal (captured with CAPTURE_JOURNAL,
+* see request_journal.hpp) back into a dispatcher.
+*
+* Frames keep their recorded spacing, scaled by --speed: 1 is the original
+* speed, 4 four times as fast, 0 as fast as possible. By default they go
+* straight into an in-process MessageHandler (handle_incoming_message /
+* handle_incoming_json), which takes the sockets out of the measurement; its
+* rpc.stats snapshot is printed at the end. With --cmd (and --json-cmd for
+* JSON-RPC frames) they are published to a running server instead.
+*
+* The lag behind each frame's due time is reported, so a replay that could
+* not keep up with the recorded load is visible.
+*
+* Usage:
+*   zmq-journal-replay <journal> [--speed 1] [--pub <endpoint>] [--drain-ms 5000]
+*                      [--cmd <endpoint>] [--json-cmd <endpoint>] [--settle-ms 500]
+*/
+#include "headers.hpp"
+
+#include <charconv>
+#include <string>
+#include <thread>
+
+namespace
+{
+    struct Options
+    {
+        std::string journal;
+        double speed = 1;           // 0 = as fast as possible
+        std::string pubEndpoint = "inproc://zmq-journal-replay-pub";  // in process: the handler's PUB socket
+        int drainMs = 5000;         // in process: time to wait for outstanding results
+        std::string cmdEndpoint;    // over a socket: the server's SUB socket for binary frames
+        std::string jsonEndpoint;   // over a socket: the server's SUB socket for JSON-RPC frames
+        int settleMs = 500;         // over a socket: time for the subscriptions to arrive before sending
+    };
+
+    // exposes the handler's bookkeeping to the replay loop
+    class ReplayHandler : public MessageHandler
+    {
+    public:
+        using MessageHandler::MessageHandler;
+        using MessageHandler::in_flight;
+        using MessageHandler::write_stats_json;
+    };
+
+    [[noreturn]] void usage(const char* szError)
+    {
+        std::cerr << "zmq-journal-replay: " << szError << "\n"
+            << "usage: zmq-journal-replay <journal> [--speed X] [--pub EP] [--drain-ms MS]\n"
+            << "                          [--cmd EP] [--json-cmd EP] [--settle-ms MS]\n";
+        std::exit(2);
+    }
+
+    template<typename T>
+    T parse_number(std::string_view s, const char* szWhat)
+    {
+        T v {};
+        auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (ec != std::errc {} || p != s.data() + s.size()) usage(szWhat);
+        return v;
+    }
+
+    Options parse_options(int argc, char** argv)
+    {
+        Options opt;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            auto next = [&]() -> std::string_view {
+                if (i + 1 >= argc) usage("missing option value");
+                return argv[++i];
+            };
+            if (arg == "--speed") opt.speed = parse_number<double>(next(), "bad --speed");
+            else if (arg == "--pub") opt.pubEndpoint = next();
+            else if (arg == "--drain-ms") opt.drainMs = parse_number<int>(next(), "bad --drain-ms");
+            else if (arg == "--cmd") opt.cmdEndpoint = next();
+            else if (arg == "--json-cmd") opt.jsonEndpoint = next();
+            else if (arg == "--settle-ms") opt.settleMs = parse_number<int>(next(), "bad --settle-ms");
+            else if (arg.starts_with("--")) usage("unknown option");
+            else if (opt.journal.empty()) opt.journal = arg;
+            else usage("more than one journal");
+        }
+        if (opt.journal.empty()) usage("no journal");
+        if (opt.speed < 0) usage("--speed must not be negative");
+        return opt;
+    }
+
+    // sleeps while the deadline is far, then spins, for sub-10us accuracy
+    void wait_until(uint64_t due_ns)
+    {
+        constexpr uint64_t SPIN_NS = 200'000;
+        uint64_t now = metrics::now_ns();
+        if (due_ns > now + SPIN_NS)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due_ns - now - SPIN_NS / 2));
+        while (metrics::now_ns() < due_ns)
+            AdaptiveSpin::cpu_relax();
+    }
+
+    zmq::socket_t connect_pub(zmq::context_t& ctx, const std::string& endpoint)
+    {
+        zmq::socket_t pub(ctx, ZMQ_PUB);
+        pub.set(zmq::sockopt::sndhwm, 0);      // never drop on our side
+        pub.set(zmq::sockopt::linger, 2000);   // flush what is queued on exit
+        pub.connect(endpoint);
+        return pub;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const Options opt = parse_options(argc, argv);
+    const bool bOverSocket = !opt.cmdEndpoint.empty() || !opt.jsonEndpoint.empty();
+
+    try
+    {
+        const JournalReader reader(opt.journal);
+        if (reader.size() == 0)
+        {
+            std::cout << opt.journal << ": no frames" << std::endl;
+            return 0;
+        }
+
+        zmq::context_t ctx { 1 };
+        std::unique_ptr<ReplayHandler> pHandler;
+        zmq::socket_t cmdPub, jsonPub;
+        if (bOverSocket)
+        {
+            if (!opt.cmdEndpoint.empty()) cmdPub = connect_pub(ctx, opt.cmdEndpoint);
+            if (!opt.jsonEndpoint.empty()) jsonPub = connect_pub(ctx, opt.jsonEndpoint);
+            // PUB drops everything sent before the server's subscription arrives
+            std::this_thread::sleep_for(std::chrono::milliseconds(opt.settleMs));
+        }
+        else
+        {
+            zmq::socket_t publisher(ctx, ZMQ_PUB);
+            publisher.set(zmq::sockopt::sndhwm, 1000);
+            publisher.set(zmq::sockopt::linger, 0);
+            publisher.bind(opt.pubEndpoint);
+            pHandler = std::make_unique<ReplayHandler>(std::move(publisher));
+        }
+
+        const uint64_t firstAt = reader[0].received_at;
+        const uint64_t recorded = reader[reader.size() - 1].received_at - firstAt;
+        metrics::Histogram lag;
+        uint64_t nBinary = 0, nJson = 0, nSkipped = 0;
+
+        const uint64_t t0 = metrics::now_ns() + 1'000'000;
+        for (size_t idx = 0; idx < reader.size(); ++idx)
+        {
+            const journal::Record rec = reader[idx];
+            if (opt.speed > 0)
+            {
+                const uint64_t due = t0 + (uint64_t)((double)(rec.received_at - firstAt) / opt.speed);
+                wait_until(due);
+                lag.record(metrics::now_ns() - due);
+            }
+
+            // a copy, as a socket would deliver it: the handler owns (and may modify) the frame
+            zmq::message_t frame(rec.frame.data(), rec.frame.size());
+            const bool bJson = rec.channel == journal::Channel::Json;
+            zmq::socket_t& target = bJson ? jsonPub : cmdPub;
+            if (pHandler)
+            {
+                if (bJson) pHandler->handle_incoming_json(std::move(frame));
+                else pHandler->handle_incoming_message(std::move(frame));
+                pHandler->publish_outgoing_messages();
+            }
+            else if (target)
+                target.send(std::move(frame), zmq::send_flags::none);
+            else
+            {
+                ++nSkipped;
+                continue;
+            }
+            ++(bJson ? nJson : nBinary);
+        }
+        const uint64_t elapsed = metrics::now_ns() - t0;
+
+        if (pHandler)
+        {
+            const uint64_t drainDeadline = metrics::now_ns() + (uint64_t)opt.drainMs * 1'000'000;
+            while (pHandler->in_flight() && metrics::now_ns() < drainDeadline)
+            {
+                pHandler->publish_outgoing_messages();
+                std::this_thread::yield();
+            }
+            if (pHandler->in_flight())
+                std::cerr << pHandler->in_flight() << " requests still in flight after " << opt.drainMs << " ms" << std::endl;
+        }
+
+        const double elapsedS = (double)elapsed / 1e9;
+        fmt::print("replayed {} binary + {} JSON frames ({} skipped: no endpoint) in {:.3f} s, {:.0f} frames/s; recorded span {:.3f} s\n",
+            nBinary, nJson, nSkipped, elapsedS, (double)(nBinary + nJson) / elapsedS, (double)recorded / 1e9);
+        if (opt.speed > 0)
+        {
+            metrics::HistogramSnapshot snap;
+            snap.merge(lag);
+            fmt::print("lag behind schedule: p50={:.1f} p99={:.1f} p99.9={:.1f} max={:.1f} us\n",
+                snap.percentile(50) / 1000.0, snap.percentile(99) / 1000.0, snap.percentile(99.9) / 1000.0, snap.max / 1000.0);
+        }
+        if (pHandler)
+        {
+            SlabBuffer stats;
+            pHandler->write_stats_json(stats);
+            fmt::print("{}\n", std::string_view { stats.data(), stats.size() });
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "zmq-journal-replay: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+* rpc_client_example: the examples/js producer in C++. Starts a pipeline,
+* then keeps a window of status requests in flight and prints the client's
+* latencies every second, until interrupted.
+*
+* Usage:
+*   zmq-rpc-client-example [--cmd tcp://localhost:5555] [--pub tcp://localhost:5556] [--window 64] [--client 0]
+*/
+#include "headers.hpp"
+
+#include <charconv>
+#include <csignal>
+#include <thread>
+
+static std::atomic<bool> s_bExit { false };
+
+int main(int argc, char** argv)
+{
+    RpcClient::Options options;
+    size_t nWindow = 64;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string_view arg = argv[i], value = argv[i + 1];
+        if (arg == "--cmd") options.cmd_address = value;
+        else if (arg == "--pub") options.pub_address = value;
+        else if (arg == "--window") std::from_chars(value.data(), value.data() + value.size(), nWindow);
+        else if (arg == "--client") std::from_chars(value.data(), value.data() + value.size(), options.client_id);
+        else
+        {
+            std::cerr << "unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+    std::signal(SIGINT, [](int) { s_bExit = true; });
+    std::signal(SIGTERM, [](int) { s_bExit = true; });
+
+    zmq::context_t ctx { 1 };
+    // declared before the client: its destructor completes the pending calls
+    std::atomic<uint64_t> nCompleted { 0 };
+    std::function<void()> send_next;
+    RpcClient client(ctx, options, [](std::string_view notification) { std::cout << "notification: " << notification << '\n'; });
+    std::cout << "Sending requests to " << options.cmd_address << ", receiving on " << options.pub_address << std::endl;
+
+    // the first requests may be sent before the SUB connection is up: they are retransmitted until acked
+    const Payload<MethodID::GStreamer_Pipeline_Start> start { "videotestsrc ! fakesink" };
+    try
+    {
+        std::cout << "started: " << client.call<MethodID::GStreamer_Pipeline_Start>(start).get() << std::endl;
+    }
+    catch (const RpcError& e)
+    {
+        std::cerr << "start failed (" << e.code() << "): " << e.what() << std::endl;
+    }
+
+    // pipelined: every completion sends the next request
+    send_next = [&] {
+        if (s_bExit) return;
+        client.call<MethodID::GStreamer_Pipeline_Status>({ 1 }, [&](const RpcResponse& r) {
+            if (!r.ok()) std::cerr << "request " << r.id << " failed (" << r.error_code << "): " << r.result << '\n';
+            nCompleted.fetch_add(1, std::memory_order_relaxed);
+            send_next();
+        });
+    };
+    for (size_t i = 0; i < nWindow; ++i) send_next();
+
+    uint64_t nLast = 0;
+    while (!s_bExit)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const uint64_t nNow = nCompleted.load(std::memory_order_relaxed);
+        const metrics::HistogramSnapshot ack = client.ack_latency(), result = client.result_latency();
+        const RpcClient::Stats stats = client.stats();
+        std::cout << fmt::format("{} req/s  ack p50 {:.1f}us p99 {:.1f}us  result p50 {:.1f}us p99 {:.1f}us  retransmits {} resends {} errors {}\n",
+            nNow - nLast, ack.percentile(50) / 1000.0, ack.percentile(99) / 1000.0,
+            result.percentile(50) / 1000.0, result.percentile(99) / 1000.0, stats.retransmits, stats.resends, stats.errors);
+        nLast = nNow;
+    }
+    return 0;
+}
@@ -1,9 +1,23 @@
 import PendingRequests, { type TReqID } from "./pending-requests";
 import Tracker from "@fict/utils/tracker";
 import zmq, { Subscriber, Publisher, type MessageLike } from "zeromq";
-import type { IStats } from "./stats";
+import type { IStats, IServerTiming } from "./stats";
 import Stats from "./stats";
 
+// method_id bit of a binary request that asks for the stage timestamps in its result
+export const METHOD_FLAG_TIMING = 0x40;
+// MethodID::RPC_Resend: publishes the kept result of the request id in its payload again
+export const METHOD_RPC_RESEND = 12;
+
+// binary rpc.resend for request id: ParamsBase (id, method_id) followed by the id again as payload
+export function createResendRequest(id: bigint): Buffer {
+  const buf = Buffer.allocUnsafe(17);
+  buf.writeBigUInt64LE(id, 0);
+  buf.writeUInt8(METHOD_RPC_RESEND, 8);
+  buf.writeBigUInt64LE(id, 9);
+  return buf;
+}
+
 export interface TReqObj {
   id: TReqID;
   method: string;
@@ -39,6 +53,7 @@ export interface IRPCResponse {
     id: TReqID;
     data?: any;
   };
+  timing?: IServerTiming; // results of requests that asked for it
 }
 
 export interface IRPCRequest {
@@ -47,6 +62,7 @@ export interface IRPCRequest {
   method: string;
   params?: object;
   options?: object;
+  timing?: boolean; // the result carries the server's stage timestamps
 }
 
 export default class ZMQRPC_Client {
@@ -57,21 +73,28 @@ export default class ZMQRPC_Client {
   m_bShouldExit: boolean = false;
   m_stats: Stats = new Stats();
   m_logger: Console;
+  // after the ack: ask for the result again (rpc.resend) when none came by then, doubling; 0 = never
+  m_resendAfterMS: number;
+  m_resendTimers: Map<bigint, NodeJS.Timeout> = new Map();
 
   constructor(
     pub: Publisher,
     sub: Subscriber,
     logger: Console = console,
-    onNotification: (response: IRPCResponse) => void = () => {}
+    onNotification: (response: IRPCResponse) => void = () => {},
+    resendAfterMS: number = 1000
   ) {
     this.m_Publisher = pub;
     this.m_Subscriber = sub;
     this.m_logger = logger;
+    this.m_resendAfterMS = resendAfterMS;
     this.listen_to_server(onNotification); // start listening to replies
   }
 
   close() {
     this.m_bShouldExit = true;
+    this.m_resendTimers.forEach((timer) => clearTimeout(timer));
+    this.m_resendTimers.clear();
     this.m_Publisher.close();
     this.m_Subscriber.close();
   }
@@ -123,28 +146,56 @@ export default class ZMQRPC_Client {
             const t = this.m_pendingReq.get(BigInt(response.id));
             if (t) {
               this.m_pendingReq.remove(response.id);
-              if (response.error)
+              if (response.error) {
                 // some error happened, no result/ack fields will be available
+                this._cancelResend(BigInt(response.id));
                 t.cancel(response.error);
-              else if (response.ack) {
+              } else if (response.ack) {
                 // this is acknowledgement, real result will come later
                 this.m_pendingReq.add(response.id, t); // reinsert into Q at the end
                 this.m_logger.debug(`Ack received for ${response.id}`);
+                this._scheduleResend(BigInt(response.id), this.m_resendAfterMS);
               }
               // no error, not an ack - consider this as result
-              else t.finish(response.result);
+              else {
+                this._cancelResend(BigInt(response.id));
+                t.finish(response.result);
+              }
             } else {
               this.m_logger.log("Unexpected Reply from server: ", response);
             }
 
             // record the stats
-            this.m_stats.onReceived(message, t);
+            this.m_stats.onReceived(message, t, response.timing);
           });
         })
         .catch((ex) => this.m_logger.error(ex.message));
     }
   }
 
+  // a result lost after its ack (a PUB drop, a slow joiner) is published again by the server
+  // on rpc.resend, as long as it still holds it; nothing comes while the request still runs
+  private _scheduleResend(id: bigint, delayMS: number): void {
+    if (delayMS <= 0 || this.m_resendTimers.has(id)) return;
+    const timer = setTimeout(() => {
+      this.m_resendTimers.delete(id);
+      if (this.m_bShouldExit || !this.m_pendingReq.get(id)) return; // completed or timed out meanwhile
+      this.m_stats.resends++;
+      this.m_Publisher
+        .send(createResendRequest(id))
+        .catch((ex) => this.m_logger.error(`rpc.resend for ${id}: ${ex.message}`));
+      this._scheduleResend(id, delayMS * 2);
+    }, delayMS);
+    this.m_resendTimers.set(id, timer);
+  }
+
+  private _cancelResend(id: bigint): void {
+    const timer = this.m_resendTimers.get(id);
+    if (!timer) return;
+    clearTimeout(timer);
+    this.m_resendTimers.delete(id);
+  }
+
   private _handleSSE(response: IRPCResponse, onNotification: (response: IRPCResponse) => void): void {
     if (!response.stream) {
       return onNotification(response);
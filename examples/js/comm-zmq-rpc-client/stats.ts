@@ -6,6 +6,25 @@ export interface IResponseTimes {
   max: number;
 }
 
+// stage timestamps a timed request's result carries (nanoseconds on the server's
+// monotonic clock: only their differences are meaningful)
+export interface IServerTiming {
+  received: number;
+  dispatched: number;
+  started: number;
+  finished: number;
+  published: number;
+}
+
+// where a timed request spent its round trip, in ms
+export interface IStageTimes {
+  dispatch: IResponseTimes; // received -> handed to the worker pool
+  queue: IResponseTimes; // waiting for a worker
+  execution: IResponseTimes; // the handler
+  publish: IResponseTimes; // result formatted -> sent
+  network: IResponseTimes; // the rest of the round trip: transport both ways and client side
+}
+
 export interface IStats {
   lastSentAt: number;
   lastReceivedAt: number;
@@ -13,6 +32,18 @@ export interface IStats {
   receivedBytes: number;
   responseTimes: IResponseTimes;
   requestsCompleted: number;
+  stageTimes: IStageTimes;
+  timedRequests: number;
+  resends: number; // rpc.resend sent for results overdue after their ack
+}
+
+const NS_PER_MS = 1e6;
+
+function widen(times: IResponseTimes, value: number): IResponseTimes {
+  return {
+    min: Math.min(value, times.min || Infinity),
+    max: Math.max(value, times.max),
+  };
 }
 
 export default class Stats implements IStats {
@@ -22,23 +53,41 @@ export default class Stats implements IStats {
   receivedBytes: number = 0;
   responseTimes: IResponseTimes = { min: 0, max: 0 };
   requestsCompleted: number = 0;
+  stageTimes: IStageTimes = {
+    dispatch: { min: 0, max: 0 },
+    queue: { min: 0, max: 0 },
+    execution: { min: 0, max: 0 },
+    publish: { min: 0, max: 0 },
+    network: { min: 0, max: 0 },
+  };
+  timedRequests: number = 0;
+  resends: number = 0;
 
   onSent(buf: Uint8Array): void {
     this.lastSentAt = now();
     this.sentBytes += buf.length;
   }
 
-  onReceived(msg: Uint8Array, t?: Tracker): void {
+  onReceived(msg: Uint8Array, t?: Tracker, timing?: IServerTiming): void {
     this.lastReceivedAt = now();
     this.receivedBytes += msg.length;
 
     if (t) {
       const responseTime = t.timeSpent();
-      this.responseTimes = {
-        min: Math.min(responseTime, this.responseTimes.min || Infinity),
-        max: Math.max(responseTime, this.responseTimes.max),
-      };
+      this.responseTimes = widen(this.responseTimes, responseTime);
       this.requestsCompleted++;
+      if (timing) this.onTiming(responseTime, timing);
     }
   }
+
+  private onTiming(responseTime: number, timing: IServerTiming): void {
+    const { received, dispatched, started, finished, published } = timing;
+    const stages = this.stageTimes;
+    stages.dispatch = widen(stages.dispatch, (dispatched - received) / NS_PER_MS);
+    stages.queue = widen(stages.queue, (started - dispatched) / NS_PER_MS);
+    stages.execution = widen(stages.execution, (finished - started) / NS_PER_MS);
+    stages.publish = widen(stages.publish, (published - finished) / NS_PER_MS);
+    stages.network = widen(stages.network, Math.max(0, responseTime - (published - received) / NS_PER_MS));
+    this.timedRequests++;
+  }
 }
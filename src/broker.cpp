@@ -0,0 +1,431 @@
+#include "headers.hpp"
+#include "json_ingress.hpp"
+
+namespace broker
+{
+    void write_report(SlabBuffer& out, const LoadReport& report)
+    {
+        JsonWriter w(out);
+        w.raw(jsonrpc::NOTIFICATION_PREFIX);
+        w.string(REGISTER_METHOD);
+        w.raw(jsonrpc::PARAMS_KEY);
+        w.raw(R"({"instance":)");
+        w.u64(report.instance);
+        w.raw(R"(,"cmd":)");
+        w.string(report.cmd_address);
+        w.raw(R"(,"pub":)");
+        w.string(report.pub_address);
+        w.raw(R"(,"queued":)");
+        w.u64(report.queued);
+        w.raw(R"(,"in_flight":)");
+        w.u64(report.in_flight);
+        w.raw(R"(,"pipelines":)");
+        w.u64(report.pipelines);
+        w.raw("}}");
+    }
+
+    bool parse_report(zmq::message_t& frame, LoadReport& report)
+    {
+        thread_local simdjson::ondemand::parser parser;
+
+        frame = json_ingress::make_parseable(std::move(frame));
+        simdjson::ondemand::document doc;
+        simdjson::ondemand::object notification, params;
+        std::string_view method;
+        if (parser.iterate(static_cast<const char*>(frame.data()), frame.size(), frame.size() + simdjson::SIMDJSON_PADDING).get(doc)
+            || doc.get_object().get(notification)
+            || notification.find_field_unordered("method").get_string().get(method) || method != REGISTER_METHOD
+            || notification.find_field_unordered("params").get_object().get(params))
+            return false;
+
+        uint64_t instance = 0;
+        simdjson::ondemand::value value;
+        if (params.find_field_unordered("instance").get_uint64().get(instance) || instance > UINT8_MAX
+            || params.find_field_unordered("cmd").get(value) || json_ingress::get_string_in_place(value, report.cmd_address)
+            || params.find_field_unordered("pub").get(value) || json_ingress::get_string_in_place(value, report.pub_address)
+            || params.find_field_unordered("queued").get_uint64().get(report.queued)
+            || params.find_field_unordered("in_flight").get_uint64().get(report.in_flight)
+            || params.find_field_unordered("pipelines").get_uint64().get(report.pipelines))
+            return false;
+        report.instance = (uint8_t)instance;
+        return !report.cmd_address.empty() && !report.pub_address.empty();
+    }
+
+    std::string advertised_address(std::string_view bound_address)
+    {
+        std::string address(bound_address);
+        for (std::string_view wildcard : { "://*:", "://0.0.0.0:" })
+            if (const size_t pos = address.find(wildcard); pos != std::string::npos)
+                address.replace(pos, wildcard.size(), "://localhost:");
+        return address;
+    }
+}
+
+Broker::Broker(zmq::context_t& ctx, Options options)
+    : m_options(std::move(options)),
+    m_ctx(ctx),
+    m_cmdListener(ctx, ZMQ_SUB),
+    m_publisher(ctx, ZMQ_PUB),
+    m_registry(ctx, ZMQ_PULL),
+    m_replies(ctx, ZMQ_SUB)
+{
+    TRACY_ZONE;
+
+    // the same socket setup as DispatcherServer: to clients, the broker is a dispatcher
+    m_cmdListener.set(zmq::sockopt::rcvbuf, 1024 * 1024);
+    m_cmdListener.set(zmq::sockopt::rcvhwm, 1000);
+    m_cmdListener.set(zmq::sockopt::linger, 0);
+    m_cmdListener.bind(m_options.cmd_address);
+    m_cmdListener.set(zmq::sockopt::subscribe, "");
+
+    m_publisher.set(zmq::sockopt::sndbuf, 1024 * 1024);
+    m_publisher.set(zmq::sockopt::sndhwm, 1000);
+    m_publisher.set(zmq::sockopt::linger, 0);
+    m_publisher.set(zmq::sockopt::immediate, 1);
+    // drops per subscriber at the HWM (see DispatcherServer::create_pub_socket)
+    m_publisher.bind(m_options.pub_address);
+
+    m_registry.set(zmq::sockopt::linger, 0);
+    m_registry.bind(m_options.registry_address);
+
+    m_replies.set(zmq::sockopt::rcvbuf, 1024 * 1024);
+    m_replies.set(zmq::sockopt::linger, 0);
+    m_replies.set(zmq::sockopt::subscribe, "");
+
+    if (m_options.handle_signals)
+    {
+        m_shutdownListener = zmq::socket_t(ctx, ZMQ_PAIR);
+        m_shutdownListener.bind(SHUTDOWN_INPROC_ADDR);
+        m_shutdownListener.set(zmq::sockopt::linger, 0);
+        setup_shutdown_handlers(ctx);
+    }
+}
+
+void Broker::stop() noexcept
+{
+    m_bStop.store(true, std::memory_order_release);
+    m_stopBell.ring();
+}
+
+bool Broker::should_stop() const noexcept
+{
+    return m_bStop.load(std::memory_order_acquire) || (m_options.handle_signals && shouldExit());
+}
+
+void Broker::on_report(zmq::message_t&& frame)
+{
+    broker::LoadReport report;
+    if (!broker::parse_report(frame, report))
+    {
+        std::cerr << "Broker: ignored a malformed load report" << std::endl;
+        return;
+    }
+
+    Instance* pInstance = m_instances[report.instance].get();
+    if (!pInstance || pInstance->cmd_address != report.cmd_address || pInstance->pub_address != report.pub_address)
+    {
+        if (!this->register_instance(report)) return;
+        pInstance = m_instances[report.instance].get();
+    }
+    pInstance->queued = report.queued;
+    pInstance->in_flight = report.in_flight;
+    pInstance->pipelines = report.pipelines;
+    pInstance->routed_since_report = 0;
+    pInstance->starts_since_report = 0;
+    pInstance->reported_at = metrics::now_ns();
+}
+
+bool Broker::register_instance(const broker::LoadReport& report)
+{
+    // the same id from other addresses: two instances share an id while the registered one
+    // is live, or it restarted elsewhere once it expired
+    if (Instance* pRegistered = m_instances[report.instance].get())
+    {
+        const uint64_t timeout = (uint64_t)std::max<int64_t>(m_options.instance_timeout_ms, 0) * 1000000;
+        if (metrics::now_ns() - pRegistered->reported_at <= timeout)
+        {
+            ++m_nRefused;
+            if (!std::exchange(pRegistered->bConflictLogged, true))
+                std::cerr << "Broker: refused instance " << (unsigned)report.instance << " at " << report.cmd_address
+                    << ": the id belongs to the live instance at " << pRegistered->cmd_address << std::endl;
+            return false;
+        }
+        std::cerr << "Broker: instance " << (unsigned)report.instance << " moved to " << report.cmd_address << std::endl;
+        this->drop_instance(report.instance);
+    }
+
+    auto pInstance = std::make_unique<Instance>();
+    pInstance->id = report.instance;
+    pInstance->cmd_address = report.cmd_address;
+    pInstance->pub_address = report.pub_address;
+    pInstance->requests = zmq::socket_t(m_ctx, ZMQ_PUB);
+    pInstance->requests.set(zmq::sockopt::sndhwm, 1000);
+    pInstance->requests.set(zmq::sockopt::linger, 0);
+    pInstance->requests.set(zmq::sockopt::immediate, 1);
+    try
+    {
+        pInstance->requests.connect(pInstance->cmd_address);
+        m_replies.connect(pInstance->pub_address);
+    }
+    catch (const zmq::error_t& e)
+    {
+        std::cerr << "Broker: cannot connect to instance " << (unsigned)report.instance << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    std::cout << "Broker: instance " << (unsigned)report.instance << " registered at " << report.cmd_address
+        << ", " << report.pub_address << std::endl;
+    m_instances[report.instance] = std::move(pInstance);
+    m_live.push_back(report.instance);
+    return true;
+}
+
+void Broker::drop_instance(uint8_t id)
+{
+    m_replies.disconnect(m_instances[id]->pub_address);
+    m_instances[id].reset();
+    std::erase(m_live, id);
+}
+
+void Broker::expire_instances()
+{
+    const uint64_t now = metrics::now_ns();
+    const uint64_t timeout = (uint64_t)std::max<int64_t>(m_options.instance_timeout_ms, 0) * 1000000;
+    for (size_t i = m_live.size(); i-- > 0;)
+    {
+        const uint8_t id = m_live[i];
+        if (now - m_instances[id]->reported_at <= timeout) continue;
+        std::cerr << "Broker: instance " << (unsigned)id << " stopped reporting, dropped" << std::endl;
+        this->drop_instance(id);
+    }
+}
+
+Broker::Instance* Broker::least_loaded() noexcept
+{
+    Instance* pBest = nullptr;
+    uint64_t nBestLoad = UINT64_MAX;
+    for (uint8_t id : m_live)
+    {
+        Instance& instance = *m_instances[id];
+        const uint64_t nLoad = instance.queued + instance.in_flight + instance.routed_since_report
+            + m_options.pipeline_weight * (instance.pipelines + instance.starts_since_report);
+        if (nLoad < nBestLoad)
+        {
+            pBest = &instance;
+            nBestLoad = nLoad;
+        }
+    }
+    return pBest;
+}
+
+void Broker::forward(Instance& instance, zmq::message_t&& frame, size_t requests, size_t starts)
+{
+    TRACY_ZONE_NAMED("broker.forward");
+    if (!instance.requests.send(std::move(frame), zmq::send_flags::dontwait))
+    {
+        ++m_nDrops;
+        return;
+    }
+    // counted until the next report includes them
+    instance.routed_since_report += requests;
+    instance.starts_since_report += starts;
+    instance.routed += requests;
+    m_nRouted += requests;
+}
+
+void Broker::route_request(zmq::message_t&& frame)
+{
+    TRACY_ZONE_NAMED("broker.route");
+    const std::string_view record = frame.to_string_view();
+    RequestHeader header;
+    if (!read_header(record, header) || !header.base.req_id) return;   // nobody to answer
+    TRACY_ZONE_FLOW(header.base.req_id);
+    const MethodID mid = header.method();
+
+    if (mid == MethodID::RPC_Stats)
+    {
+        this->send_stats(header.base.req_id);
+        return;
+    }
+    if (mid == MethodID::RPC_Batch)
+    {
+        size_t nRequests = 0, nStarts = 0;
+        if (Instance* pInstance = this->route_batch(frame, header.base.req_id, nRequests, nStarts))
+            this->forward(*pInstance, std::move(frame), nRequests, nStarts);
+        return;
+    }
+    if (mid == MethodID::RPC_Resend && is_dispatchable(mid, record.size() - header.size))
+    {
+        // not load: nothing runs for it
+        for (uint8_t id : m_live)
+        {
+            zmq::message_t shared;
+            shared.copy(frame);
+            m_instances[id]->requests.send(std::move(shared), zmq::send_flags::dontwait);
+        }
+        return;
+    }
+    if (!is_dispatchable(mid, record.size() - header.size))
+    {
+        this->send_error(header.base.req_id, jsonrpc::INVALID_REQUEST, "Invalid Request");
+        return;
+    }
+
+    const std::optional<TPipelineID> pipeline_id = bound_pipeline(mid, record.substr(header.size));
+    Instance* pInstance = pipeline_id ? m_instances[pipeline_instance(*pipeline_id)].get() : this->least_loaded();
+    if (!pInstance)
+    {
+        ++m_nNoInstance;
+        this->send_error(header.base.req_id, jsonrpc::NO_INSTANCE,
+            pipeline_id ? "No instance: the pipeline's instance is not registered" : "No instance registered");
+        return;
+    }
+    this->forward(*pInstance, std::move(frame), 1, mid == MethodID::GStreamer_Pipeline_Start);
+}
+
+Broker::Instance* Broker::route_batch(const zmq::message_t& frame, TReqID batch_id, size_t& requests, size_t& starts)
+{
+    thread_local std::vector<std::string_view> records;
+    if (!decode_batch(frame.to_string_view(), records) || records.empty())
+    {
+        this->send_error(batch_id, jsonrpc::INVALID_REQUEST, "Invalid batch");
+        return nullptr;
+    }
+
+    // the batch is acked as a unit, so it runs on one instance: the owner of its pipelines, if any
+    std::optional<uint8_t> owner;
+    for (std::string_view record : records)
+    {
+        RequestHeader header;
+        if (!read_header(record, header))
+        {
+            this->send_error(batch_id, jsonrpc::INVALID_REQUEST, "Invalid batch");
+            return nullptr;
+        }
+        if (header.method() == MethodID::GStreamer_Pipeline_Start) ++starts;
+        const std::optional<TPipelineID> pipeline_id = bound_pipeline(header.method(), record.substr(header.size));
+        if (!pipeline_id) continue;
+        if (owner && *owner != pipeline_instance(*pipeline_id))
+        {
+            this->send_error(batch_id, jsonrpc::INVALID_REQUEST, "Invalid batch: its pipelines run on different instances");
+            return nullptr;
+        }
+        owner = pipeline_instance(*pipeline_id);
+    }
+
+    requests = records.size();
+    Instance* pInstance = owner ? m_instances[*owner].get() : this->least_loaded();
+    if (!pInstance)
+    {
+        m_nNoInstance += records.size();
+        this->send_error(batch_id, jsonrpc::NO_INSTANCE, owner ? "No instance: the pipelines' instance is not registered" : "No instance registered");
+    }
+    return pInstance;
+}
+
+void Broker::send_error(TReqID req_id, int code, std::string_view message)
+{
+    SlabBuffer errBuf;
+    jsonrpc::write_error(errBuf, req_id, code, message);
+    m_publisher.send(std::move(errBuf).to_message(), zmq::send_flags::dontwait);
+}
+
+void Broker::send_stats(TReqID req_id)
+{
+    SlabBuffer ackBuf;
+    jsonrpc::write_ack(ackBuf, req_id);
+    m_publisher.send(std::move(ackBuf).to_message(), zmq::send_flags::dontwait);
+
+    const uint64_t now = metrics::now_ns();
+    SlabBuffer statsBuf;
+    jsonrpc::write_result_prefix(statsBuf, req_id);
+    fmt::format_to(std::back_inserter(statsBuf), R"({{"routed":{},"no_instance":{},"drops":{},"refused":{},"instances":[)",
+        m_nRouted, m_nNoInstance, m_nDrops, m_nRefused);
+    JsonWriter w(statsBuf);
+    for (size_t i = 0; i < m_live.size(); ++i)
+    {
+        const Instance& instance = *m_instances[m_live[i]];
+        if (i) w.raw(',');
+        w.raw(R"({"instance":)");
+        w.u64(instance.id);
+        w.raw(R"(,"cmd":)");
+        w.string(instance.cmd_address);
+        w.raw(R"(,"pub":)");
+        w.string(instance.pub_address);
+        fmt::format_to(std::back_inserter(statsBuf),
+            R"(,"queued":{},"in_flight":{},"pipelines":{},"routed_since_report":{},"routed":{},"report_age_ms":{}}})",
+            instance.queued, instance.in_flight, instance.pipelines, instance.routed_since_report, instance.routed,
+            (now - instance.reported_at) / 1000000);
+    }
+    statsBuf.append("]}}");
+    m_publisher.send(std::move(statsBuf).to_message(), zmq::send_flags::dontwait);
+}
+
+void Broker::run()
+{
+    TRACY_ZONE;
+    constexpr size_t NONE = ~size_t(0);
+
+    std::vector<zmq::pollitem_t> items = {
+        { m_cmdListener, 0, ZMQ_POLLIN, 0 },
+        { m_replies, 0, ZMQ_POLLIN, 0 },
+        { m_registry, 0, ZMQ_POLLIN, 0 },
+    };
+    auto add_item = [&items](zmq::pollitem_t item) { items.push_back(item); return items.size() - 1; };
+    const size_t nStop = m_stopBell.fd() >= 0 ? add_item({ nullptr, m_stopBell.fd(), ZMQ_POLLIN, 0 }) : NONE;
+    const size_t nShutdown = m_options.handle_signals ? add_item({ m_shutdownListener, 0, ZMQ_POLLIN, 0 }) : NONE;
+    auto fired = [&items](size_t idx) { return idx != NONE && (items[idx].revents & ZMQ_POLLIN); };
+
+    // instances are checked for missed reports a few times per timeout
+    const auto expiryInterval = std::chrono::milliseconds { std::max<int64_t>(m_options.instance_timeout_ms / 4, 1) };
+    auto nextExpiryAt = std::chrono::steady_clock::now() + expiryInterval;
+    zmq::message_t msg;
+
+    while (should_stop() == false)
+    {
+        try
+        {
+            // without the doorbell fd, stop() is picked up on a short poll timeout
+            auto pollTimeout = std::chrono::milliseconds { nStop != NONE ? -1 : 1 };
+            if (!m_live.empty())
+            {
+                auto untilExpiry = std::chrono::ceil<std::chrono::milliseconds>(nextExpiryAt - std::chrono::steady_clock::now());
+                untilExpiry = std::max(untilExpiry, std::chrono::milliseconds { 0 });
+                pollTimeout = pollTimeout.count() < 0 ? untilExpiry : std::min(pollTimeout, untilExpiry);
+            }
+            zmq::poll(items, pollTimeout);
+
+            if (fired(nShutdown) || fired(nStop) || should_stop())
+                break;
+
+            // reports first: a new instance can take the requests that woke us up
+            while (m_registry.recv(msg, zmq::recv_flags::dontwait))
+                this->on_report(std::move(msg));
+
+            if (std::chrono::steady_clock::now() >= nextExpiryAt)
+            {
+                this->expire_instances();
+                nextExpiryAt = std::chrono::steady_clock::now() + expiryInterval;
+            }
+
+            while (should_stop() == false && m_cmdListener.recv(msg, zmq::recv_flags::dontwait))
+                this->route_request(std::move(msg));
+
+            // replies go back to every client unchanged, as the instance wrote them
+            while (m_replies.recv(msg, zmq::recv_flags::dontwait))
+            {
+                if (!m_publisher.send(std::move(msg), zmq::send_flags::dontwait))
+                    ++m_nDrops;
+            }
+        }
+        catch (const zmq::error_t& e)
+        {
+            std::cerr << "Broker: ZeroMQ error: " << e.what() << '\n';
+            break;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Broker: error: " << e.what() << '\n';
+        }
+    }
+}
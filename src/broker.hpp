@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zmq.hpp>
+
+/**
+* Load reports: a DispatcherServer with a broker_address pushes one every
+* report_interval_ms to the Broker's registry socket, as a JSON-RPC notification
+*   {"jsonrpc":"2.0","method":"rpc.register","params":{"instance":1,
+*    "cmd":"tcp://host:6001","pub":"tcp://host:6002","queued":0,"in_flight":0,"pipelines":0}}
+* The first report registers the instance, the later ones refresh its load.
+*/
+namespace broker
+{
+    inline constexpr std::string_view REGISTER_METHOD = "rpc.register";
+
+    struct LoadReport
+    {
+        uint8_t instance = 0;
+        std::string_view cmd_address;   // where the broker sends the instance's requests
+        std::string_view pub_address;   // where the broker subscribes to its replies
+        uint64_t queued = 0;
+        uint64_t in_flight = 0;
+        uint64_t pipelines = 0;
+    };
+
+    void write_report(SlabBuffer& out, const LoadReport& report);
+
+    // the addresses are views into frame, which has to stay alive; false when it is not a report
+    bool parse_report(zmq::message_t& frame, LoadReport& report);
+
+    // a bound address as another process connects to it: the wildcard host becomes localhost
+    std::string advertised_address(std::string_view bound_address);
+}
+
+/**
+* Spreads the requests of many clients over several DispatcherServer
+* instances. To clients the broker looks like one dispatcher: they connect to
+* its cmd and pub addresses as they would to a server. Instances register
+* through their load reports (see above); the broker connects a PUB socket to
+* each instance's cmd address and one SUB socket to all their pub addresses,
+* whose acks, results and notifications it republishes unchanged.
+*
+* Routing, per request frame:
+*  - commands for an existing pipeline (Stop, Pause, Resume, Status) go to the
+*    instance that started it, read from the pipeline id's high byte
+*    (pipeline_instance()), so a pipeline's whole command stream stays there;
+*  - everything else, Starts included, goes to the least loaded instance:
+*    reported queued + in_flight requests, plus pipeline_weight per running
+*    pipeline, plus what was routed to it since its last report;
+*  - a batch goes where its pipeline bound records go, and is rejected when
+*    they belong to different instances;
+*  - rpc.stats is answered by the broker itself with its instance table;
+*  - rpc.resend goes to every instance: only the one that published the
+*    result holds it, the others stay silent.
+* GStreamer_Pipeline_List answers for the one instance it reaches. An
+* instance that missed reports for instance_timeout_ms is dropped, and
+* requests for its pipelines fail with NO_INSTANCE. Until then its id is
+* its own: reports with the same id from other addresses are refused, so
+* two instances sharing an id can not take each other's pipelines over.
+* Once it expired, the id registers again at the new addresses (a restart
+* elsewhere).
+*
+* Frames are forwarded without a copy. run() and stop() work as in DispatcherServer.
+*/
+class Broker
+{
+public:
+    struct Options
+    {
+        std::string cmd_address = "tcp://localhost:5555";      // SUB: client requests in
+        std::string pub_address = "tcp://localhost:5556";      // PUB: acks, results, notifications out
+        std::string registry_address = "tcp://localhost:5560"; // PULL: instance load reports in
+        int64_t instance_timeout_ms = 1000;     // drop an instance after this long without a report
+        uint64_t pipeline_weight = 16;          // load of a running pipeline, in queued requests
+        bool handle_signals = false;            // also stop on SIGINT/SIGTERM (shutdown.hpp); one per process
+    };
+
+    Broker(zmq::context_t& ctx, Options options);
+
+    Broker(const Broker&) = delete;
+    Broker& operator=(const Broker&) = delete;
+
+    // polls and routes on the calling thread until stop()
+    void run();
+
+    // thread-safe; run() returns after its current iteration
+    void stop() noexcept;
+
+    const Options& options() const noexcept { return m_options; }
+
+private:
+    struct Instance
+    {
+        uint8_t id;
+        std::string cmd_address;
+        std::string pub_address;
+        zmq::socket_t requests;         // PUB connected to cmd_address
+        uint64_t queued = 0;            // as last reported
+        uint64_t in_flight = 0;
+        uint64_t pipelines = 0;
+        uint64_t routed_since_report = 0;
+        uint64_t starts_since_report = 0;
+        uint64_t routed = 0;
+        uint64_t reported_at = 0;       // metrics::now_ns()
+        bool bConflictLogged = false;   // another instance reported with this id while it was live
+    };
+
+    bool should_stop() const noexcept;
+    void on_report(zmq::message_t&& frame);
+    // false when its addresses cannot be connected to, or another live instance has the id
+    bool register_instance(const broker::LoadReport& report);
+    void drop_instance(uint8_t id);
+    void expire_instances();
+    void route_request(zmq::message_t&& frame);
+    // the batch's target and its request and Start counts, or nullptr after answering it with an error
+    Instance* route_batch(const zmq::message_t& frame, TReqID batch_id, size_t& requests, size_t& starts);
+    Instance* least_loaded() noexcept;
+    void forward(Instance& instance, zmq::message_t&& frame, size_t requests, size_t starts);
+    void send_error(TReqID req_id, int code, std::string_view message);
+    void send_stats(TReqID req_id);
+
+    Options m_options;
+    zmq::context_t& m_ctx;
+    zmq::socket_t m_cmdListener;
+    zmq::socket_t m_publisher;
+    zmq::socket_t m_registry;
+    zmq::socket_t m_replies;            // SUB connected to every instance's pub address
+    zmq::socket_t m_shutdownListener;   // only with handle_signals
+    std::array<std::unique_ptr<Instance>, 256> m_instances;  // by instance id
+    std::vector<uint8_t> m_live;        // ids of the registered instances
+    Doorbell m_stopBell;
+    std::atomic<bool> m_bStop { false };
+    uint64_t m_nRouted = 0;
+    uint64_t m_nNoInstance = 0;         // requests answered with NO_INSTANCE
+    uint64_t m_nDrops = 0;              // sends that failed (HWM drops are per subscriber and silent)
+    uint64_t m_nRefused = 0;            // reports refused: their id belongs to another live instance
+};
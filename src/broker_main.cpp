@@ -0,0 +1,33 @@
+#include "custom-memory.hpp"  // should come first
+#include "headers.hpp"
+
+// the broker only moves frames: one IO thread is plenty
+static zmq::context_t zmq_ctx { 1 };
+
+int main()
+{
+    TRACY_ZONE;
+    TRACY_THREAD_NAME("broker");
+
+    Broker::Options options;
+    options.handle_signals = true;
+    // the client facing endpoints default to the server's, so clients connect to the broker unchanged
+    if (const char* szAddress = std::getenv("SUB_ENDPOINT")) options.cmd_address = szAddress;
+    if (const char* szAddress = std::getenv("PUB_ENDPOINT")) options.pub_address = szAddress;
+    // where the instances' BROKER_ENDPOINT points
+    if (const char* szAddress = std::getenv("REGISTRY_ENDPOINT")) options.registry_address = szAddress;
+    // INSTANCE_TIMEOUT_MS=<drop after, 1000>, PIPELINE_WEIGHT=<a pipeline's load in queued requests, 16>
+    if (const char* szTimeout = std::getenv("INSTANCE_TIMEOUT_MS")) options.instance_timeout_ms = std::atoll(szTimeout);
+    if (const char* szWeight = std::getenv("PIPELINE_WEIGHT")) options.pipeline_weight = (uint64_t)std::atoll(szWeight);
+
+    {
+        Broker broker(zmq_ctx, std::move(options));
+
+        std::cout << "Broker waiting for instances on " << broker.options().registry_address << std::endl;
+
+        broker.run();
+    }
+
+    std::cout << "Broker has shut down" << std::endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+* Spin budget of the hybrid ingress loop: after the last message the loop
+* keeps draining its sockets with recv(dontwait) for budget_ns() before it
+* blocks in zmq::poll() again, so a burst's next message does not pay for a
+* futex/epoll wakeup. The budget is twice the smoothed inter-arrival gap,
+* which catches most next messages, and drops to zero when the gaps grow
+* beyond the configured maximum, where spinning would only burn the core.
+* Single threaded: owned by the ingress thread.
+*/
+class AdaptiveSpin
+{
+public:
+    explicit AdaptiveSpin(uint64_t max_budget_ns) noexcept
+        : m_nMaxBudgetNs(max_budget_ns), m_nMeanGapNs(max_budget_ns / 2)
+    { }
+
+    bool enabled() const noexcept { return m_nMaxBudgetNs > 0; }
+
+    // messages arrived at now; bSpinning: picked up while spinning, not after a blocking poll
+    void on_arrival(uint64_t now, bool bSpinning) noexcept
+    {
+        if (m_nLastArrival)
+        {
+            // an idle period counts as a long gap, not as an arbitrarily long one
+            const uint64_t gap = std::min(now - m_nLastArrival, 2 * m_nMaxBudgetNs);
+            m_nMeanGapNs = m_nMeanGapNs - (m_nMeanGapNs >> 3) + (gap >> 3);     // EWMA, weight 1/8
+        }
+        m_nLastArrival = now;
+        ++(bSpinning ? m_nSpinWakeups : m_nBlockWakeups);
+    }
+
+    uint64_t budget_ns() const noexcept
+    {
+        const uint64_t budget = 2 * m_nMeanGapNs;
+        return budget <= m_nMaxBudgetNs ? budget : 0;
+    }
+
+    uint64_t spin_wakeups() const noexcept { return m_nSpinWakeups; }
+    uint64_t block_wakeups() const noexcept { return m_nBlockWakeups; }
+
+    static void cpu_relax() noexcept
+    {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+private:
+    const uint64_t m_nMaxBudgetNs;
+    uint64_t m_nMeanGapNs;
+    uint64_t m_nLastArrival = 0;
+    uint64_t m_nSpinWakeups = 0;    // messages found while spinning
+    uint64_t m_nBlockWakeups = 0;   // messages that woke the blocking poll
+};
@@ -0,0 +1,136 @@
+#include "headers.hpp"
+#include "coro_task.hpp"
+
+namespace coro
+{
+    Scheduler::Scheduler(BS::thread_pool<>& pool)
+        : m_pool(pool),
+        m_timerThread([this] { run_timers(); })
+    { }
+
+    Scheduler::~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_timerMutex);
+            m_bExit = true;
+        }
+        m_timerCv.notify_one();
+        m_timerThread.join();
+    }
+
+    TimerWheel::TimerId Scheduler::post_at(Clock::time_point due, std::move_only_function<void()> fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_timerMutex);
+            if (!m_bStopping.load(std::memory_order_relaxed))
+            {
+                const TimerWheel::TimerId id = m_timers.schedule_at(due, std::move(fn));
+                // only a deadline before the one being slept for needs a wakeup
+                if (due < m_nextWakeup) m_timerCv.notify_one();
+                return id;
+            }
+        }
+        post(std::move(fn));
+        return 0;
+    }
+
+    bool Scheduler::cancel(TimerWheel::TimerId id)
+    {
+        std::lock_guard<std::mutex> lock(m_timerMutex);
+        return m_timers.cancel(id);
+    }
+
+    size_t Scheduler::pending_timers()
+    {
+        std::lock_guard<std::mutex> lock(m_timerMutex);
+        return m_timers.size();
+    }
+
+    void Scheduler::shutdown()
+    {
+        std::vector<TimerWheel::Callback> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_timerMutex);
+            m_bStopping.store(true, std::memory_order_release);
+            // in deadline order, then the ones not due yet
+            m_timers.advance(Clock::now(), pending);
+            m_timers.drain(pending);
+        }
+        for (auto& fn : pending)
+            post(std::move(fn));
+
+        // nobody drains the backlog any more
+        std::vector<std::coroutine_handle<>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(m_capacityMutex);
+            m_nBacklogLimit.store(SIZE_MAX, std::memory_order_release);
+            waiters.swap(m_capacityWaiters);
+            m_nCapacityWaiters.store(0, std::memory_order_relaxed);
+        }
+        for (auto h : waiters) post(h);
+    }
+
+    void Scheduler::run_timers()
+    {
+        TRACY_THREAD_NAME("coroutine timers");
+        std::vector<TimerWheel::Callback> expired;
+        std::unique_lock<std::mutex> lock(m_timerMutex);
+        while (!m_bExit)
+        {
+            m_nextWakeup = m_timers.next_expiry().value_or(Clock::time_point::max());
+            if (m_nextWakeup == Clock::time_point::max()) m_timerCv.wait(lock);
+            else m_timerCv.wait_until(lock, m_nextWakeup);
+            m_nextWakeup = Clock::time_point::min();    // awake: no wakeups needed until we sleep again
+
+            m_timers.advance(Clock::now(), expired);
+            if (expired.empty()) continue;
+
+            // posted outside the lock, so workers can schedule meanwhile
+            lock.unlock();
+            for (auto& fn : expired)
+                post(std::move(fn));
+            expired.clear();
+            lock.lock();
+        }
+    }
+
+    void Scheduler::set_backlog(std::function<size_t()> depth, size_t limit)
+    {
+        std::lock_guard<std::mutex> lock(m_capacityMutex);
+        m_backlogDepth = std::move(depth);
+        m_nBacklogLimit.store(limit, std::memory_order_release);
+    }
+
+    bool Scheduler::wait_for_capacity(std::coroutine_handle<> h)
+    {
+        // lock free while there is room; shutdown() lifts the limit concurrently
+        if (!m_backlogDepth || m_backlogDepth() < m_nBacklogLimit.load(std::memory_order_acquire)) return false;
+
+        std::lock_guard<std::mutex> lock(m_capacityMutex);
+        // announced before the depth is checked again: a drain from here on sees the waiter
+        m_nCapacityWaiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_backlogDepth() < m_nBacklogLimit.load(std::memory_order_relaxed))
+        {
+            m_nCapacityWaiters.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_capacityWaiters.push_back(h);
+        return true;
+    }
+
+    void Scheduler::on_backlog_drained()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_nCapacityWaiters.load(std::memory_order_relaxed) == 0) return;
+
+        std::vector<std::coroutine_handle<>> waiters;
+        {
+            std::lock_guard<std::mutex> lock(m_capacityMutex);
+            if (m_backlogDepth() >= m_nBacklogLimit.load(std::memory_order_relaxed)) return;
+            waiters.swap(m_capacityWaiters);
+            m_nCapacityWaiters.store(0, std::memory_order_relaxed);
+        }
+        for (auto h : waiters) post(h);
+    }
+}
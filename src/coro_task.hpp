@@ -0,0 +1,284 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BS_thread_pool.hpp"
+#include "slab_allocator.hpp"
+#include "timer_wheel.hpp"
+
+/**
+* Coroutine handlers: a handleMethod<MID> whose HandlerReturn<MID> is
+* coro::Task<Result<MID>> may co_await instead of blocking its worker, e.g.
+*
+*   co_await coro::sleep_for(std::chrono::milliseconds(20));
+*   co_await coro::outgoing_capacity();
+*   co_await gst::set_state(pipeline, GST_STATE_PLAYING, deadline);  // gst_awaiters.hpp
+*
+* A suspended coroutine holds no thread; every awaiter resumes it through the
+* Scheduler, i.e. as a task on the executor pool. Coroutine frames come from
+* the SlabAllocator, so thousands of concurrent operations cost pooled chunks
+* rather than heap allocations or threads.
+*/
+namespace coro
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Resumes coroutines on the executor pool, now or when a timer expires.
+    // Timers live in a TimerWheel (1 ms ticks) driven by one timer thread,
+    // which posts expired callbacks to the pool in batches. Also gates
+    // producers on the depth of the outgoing result queue.
+    class Scheduler
+    {
+    public:
+        explicit Scheduler(BS::thread_pool<>& pool);
+        ~Scheduler();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // runs fn (resumes h) as a task on the pool
+        void post(std::move_only_function<void()> fn) { m_pool.detach_task(std::move(fn)); }
+        void post(std::coroutine_handle<> h) { post([h] { h.resume(); }); }
+
+        // posts fn when due is reached (at once after shutdown()); the id cancels it until then
+        TimerWheel::TimerId post_at(Clock::time_point due, std::move_only_function<void()> fn);
+        TimerWheel::TimerId post_after(Clock::duration delay, std::move_only_function<void()> fn) { return post_at(Clock::now() + delay, std::move(fn)); }
+        // false when the timer was posted already
+        bool cancel(TimerWheel::TimerId id);
+        size_t pending_timers();
+
+        // call before the pool drains: pending and new timers fire at once, so every coroutine completes
+        void shutdown();
+        bool stopping() const noexcept { return m_bStopping.load(std::memory_order_acquire); }
+
+        // the queue outgoing_capacity() waits on: depth() above limit suspends the awaiting coroutine;
+        // call before coroutines run
+        void set_backlog(std::function<size_t()> depth, size_t limit);
+        // suspends h until the backlog drained below its limit; false when there is room already
+        bool wait_for_capacity(std::coroutine_handle<> h);
+        // consumer thread: call after draining the backlog
+        void on_backlog_drained();
+
+    private:
+        // the timer thread: sleeps until the wheel's next expiry and posts what expired
+        void run_timers();
+
+        BS::thread_pool<>& m_pool;
+
+        std::mutex m_timerMutex;
+        std::condition_variable m_timerCv;
+        TimerWheel m_timers;
+        Clock::time_point m_nextWakeup = Clock::time_point::max();  // what the timer thread sleeps until
+        std::atomic<bool> m_bStopping { false };
+        bool m_bExit = false;
+        std::thread m_timerThread;
+
+        std::function<size_t()> m_backlogDepth;                 // set before coroutines run
+        std::atomic<size_t> m_nBacklogLimit { SIZE_MAX };       // read outside m_capacityMutex; SIZE_MAX once shut down
+        std::mutex m_capacityMutex;
+        std::vector<std::coroutine_handle<>> m_capacityWaiters;
+        std::atomic<size_t> m_nCapacityWaiters { 0 };
+    };
+
+    // what every promise carries: the scheduler its awaiters resume through,
+    // and frames allocated from the slab
+    struct PromiseBase
+    {
+        Scheduler* scheduler = nullptr;
+
+        static void* operator new(size_t size) { return SlabAllocator::instance().allocate(size); }
+        static void operator delete(void* p, size_t size) noexcept { SlabAllocator::instance().deallocate(p, SlabAllocator::capacity_for(size)); }
+    };
+
+    template<typename T>
+    class Task;
+
+    namespace detail
+    {
+        // symmetric transfer back to the awaiting coroutine
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+            template<typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                auto continuation = h.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() const noexcept { }
+        };
+
+        template<typename T>
+        struct TaskPromiseBase : PromiseBase
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr error;
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void unhandled_exception() noexcept { error = std::current_exception(); }
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase<T>
+        {
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+            void return_value(T v) { value.emplace(std::move(v)); }
+            T take()
+            {
+                if (this->error) std::rethrow_exception(this->error);
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase<void>
+        {
+            Task<void> get_return_object() noexcept;
+            void return_void() noexcept { }
+            void take()
+            {
+                if (this->error) std::rethrow_exception(this->error);
+            }
+        };
+    }
+
+    // Lazy coroutine: starts when awaited, runs on the awaiting coroutine's
+    // scheduler, and returns its value (or rethrows) to the awaiter.
+    template<typename T = void>
+    class [[nodiscard]] Task
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+        using value_type = T;
+
+        explicit Task(std::coroutine_handle<promise_type> h) noexcept : m_handle(h) { }
+        Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) { }
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_handle) m_handle.destroy();
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+        ~Task()
+        {
+            if (m_handle) m_handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> awaiting) noexcept
+        {
+            m_handle.promise().continuation = awaiting;
+            m_handle.promise().scheduler = awaiting.promise().scheduler;
+            return m_handle;
+        }
+
+        T await_resume() { return m_handle.promise().take(); }
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    template<typename T>
+    Task<T> detail::TaskPromise<T>::get_return_object() noexcept { return Task<T> { std::coroutine_handle<TaskPromise>::from_promise(*this) }; }
+
+    inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept { return Task<void> { std::coroutine_handle<TaskPromise>::from_promise(*this) }; }
+
+    template<typename T>
+    inline constexpr bool is_task_v = false;
+    template<typename T>
+    inline constexpr bool is_task_v<Task<T>> = true;
+
+    // Top-level coroutine, owned by nobody: created suspended, started on a
+    // scheduler, and its frame is freed when it finishes. The body must not
+    // throw (the dispatcher's pool tasks are noexcept as well).
+    class Detached
+    {
+    public:
+        struct promise_type : PromiseBase
+        {
+            Detached get_return_object() noexcept { return Detached { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() noexcept { }
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+
+        // runs the coroutine on the calling thread up to its first suspension
+        void start(Scheduler& scheduler) &&
+        {
+            const auto h = std::exchange(m_handle, nullptr);
+            h.promise().scheduler = &scheduler;
+            h.resume();
+        }
+
+        ~Detached()
+        {
+            if (m_handle) m_handle.destroy();   // never started
+        }
+
+    private:
+        explicit Detached(std::coroutine_handle<promise_type> h) noexcept : m_handle(h) { }
+
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    // co_await sleep_until(t): resumes on the pool once t is reached
+    struct SleepAwaiter
+    {
+        Clock::time_point due;
+
+        bool await_ready() const noexcept { return due <= Clock::now(); }
+        template<typename P>
+        void await_suspend(std::coroutine_handle<P> h)
+        {
+            h.promise().scheduler->post_at(due, [h] { h.resume(); });
+        }
+        void await_resume() const noexcept { }
+    };
+
+    inline SleepAwaiter sleep_until(Clock::time_point due) noexcept { return { due }; }
+    inline SleepAwaiter sleep_for(Clock::duration delay) noexcept { return { Clock::now() + delay }; }
+
+    // co_await yield(): lets the tasks queued on the pool run first
+    struct YieldAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template<typename P>
+        void await_suspend(std::coroutine_handle<P> h) { h.promise().scheduler->post(std::coroutine_handle<> { h }); }
+        void await_resume() const noexcept { }
+    };
+
+    inline YieldAwaiter yield() noexcept { return {}; }
+
+    // co_await outgoing_capacity(): waits while the outgoing result queue is
+    // above its limit, so a coroutine producing many results backs off
+    // instead of growing the queue without bound
+    struct CapacityAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template<typename P>
+        bool await_suspend(std::coroutine_handle<P> h) { return h.promise().scheduler->wait_for_capacity(h); }
+        void await_resume() const noexcept { }
+    };
+
+    inline CapacityAwaiter outgoing_capacity() noexcept { return {}; }
+}
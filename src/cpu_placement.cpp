@@ -0,0 +1,104 @@
+#include "headers.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+std::vector<unsigned> CpuPlacement::usable_cpus()
+{
+    std::vector<unsigned> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+#endif
+    if (cpus.empty())
+    {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// the usable CPUs not in taken; all usable CPUs if that leaves none
+static std::vector<unsigned> remaining_cpus(const std::vector<unsigned>& taken)
+{
+    std::vector<unsigned> usable = CpuPlacement::usable_cpus(), rest;
+    std::ranges::copy_if(usable, std::back_inserter(rest), [&](unsigned cpu) { return std::ranges::find(taken, cpu) == taken.end(); });
+    return rest.empty() ? usable : rest;
+}
+
+CpuPlacement CpuPlacement::from_lists(std::string_view ingress, std::string_view io, std::string_view workers)
+{
+    CpuPlacement placement { utils::parse_id_list(ingress), utils::parse_id_list(io), utils::parse_id_list(workers) };
+    if (placement.workers.empty() && !(placement.ingress.empty() && placement.io.empty()))
+    {
+        std::vector<unsigned> taken = placement.ingress;
+        taken.insert(taken.end(), placement.io.begin(), placement.io.end());
+        placement.workers = remaining_cpus(taken);
+    }
+    return placement;
+}
+
+CpuPlacement CpuPlacement::reserve(unsigned reserved)
+{
+    const std::vector<unsigned> usable = usable_cpus();
+    // at least one CPU is left for the workers
+    reserved = std::min<unsigned>(reserved, (unsigned)usable.size() - 1);
+    if (reserved == 0) return {};
+
+    CpuPlacement placement;
+    placement.ingress = { usable[0] };
+    if (reserved == 1) placement.io = { usable[0] };
+    else placement.io.assign(usable.begin() + 1, usable.begin() + reserved);
+    placement.workers.assign(usable.begin() + reserved, usable.end());
+    return placement;
+}
+
+unsigned CpuPlacement::worker_count() const noexcept
+{
+    return workers.empty() ? std::max(1u, std::thread::hardware_concurrency()) : (unsigned)workers.size();
+}
+
+void CpuPlacement::apply_io(zmq::context_t& ctx) const
+{
+#if defined(ZMQ_THREAD_AFFINITY_CPU_ADD)
+    for (unsigned cpu : io)
+    {
+        if (zmq_ctx_set(ctx.handle(), ZMQ_THREAD_AFFINITY_CPU_ADD, (int)cpu) != 0)
+            std::cerr << "Could not pin the ZMQ IO threads to CPU " << cpu << std::endl;
+    }
+#else
+    if (!io.empty())
+        std::cerr << "ZMQ_THREAD_AFFINITY_CPU_ADD is not supported by this libzmq, IO threads stay unpinned" << std::endl;
+#endif
+}
+
+bool CpuPlacement::pin_current_thread(const std::vector<unsigned>& cpus)
+{
+    if (cpus.empty()) return false;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus)
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        std::cerr << "Could not pin thread to CPU " << cpus[0] << (cpus.size() > 1 ? " and others" : "") << std::endl;
+        return false;
+    }
+
+    // memory follows the placement when all the CPUs are on one node
+    const unsigned node = numa::node_of_cpu(cpus[0]);
+    if (std::ranges::all_of(cpus, [node](unsigned cpu) { return numa::node_of_cpu(cpu) == node; }))
+        numa::prefer_node(node);
+    return true;
+#else
+    return false;
+#endif
+}
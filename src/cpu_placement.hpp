@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <zmq.hpp>
+
+/**
+* CPU placement of the dispatcher's threads, by role:
+*   ingress - the thread running DispatcherServer::run(), which also publishes
+*   io      - ZMQ's IO thread(s)
+*   workers - the executor pool: one worker per CPU, each pinned to its CPU
+* Configured with explicit CPU lists, or by reserving the first N usable CPUs
+* for ingress and IO; the workers get the CPUs left over. A pinned thread
+* prefers memory on the NUMA node of its CPUs, and threads it starts (e.g.
+* GStreamer streaming threads started from a task) inherit its affinity.
+* An empty role is not pinned.
+*/
+struct CpuPlacement
+{
+    std::vector<unsigned> ingress;
+    std::vector<unsigned> io;
+    std::vector<unsigned> workers;
+
+    bool empty() const noexcept { return ingress.empty() && io.empty() && workers.empty(); }
+
+    // the CPUs this process may run on (its affinity mask: taskset, cpusets)
+    static std::vector<unsigned> usable_cpus();
+
+    // Linux style lists such as "0", "1", "2-15"; without a worker list the
+    // workers take the usable CPUs not used for ingress and IO
+    static CpuPlacement from_lists(std::string_view ingress, std::string_view io, std::string_view workers);
+
+    // the first usable CPU runs ingress, the next reserved - 1 run ZMQ IO (or
+    // IO shares the ingress CPU when only one is reserved); workers get the rest
+    static CpuPlacement reserve(unsigned reserved);
+
+    // executor size: one worker per worker CPU, hardware_concurrency() when unplaced
+    unsigned worker_count() const noexcept;
+
+    // pins ZMQ's IO threads; must run before the context creates its first socket
+    void apply_io(zmq::context_t& ctx) const;
+
+    // call on the ingress thread before it allocates (pools, arenas), so its memory is node-local
+    void pin_ingress() const { pin_current_thread(ingress); }
+
+    // call on executor worker idx when it starts
+    void pin_worker(size_t idx) const
+    {
+        if (!workers.empty()) pin_current_thread({ workers[idx % workers.size()] });
+    }
+
+    // pins the calling thread to cpus and prefers their NUMA node's memory when they share one
+    static bool pin_current_thread(const std::vector<unsigned>& cpus);
+};
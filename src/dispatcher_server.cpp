@@ -0,0 +1,240 @@
+#include "headers.hpp"
+
+zmq::socket_t DispatcherServer::create_pub_socket(zmq::context_t& ctx, const std::string& address)
+{
+    zmq::socket_t publisher(ctx, ZMQ_PUB);
+    // set socket options for performance
+    publisher.set(zmq::sockopt::sndbuf, 1024 * 1024);  // 1MB send buffer
+    publisher.set(zmq::sockopt::sndhwm, 1000);         // High-water mark
+    publisher.set(zmq::sockopt::linger, 0);            // after close, die immediately
+    publisher.set(zmq::sockopt::immediate, 1);         // drop messages if client is not fully connected
+    // no xpub_nodrop: it refuses the send for every subscriber once one of them is at its HWM,
+    // so one stalled client would stop the results of all; a full subscriber loses its own
+    // messages instead, and recovers a lost result with rpc.resend
+    publisher.bind(address);
+    return publisher;
+}
+
+zmq::socket_t DispatcherServer::create_sub_socket(zmq::context_t& ctx, const std::string& address)
+{
+    zmq::socket_t listener(ctx, ZMQ_SUB);
+    // Set socket options for performance
+    listener.set(zmq::sockopt::rcvbuf, 1024 * 1024);  // 1MB receive buffer
+    listener.set(zmq::sockopt::rcvhwm, 1000);         // High-water mark
+    listener.set(zmq::sockopt::linger, 0);            // after close, die immediately
+    listener.bind(address);
+    listener.set(zmq::sockopt::subscribe, "");        // receive all topics
+    return listener;
+}
+
+// the ingress thread's publisher in the direct publishing mode, subscribed before the first ack goes out
+static zmq::socket_t connect_proxy_publisher(const PublishProxy& proxy)
+{
+    zmq::socket_t publisher = proxy.connect_publisher();
+    if (!PublishProxy::wait_ready(publisher, std::chrono::seconds(1)))
+        std::cerr << "Publish proxy: no subscription from the proxy yet, the first replies may be lost" << std::endl;
+    return publisher;
+}
+
+DispatcherServer::DispatcherServer(zmq::context_t& ctx, Options options)
+    : m_options(std::move(options)),
+    m_cmdListener(create_sub_socket(ctx, m_options.cmd_address)),
+    m_pProxy(m_options.worker_publish ? std::make_unique<PublishProxy>(ctx, m_options.pub_address) : nullptr),
+    m_msgHandler(m_pProxy ? connect_proxy_publisher(*m_pProxy) : create_pub_socket(ctx, m_options.pub_address),
+        m_options.placement, m_pProxy.get(), m_options.fair_queue, m_options.retransmit),
+    m_spin((uint64_t)std::max<int64_t>(m_options.busy_poll_us, 0) * 1000)
+{
+    TRACY_ZONE;
+
+    if (m_spin.enabled())
+        m_msgHandler.set_busy_poll(&m_spin);
+
+    if (!m_options.journal_path.empty())
+        m_pJournal = std::make_unique<RequestJournal>(m_options.journal_path, m_options.journal_size_mb << 20);
+
+    if (!m_options.json_cmd_address.empty())
+        m_jsonListener = create_sub_socket(ctx, m_options.json_cmd_address);
+
+    if (m_options.instance_id)
+        set_pipeline_instance(m_options.instance_id);
+
+    if (m_options.pipeline_budget)
+        set_pipeline_budget(*m_options.pipeline_budget);
+
+    if (!m_options.broker_address.empty())
+    {
+        if (m_options.advertised_cmd_address.empty()) m_options.advertised_cmd_address = broker::advertised_address(m_options.cmd_address);
+        if (m_options.advertised_pub_address.empty()) m_options.advertised_pub_address = broker::advertised_address(m_options.pub_address);
+        m_reporter = zmq::socket_t(ctx, ZMQ_PUSH);
+        m_reporter.set(zmq::sockopt::conflate, 1);     // only the latest report matters
+        m_reporter.set(zmq::sockopt::linger, 0);
+        m_reporter.connect(m_options.broker_address);
+    }
+
+    if (m_options.handle_signals)
+    {
+        // setup shutdown signal listener, then the handlers that signal it
+        m_shutdownListener = zmq::socket_t(ctx, ZMQ_PAIR);
+        m_shutdownListener.bind(SHUTDOWN_INPROC_ADDR);
+        m_shutdownListener.set(zmq::sockopt::linger, 0);
+        setup_shutdown_handlers(ctx);
+    }
+}
+
+void DispatcherServer::stop() noexcept
+{
+    m_bStop.store(true, std::memory_order_release);
+    m_stopBell.ring();
+}
+
+bool DispatcherServer::should_stop() const noexcept
+{
+    return m_bStop.load(std::memory_order_acquire) || (m_options.handle_signals && shouldExit());
+}
+
+size_t DispatcherServer::drain_listeners()
+{
+    size_t nReceived = 0;
+    zmq::message_t msg;
+    // Process all available messages
+    while (should_stop() == false && m_cmdListener.recv(msg, zmq::recv_flags::dontwait).has_value())
+    {
+        // captured before handling: the handler takes the frame over
+        if (m_pJournal) m_pJournal->append(journal::Channel::Binary, msg.data(), msg.size(), metrics::now_ns());
+
+        // Parse and dispatch with zero-copy
+        m_msgHandler.handle_incoming_message(std::move(msg));
+        ++nReceived;
+
+        // publish results that completed meanwhile
+        m_msgHandler.publish_outgoing_messages();
+    }
+    while (m_jsonListener && should_stop() == false && m_jsonListener.recv(msg, zmq::recv_flags::dontwait).has_value())
+    {
+        // the handler parses a copy of the frame, so the capture sees the text as received
+        if (m_pJournal) m_pJournal->append(journal::Channel::Json, msg.data(), msg.size(), metrics::now_ns());
+        m_msgHandler.handle_incoming_json(std::move(msg));
+        ++nReceived;
+        m_msgHandler.publish_outgoing_messages();
+    }
+    return nReceived;
+}
+
+void DispatcherServer::spin(uint64_t until_ns)
+{
+    TRACY_ZONE_NAMED("ingress.spin");
+    uint64_t now = metrics::now_ns();
+    uint64_t deadline = std::min(now + m_spin.budget_ns(), until_ns);
+    while (now < deadline && should_stop() == false)
+    {
+        const size_t nReceived = drain_listeners();
+        m_msgHandler.publish_outgoing_messages();
+        now = metrics::now_ns();
+        if (nReceived)
+        {
+            m_spin.on_arrival(now, true);
+            deadline = std::min(now + m_spin.budget_ns(), until_ns);
+        }
+        else AdaptiveSpin::cpu_relax();
+    }
+    TRACY_PLOT("spin budget us", (int64_t)(m_spin.budget_ns() / 1000));
+}
+
+void DispatcherServer::report_load()
+{
+    const MessageHandler::Load load = m_msgHandler.load();
+    SlabBuffer reportBuf;
+    broker::write_report(reportBuf, { m_options.instance_id, m_options.advertised_cmd_address, m_options.advertised_pub_address,
+        load.queued, load.in_flight, load.pipelines });
+    m_reporter.send(std::move(reportBuf).to_message(), zmq::send_flags::dontwait);
+}
+
+void DispatcherServer::run()
+{
+    TRACY_ZONE;
+    constexpr size_t NONE = ~size_t(0);
+
+    // Polling items; the doorbells are left out where the platform has no eventfd
+    std::vector<zmq::pollitem_t> items = { {m_cmdListener, 0, ZMQ_POLLIN, 0} };
+    auto add_item = [&items](zmq::pollitem_t item) { items.push_back(item); return items.size() - 1; };
+    const size_t nOutgoing = m_msgHandler.outgoing_fd() >= 0 ? add_item({ nullptr, m_msgHandler.outgoing_fd(), ZMQ_POLLIN, 0 }) : NONE;
+    const size_t nStop = m_stopBell.fd() >= 0 ? add_item({ nullptr, m_stopBell.fd(), ZMQ_POLLIN, 0 }) : NONE;
+    const size_t nShutdown = m_options.handle_signals ? add_item({ m_shutdownListener, 0, ZMQ_POLLIN, 0 }) : NONE;
+    const size_t nJson = m_jsonListener ? add_item({ m_jsonListener, 0, ZMQ_POLLIN, 0 }) : NONE;
+    auto fired = [&items](size_t idx) { return idx != NONE && (items[idx].revents & ZMQ_POLLIN); };
+
+    // without the doorbell fds, queued results and stop() are picked up on a short poll timeout
+    const bool bCanBlock = nOutgoing != NONE && nStop != NONE;
+    const int64_t nStatsIntervalMs = m_options.stats_interval_ms;
+    auto nextStatsAt = std::chrono::steady_clock::now() + std::chrono::milliseconds { nStatsIntervalMs };
+    // registers with the broker right away, then reports periodically
+    const auto reportInterval = std::chrono::milliseconds { std::max<int64_t>(m_options.report_interval_ms, 1) };
+    auto nextReportAt = std::chrono::steady_clock::now();
+
+    while (should_stop() == false)
+    {
+        try
+        {
+            // Wait indefinitely either till a message or a stop/SIG event received
+            auto pollTimeout = std::chrono::milliseconds { bCanBlock ? -1 : 1 };
+            if (nStatsIntervalMs > 0)
+            {
+                auto untilStats = std::chrono::ceil<std::chrono::milliseconds>(nextStatsAt - std::chrono::steady_clock::now());
+                untilStats = std::max(untilStats, std::chrono::milliseconds { 0 });
+                pollTimeout = pollTimeout.count() < 0 ? untilStats : std::min(pollTimeout, untilStats);
+            }
+            if (m_reporter)
+            {
+                auto untilReport = std::chrono::ceil<std::chrono::milliseconds>(nextReportAt - std::chrono::steady_clock::now());
+                untilReport = std::max(untilReport, std::chrono::milliseconds { 0 });
+                pollTimeout = pollTimeout.count() < 0 ? untilReport : std::min(pollTimeout, untilReport);
+            }
+            zmq::poll(items, pollTimeout);
+
+            // Check for shutdown
+            if (fired(nShutdown) || fired(nStop) || should_stop())
+                break;
+
+            if (nOutgoing == NONE || fired(nOutgoing))
+                m_msgHandler.on_outgoing_ready();
+
+            if (nStatsIntervalMs > 0 && std::chrono::steady_clock::now() >= nextStatsAt)
+            {
+                m_msgHandler.publish_stats_notification();
+                nextStatsAt += std::chrono::milliseconds { nStatsIntervalMs };
+            }
+
+            if (m_reporter && std::chrono::steady_clock::now() >= nextReportAt)
+            {
+                this->report_load();
+                nextReportAt = std::chrono::steady_clock::now() + reportInterval;
+            }
+
+            if ((items[0].revents & ZMQ_POLLIN) || fired(nJson))
+            {
+                if (drain_listeners() && m_spin.enabled())
+                    m_spin.on_arrival(metrics::now_ns(), false);
+            }
+
+            // hybrid mode: spin for the next message instead of blocking right away
+            if (m_spin.enabled())
+            {
+                auto due_ns = [](std::chrono::steady_clock::time_point at) {
+                    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count();
+                };
+                const uint64_t nStatsDueNs = nStatsIntervalMs > 0 ? due_ns(nextStatsAt) : UINT64_MAX;
+                const uint64_t nReportDueNs = m_reporter ? due_ns(nextReportAt) : UINT64_MAX;
+                spin(std::min(nStatsDueNs, nReportDueNs));
+            }
+        }
+        catch (const zmq::error_t& e)
+        {
+            std::cerr << "ZeroMQ error: " << e.what() << '\n';
+            break;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error: " << e.what() << '\n';
+        }
+    }
+}
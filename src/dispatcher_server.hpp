@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <zmq.hpp>
+
+/**
+* The dispatcher core: receives binary requests on a SUB socket (and, when
+* json_cmd_address is set, JSON-RPC text requests on a second one), runs them on
+* the worker pool and publishes acks, results and notifications on a PUB
+* socket. The caller owns the zmq::context_t, so producers living in the same
+* process can use inproc:// endpoints and hand frames over without a copy or
+* a trip through the TCP stack.
+*
+* Both sockets are bound in the constructor; run() drives the poll loop on
+* the calling thread until stop() is called. With a CpuPlacement, the caller
+* applies its IO part to the context and pins the thread that will call run()
+* before constructing the server, so the context's IO threads and the
+* server's allocations follow the placement too.
+*
+* With journal_path, every received frame is appended to a RequestJournal
+* before it is handled, for replay with zmq-journal-replay.
+*
+* With broker_address, the server is one instance behind a Broker: it pushes
+* its load to the broker's registry every report_interval_ms (the first report
+* registers it) and stamps instance_id on the pipeline ids it hands out, so
+* the broker sends a pipeline's later commands back here.
+* @example:
+    zmq::context_t ctx { 1 };
+    DispatcherServer server(ctx, { .cmd_address = "inproc://cmd", .pub_address = "inproc://pub" });
+    std::jthread loop([&] { server.run(); });
+    ... producers connect a PUB socket to inproc://cmd, a SUB socket to inproc://pub ...
+    server.stop();
+*/
+class DispatcherServer
+{
+public:
+    struct Options
+    {
+        std::string cmd_address = "tcp://localhost:5555";  // SUB: requests in
+        std::string pub_address = "tcp://localhost:5556";  // PUB: acks, results, notifications out
+        std::string json_cmd_address {};    // SUB: JSON-RPC text requests in, empty = off
+        int64_t stats_interval_ms = 0;      // periodic rpc.stats notifications, 0 = off
+        int64_t busy_poll_us = 0;           // hybrid ingress: max spin after the last message before blocking, 0 = off
+        bool worker_publish = false;        // workers publish results directly through an inproc XSUB/XPUB proxy
+        std::string journal_path {};        // capture every received frame to this request journal, empty = off
+        size_t journal_size_mb = 1024;      // the journal's size on disk; capture stops when it is full
+        FairQueue::Options fair_queue {};   // per-client fair queuing into the workers, off unless fair_queue.enabled
+        RetransmitBuffer::Options retransmit {};    // recent results kept for rpc.resend, off with a 0 limit
+        std::optional<PipelineBudget::Options> pipeline_budget {};  // admits pipeline Starts by CPU budget, off without
+        std::string broker_address {};      // PUSH: load reports to a Broker's registry, empty = standalone
+        uint8_t instance_id = 0;            // unique among a broker's instances; the high byte of the pipeline ids
+        std::string advertised_cmd_address {};  // where the broker reaches cmd_address, empty = cmd_address with * as localhost
+        std::string advertised_pub_address {};  // likewise for pub_address
+        int64_t report_interval_ms = 200;   // load report period
+        CpuPlacement placement {};          // sizes and pins the workers; ingress and IO are pinned by the caller (see below)
+        bool handle_signals = false;        // also stop on SIGINT/SIGTERM (shutdown.hpp); one server per process
+    };
+
+    DispatcherServer(zmq::context_t& ctx, Options options);
+
+    DispatcherServer(const DispatcherServer&) = delete;
+    DispatcherServer& operator=(const DispatcherServer&) = delete;
+
+    // polls and dispatches on the calling thread until stop()
+    void run();
+
+    // thread-safe; run() returns after its current iteration
+    void stop() noexcept;
+
+    const Options& options() const noexcept { return m_options; }
+
+private:
+    static zmq::socket_t create_pub_socket(zmq::context_t& ctx, const std::string& address);
+    static zmq::socket_t create_sub_socket(zmq::context_t& ctx, const std::string& address);
+    bool should_stop() const noexcept;
+    // drains both request sockets without blocking; returns the number of requests
+    size_t drain_listeners();
+    // hybrid mode: keeps draining while messages arrive within the spin budget, at most until until_ns
+    void spin(uint64_t until_ns);
+    // pushes the current load to the broker
+    void report_load();
+
+    Options m_options;
+    zmq::socket_t m_cmdListener;
+    zmq::socket_t m_jsonListener;       // only with json_cmd_address
+    zmq::socket_t m_shutdownListener;   // only with handle_signals
+    std::unique_ptr<PublishProxy> m_pProxy; // only with worker_publish; outlives the handler's sockets
+    std::unique_ptr<RequestJournal> m_pJournal; // only with journal_path
+    zmq::socket_t m_reporter;           // only with broker_address
+    MessageHandler m_msgHandler;
+    Doorbell m_stopBell;
+    AdaptiveSpin m_spin;
+    std::atomic<bool> m_bStop { false };
+};
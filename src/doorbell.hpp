@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <zmq.hpp>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+/**
+* Wakes a thread blocked in zmq::poll() from any other thread. Only the first
+* ring() after the consumer's reset() touches the kernel, so a burst of
+* producers costs one eventfd write.
+* On platforms without eventfd, fd() is -1 and the consumer has to poll with
+* a timeout instead.
+*/
+class Doorbell
+{
+    std::atomic<bool> m_bRung { false };
+#if defined(__linux__)
+    int m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    int m_fd = -1;
+#endif
+public:
+    Doorbell() = default;
+    Doorbell(const Doorbell&) = delete;
+    Doorbell& operator=(const Doorbell&) = delete;
+
+    ~Doorbell()
+    {
+#if defined(__linux__)
+        if (m_fd >= 0) close(m_fd);
+#endif
+    }
+
+    // file descriptor to add to the zmq poll items (ZMQ_POLLIN)
+    zmq_fd_t fd() const noexcept { return m_fd; }
+
+    // any thread: call after publishing work for the consumer
+    void ring() noexcept
+    {
+        if (m_bRung.exchange(true, std::memory_order_acq_rel)) return;
+#if defined(__linux__)
+        const uint64_t one = 1;
+        [[maybe_unused]] auto n = write(m_fd, &one, sizeof(one));
+#endif
+    }
+
+    // consumer: call before draining the work
+    void reset() noexcept
+    {
+        m_bRung.store(false, std::memory_order_release);
+#if defined(__linux__)
+        uint64_t count;
+        [[maybe_unused]] auto n = read(m_fd, &count, sizeof(count));
+#endif
+    }
+};
@@ -0,0 +1,194 @@
+#include "headers.hpp"
+#include "fair_queue.hpp"
+
+// id:weight[:max_in_flight]
+static bool parse_client(std::string_view entry, TClientID& id, FairQueue::ClientLimits& limits)
+{
+    uint32_t fields[3] = { 0, 1, 0 };
+    size_t nFields = 0;
+    const char* p = entry.data();
+    const char* const end = entry.data() + entry.size();
+    while (nFields < 3)
+    {
+        auto [next, ec] = std::from_chars(p, end, fields[nFields]);
+        if (ec != std::errc {}) return false;
+        ++nFields;
+        if (next == end) break;
+        if (*next != ':') return false;
+        p = next + 1;
+    }
+    if (nFields < 2 || p > end) return false;
+    id = fields[0];
+    limits = { fields[1], fields[2] };
+    return true;
+}
+
+bool FairQueue::Options::parse_clients(std::string_view spec)
+{
+    bool bValid = true;
+    while (!spec.empty())
+    {
+        const size_t comma = spec.find(',');
+        const std::string_view entry = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view {} : spec.substr(comma + 1);
+
+        TClientID id;
+        ClientLimits limits;
+        if (parse_client(entry, id, limits)) clients[id] = limits;
+        else bValid = false;
+    }
+    return bValid;
+}
+
+FairQueue::FairQueue(BS::thread_pool<>& pool, Doorbell& wake, Options options)
+    : m_pool(pool),
+    m_wake(wake),
+    m_options(std::move(options)),
+    m_nWindow(m_options.window ? m_options.window : 2 * std::max<size_t>(pool.get_thread_count(), 1))
+{ }
+
+FairQueue::Client& FairQueue::client(TClientID id)
+{
+    auto [it, bInserted] = m_clients.try_emplace(id);
+    if (bInserted)
+    {
+        it->second = std::make_unique<Client>();
+        Client& c = *it->second;
+        c.id = id;
+        const auto limits = m_options.clients.find(id);
+        c.limits = limits != m_options.clients.end() ? limits->second : m_options.defaults;
+        c.limits.weight = std::max<uint32_t>(c.limits.weight, 1);
+    }
+    return *it->second;
+}
+
+bool FairQueue::push(TClientID id, Task&& task)
+{
+    Client& c = client(id);
+    if (c.queue.size() >= m_options.max_queued)
+    {
+        ++m_nRejected;
+        return false;
+    }
+    c.queue.push_back(std::move(task));
+    // before the window is checked: a worker finishing from here on sees the request waiting
+    m_nQueued.fetch_add(1, std::memory_order_seq_cst);
+    if (!c.bActive && !c.bParked)
+    {
+        c.bActive = true;
+        m_active.push_back(&c);
+    }
+    this->pump();
+    return true;
+}
+
+namespace
+{
+    // the slot of the task running on this worker, for hold_slot()
+    thread_local FairQueue::Slot* t_pRunningSlot = nullptr;
+}
+
+FairQueue::Slot FairQueue::hold_slot() noexcept
+{
+    if (!t_pRunningSlot) return {};
+    return std::move(*std::exchange(t_pRunningSlot, nullptr));
+}
+
+void FairQueue::complete(Client& c) noexcept
+{
+    c.in_flight.fetch_sub(1, std::memory_order_seq_cst);
+    // c may be swept from here on
+    m_nInFlight.fetch_sub(1, std::memory_order_seq_cst);
+    if (m_nQueued.load(std::memory_order_seq_cst)) m_wake.ring();
+}
+
+void FairQueue::send(Client& c)
+{
+    std::move_only_function<void()> run = [this, &c, task = std::move(c.queue.front())]() mutable noexcept {
+        // given back when the task returns, unless it took the slot over
+        Slot slot(this, &c);
+        t_pRunningSlot = &slot;
+        task();
+        t_pRunningSlot = nullptr;
+    };
+    c.queue.pop_front();
+    m_nQueued.fetch_sub(1, std::memory_order_relaxed);
+    c.in_flight.fetch_add(1, std::memory_order_relaxed);
+    m_nInFlight.fetch_add(1, std::memory_order_relaxed);
+    m_pool.detach_task(std::move(run));
+}
+
+void FairQueue::pump()
+{
+    // parked clients whose requests completed meanwhile take their turns again
+    std::erase_if(m_parked, [this](Client* pClient) {
+        if (at_cap(*pClient)) return false;
+        pClient->bParked = false;
+        pClient->bActive = true;
+        m_active.push_back(pClient);
+        return true;
+    });
+
+    while (!m_active.empty() && m_nInFlight.load(std::memory_order_seq_cst) < m_nWindow)
+    {
+        Client& c = *m_active.front();
+        if (!c.bTurn)
+        {
+            c.deficit += c.limits.weight;
+            c.bTurn = true;
+        }
+        while (c.deficit && !c.queue.empty() && !at_cap(c) && m_nInFlight.load(std::memory_order_seq_cst) < m_nWindow)
+        {
+            this->send(c);
+            --c.deficit;
+        }
+
+        if (c.queue.empty() || at_cap(c))
+        {
+            // credit is not saved up while idle or capped
+            m_active.pop_front();
+            c.deficit = 0;
+            c.bTurn = false;
+            c.bActive = false;
+            if (!c.queue.empty())
+            {
+                c.bParked = true;
+                m_parked.push_back(&c);
+            }
+        }
+        else if (c.deficit == 0)
+        {
+            // turn over: to the back of the round
+            m_active.pop_front();
+            m_active.push_back(&c);
+            c.bTurn = false;
+        }
+        else break;     // the window is full; the turn goes on when a request completes
+    }
+
+    if (m_clients.size() > m_nSweepAt)
+    {
+        this->sweep();
+        m_nSweepAt = std::max(MAX_IDLE_CLIENTS, 2 * m_clients.size());
+    }
+}
+
+void FairQueue::flush()
+{
+    for (Client* pClient : m_active)
+        while (!pClient->queue.empty()) this->send(*pClient);
+    for (Client* pClient : m_parked)
+        while (!pClient->queue.empty()) this->send(*pClient);
+    m_active.clear();
+    m_parked.clear();
+    for (auto& [id, pClient] : m_clients)
+        pClient->bActive = pClient->bParked = pClient->bTurn = false;
+}
+
+void FairQueue::sweep()
+{
+    std::erase_if(m_clients, [](const auto& item) {
+        const Client& c = *item.second;
+        return !c.bActive && !c.bParked && c.queue.empty() && c.in_flight.load(std::memory_order_acquire) == 0;
+    });
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BS_thread_pool.hpp"
+
+/**
+* Per-client fair queuing in front of the worker pool. Requests wait in one
+* FIFO per client; at most window of them are on the pool at a time, picked
+* by deficit round robin: every turn a client earns its weight in credits
+* and sends requests while it has credit for them, so a busy client gets its
+* weighted share of the workers and can not push the other clients' requests
+* behind its backlog. A client also has a cap on its requests on the pool,
+* and a bound on its queue beyond which push() refuses its requests: the
+* overload of one client only fills its own queue.
+*
+* Main thread only, except for the tasks, which report their completion from
+* the workers and ring wake when requests are waiting for the window. A task
+* that finishes later than it returns (a coroutine handler suspends) keeps
+* its place in the window with hold_slot() until it completes.
+*/
+class FairQueue
+{
+    struct Client;
+
+public:
+    using Task = std::move_only_function<void()>;
+
+    // a started request's place in the window and under its client's cap; given back when destroyed
+    class Slot
+    {
+    public:
+        Slot() noexcept = default;
+        Slot(Slot&& other) noexcept : m_pQueue(std::exchange(other.m_pQueue, nullptr)), m_pClient(other.m_pClient) { }
+        Slot& operator=(Slot&&) = delete;
+        ~Slot() { if (m_pQueue) m_pQueue->complete(*m_pClient); }
+
+    private:
+        friend class FairQueue;
+        Slot(FairQueue* pQueue, Client* pClient) noexcept : m_pQueue(pQueue), m_pClient(pClient) { }
+
+        FairQueue* m_pQueue = nullptr;
+        Client* m_pClient = nullptr;
+    };
+
+    struct ClientLimits
+    {
+        uint32_t weight = 1;        // credits per turn; a request costs 1
+        uint32_t max_in_flight = 0; // its requests on the pool at a time, 0 = no cap
+    };
+
+    struct Options
+    {
+        bool enabled = false;
+        size_t window = 0;          // requests on the pool at a time, 0 = two per worker
+        size_t max_queued = 4096;   // per client; push() refuses beyond
+        ClientLimits defaults {};   // for the clients not listed in clients
+        std::unordered_map<TClientID, ClientLimits> clients {};
+
+        // "id:weight[:max_in_flight],..." as in FAIR_QUEUE_CLIENTS="1:4:8,2:1"; false when an entry was malformed (and skipped)
+        bool parse_clients(std::string_view spec);
+    };
+
+    FairQueue(BS::thread_pool<>& pool, Doorbell& wake, Options options);
+
+    FairQueue(const FairQueue&) = delete;
+    FairQueue& operator=(const FairQueue&) = delete;
+
+    // queues task for client and starts what the window allows; false when the client's queue is full
+    bool push(TClientID client, Task&& task);
+    // hands the waiting requests to the pool while the window and the clients' caps allow
+    void pump();
+    // at shutdown: hands every waiting request to the pool regardless of the window
+    void flush();
+    // worker thread, in a task the queue started: its slot, held until the Slot is destroyed
+    // instead of until the task returns; an empty Slot in any other task
+    static Slot hold_slot() noexcept;
+
+    size_t queued() const noexcept { return m_nQueued.load(std::memory_order_relaxed); }
+    size_t in_flight() const noexcept { return m_nInFlight.load(std::memory_order_relaxed); }
+    size_t window() const noexcept { return m_nWindow; }
+    size_t clients() const noexcept { return m_clients.size(); }
+    uint64_t rejected() const noexcept { return m_nRejected; }
+
+private:
+    struct Client
+    {
+        TClientID id = 0;
+        ClientLimits limits;
+        std::deque<Task> queue;
+        std::atomic<uint32_t> in_flight { 0 };  // decremented by the workers
+        uint32_t deficit = 0;
+        bool bActive = false;   // in m_active
+        bool bParked = false;   // in m_parked: at its cap with requests waiting
+        bool bTurn = false;     // its turn started and its quantum was added
+    };
+
+    Client& client(TClientID id);
+    bool at_cap(const Client& c) const noexcept
+    {
+        return c.limits.max_in_flight && c.in_flight.load(std::memory_order_seq_cst) >= c.limits.max_in_flight;
+    }
+    void send(Client& c);
+    // worker thread: a request of c completed
+    void complete(Client& c) noexcept;
+    // drops the state of the clients without work; runs once there are many of them
+    void sweep();
+    static constexpr size_t MAX_IDLE_CLIENTS = 4096;
+
+    BS::thread_pool<>& m_pool;
+    Doorbell& m_wake;
+    const Options m_options;
+    const size_t m_nWindow;
+
+    std::unordered_map<TClientID, std::unique_ptr<Client>> m_clients;
+    std::deque<Client*> m_active;   // round robin order of the clients with requests to send
+    std::vector<Client*> m_parked;
+    std::atomic<size_t> m_nQueued { 0 };    // read by the workers: wake only with requests waiting
+    std::atomic<size_t> m_nInFlight { 0 };
+    uint64_t m_nRejected = 0;
+    size_t m_nSweepAt = MAX_IDLE_CLIENTS;
+};
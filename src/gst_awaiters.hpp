@@ -0,0 +1,165 @@
+#pragma once
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "coro_task.hpp"
+
+/**
+* GStreamer awaiters for coroutine handlers (coro_task.hpp). Bus messages are
+* caught with the bus' sync-message signal, on the thread that posts them (no
+* GMainLoop needed); the waiting coroutine is resumed on the executor pool.
+* Every wait has a deadline, so nothing stays suspended on a pipeline that
+* never answers.
+*/
+namespace gst
+{
+    struct MessageUnref
+    {
+        void operator()(GstMessage* msg) const noexcept { gst_message_unref(msg); }
+    };
+    using MessagePtr = std::unique_ptr<GstMessage, MessageUnref>;
+
+    struct BusWait
+    {
+        MessagePtr message;     // the matching message; null on timeout or when satisfied() held
+        bool timed_out = false;
+    };
+
+    // co_await bus_message(bus, match, deadline[, satisfied]): the first message on bus that match()
+    // accepts. satisfied() is checked once the watch is in place, for conditions that may have
+    // become true before (a state already reached); it completes the wait without a message.
+    class BusMessageAwaiter
+    {
+    public:
+        BusMessageAwaiter(GstBus* bus, std::function<bool(GstMessage*)> match, coro::Clock::time_point deadline,
+            std::function<bool()> satisfied = {})
+            : m_pState(std::make_shared<State>())
+        {
+            m_pState->bus = GST_BUS(gst_object_ref(bus));
+            m_pState->match = std::move(match);
+            m_pState->deadline = deadline;
+            m_satisfied = std::move(satisfied);
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        template<typename P>
+        bool await_suspend(std::coroutine_handle<P> h)
+        {
+            State& state = *m_pState;
+            state.scheduler = h.promise().scheduler;
+            state.handle = h;
+            // held throughout: once connected, a worker may resume the coroutine and block in
+            // await_resume on the lock, so this awaiter stays alive until we return
+            std::lock_guard<std::mutex> lock(state.mutex);
+            gst_bus_enable_sync_message_emission(state.bus);
+            state.handler_id = g_signal_connect_data(state.bus, "sync-message", G_CALLBACK(&State::on_message),
+                new std::shared_ptr<State>(m_pState), &State::release, GConnectFlags(0));
+            if (m_satisfied && m_satisfied() && !state.claimed.exchange(true, std::memory_order_acq_rel))
+                return false;
+            state.scheduler->post_at(state.deadline, [pState = m_pState] {
+                if (!pState->claimed.exchange(true, std::memory_order_acq_rel))
+                {
+                    pState->timed_out = true;
+                    pState->handle.resume();
+                }
+            });
+            return true;
+        }
+
+        BusWait await_resume()
+        {
+            State& state = *m_pState;
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                g_signal_handler_disconnect(state.bus, state.handler_id);
+                gst_bus_disable_sync_message_emission(state.bus);
+            }
+            return { MessagePtr(std::exchange(state.message, nullptr)), state.timed_out };
+        }
+
+    private:
+        struct State
+        {
+            GstBus* bus = nullptr;
+            std::function<bool(GstMessage*)> match;
+            coro::Clock::time_point deadline;
+            coro::Scheduler* scheduler = nullptr;
+            std::coroutine_handle<> handle;
+            std::mutex mutex;
+            gulong handler_id = 0;
+            std::atomic<bool> claimed { false };    // the message, the deadline or satisfied(): whoever comes first resumes
+            GstMessage* message = nullptr;
+            bool timed_out = false;
+
+            ~State()
+            {
+                if (message) gst_message_unref(message);
+                gst_object_unref(bus);
+            }
+
+            // streaming thread
+            static void on_message(GstBus*, GstMessage* msg, gpointer data)
+            {
+                State& state = **static_cast<std::shared_ptr<State>*>(data);
+                if (state.claimed.load(std::memory_order_acquire) || !state.match(msg)) return;
+                if (state.claimed.exchange(true, std::memory_order_acq_rel)) return;
+                state.message = gst_message_ref(msg);
+                state.scheduler->post(state.handle);
+            }
+
+            static void release(gpointer data, GClosure*) { delete static_cast<std::shared_ptr<State>*>(data); }
+        };
+
+        std::shared_ptr<State> m_pState;
+        std::function<bool()> m_satisfied;
+    };
+
+    inline BusMessageAwaiter bus_message(GstBus* bus, std::function<bool(GstMessage*)> match, coro::Clock::time_point deadline,
+        std::function<bool()> satisfied = {})
+    {
+        return { bus, std::move(match), deadline, std::move(satisfied) };
+    }
+
+    // co_await set_state(element, state, deadline): SUCCESS (or NO_PREROLL) once element reached
+    // state, FAILURE when the change failed, an error was posted or the deadline passed
+    inline coro::Task<GstStateChangeReturn> set_state(GstElement* element, GstState state, coro::Clock::time_point deadline)
+    {
+        GstStateChangeReturn ret = gst_element_set_state(element, state);
+        if (ret != GST_STATE_CHANGE_ASYNC)
+            co_return ret;
+
+        GstBus* bus = gst_element_get_bus(element);
+        auto match = [element](GstMessage* msg) {
+            return GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR
+                || (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_STATE_CHANGED && GST_MESSAGE_SRC(msg) == GST_OBJECT(element));
+        };
+        auto reached = [element, state] {
+            GstState current = GST_STATE_VOID_PENDING;
+            return gst_element_get_state(element, &current, nullptr, 0) == GST_STATE_CHANGE_SUCCESS && current == state;
+        };
+        for (;;)
+        {
+            BusWait wait = co_await bus_message(bus, match, deadline, reached);
+            if (wait.timed_out || (wait.message && GST_MESSAGE_TYPE(wait.message.get()) == GST_MESSAGE_ERROR))
+            {
+                ret = GST_STATE_CHANGE_FAILURE;
+                break;
+            }
+            GstState reachedState = GST_STATE_VOID_PENDING;
+            if (wait.message) gst_message_parse_state_changed(wait.message.get(), nullptr, &reachedState, nullptr);
+            if (!wait.message || reachedState == state)
+            {
+                ret = GST_STATE_CHANGE_SUCCESS;
+                break;
+            }
+        }
+        gst_object_unref(bus);
+        co_return ret;
+    }
+}
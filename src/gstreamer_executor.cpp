@@ -1,63 +1,105 @@
+#include "headers.hpp"
 #include "gstreamer_executor.hpp"
+#include "gst_awaiters.hpp"     // header only; built with the executor (ENABLE_GSTREAMER)
 #include <iostream>
 #include <glib.h>
 
 // Define sample pipelines
-const std::string GStreamerPipelineExecutor::AUDIO_TEST_PIPELINE = 
+const std::string GStreamerPipelineExecutor::AUDIO_TEST_PIPELINE =
     "audiotestsrc wave=white-noise ! audioconvert ! autoaudiosink";
 
-const std::string GStreamerPipelineExecutor::VIDEO_TEST_PIPELINE = 
+const std::string GStreamerPipelineExecutor::VIDEO_TEST_PIPELINE =
     "videotestsrc pattern=smpte ! videoconvert ! autovideosink";
 
-const std::string GStreamerPipelineExecutor::AUDIO_VIDEO_TEST_PIPELINE = 
+const std::string GStreamerPipelineExecutor::AUDIO_VIDEO_TEST_PIPELINE =
     "videotestsrc pattern=smpte ! videoconvert ! autovideosink "
     "audiotestsrc wave=sine ! audioconvert ! autoaudiosink";
 
-GStreamerPipelineExecutor::GStreamerPipelineExecutor(size_t thread_count) 
-    : m_thread_pool(thread_count) {
+GStreamerPipelineExecutor::GStreamerPipelineExecutor(size_t thread_count,
+                                                     PipelineBudget::Options budget,
+                                                     std::chrono::milliseconds sample_interval)
+    : m_thread_pool(thread_count),
+      m_budget(std::move(budget)),
+      m_sample_interval(sample_interval) {
     // Initialize GStreamer
     gst_init(nullptr, nullptr);
+
+    m_sampler = std::jthread([this](std::stop_token stop) {
+        std::mutex mutex;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!m_sampler_wakeup.wait_for(lock, stop, m_sample_interval, [] { return false; }) && !stop.stop_requested()) {
+            sample_pipelines();
+        }
+    });
 }
 
 GStreamerPipelineExecutor::~GStreamerPipelineExecutor() {
+    m_sampler.request_stop();
+    m_sampler.join();
     stop_all_pipelines();
+    m_thread_pool.wait();
 }
 
-void GStreamerPipelineExecutor::execute_pipeline(const std::string& pipeline_config, 
-                                               PipelineCallback callback,
-                                               const std::string& pipeline_id) {
+GStreamerPipelineExecutor::Admission GStreamerPipelineExecutor::execute_pipeline(const std::string& pipeline_config,
+                                                                                 PipelineCallback callback,
+                                                                                 const std::string& pipeline_id,
+                                                                                 double cpu_estimate) {
     std::string id = pipeline_id.empty() ? std::to_string(reinterpret_cast<uintptr_t>(this)) : pipeline_id;
 
     {
-        std::lock_guard<std::mutex> lock(m_pipeline_mutex);
-        if (m_pipelines.find(id) != m_pipelines.end()) {
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
+        if (m_pipelines.find(id) != m_pipelines.end() || m_pending.find(id) != m_pending.end()) {
             std::cerr << "Pipeline with ID " << id << " already exists\n";
-            return;
+            return Admission::Rejected;
+        }
+
+        const Admission admission = m_budget.admit(id, cpu_estimate);
+        if (admission == Admission::Rejected) {
+            std::cerr << "Pipeline " << id << " rejected: no CPU budget left on this host\n";
+            return admission;
+        }
+        if (admission == Admission::Queued) {
+            m_pending[id] = { pipeline_config, std::move(callback) };
+            return admission;
         }
     }
 
-    m_thread_pool.push_task([this, pipeline_config, callback, id] {
+    launch(id, pipeline_config, std::move(callback));
+    return Admission::Admitted;
+}
+
+void GStreamerPipelineExecutor::launch(const std::string& id, const std::string& pipeline_config, PipelineCallback callback) {
+    m_thread_pool.detach_task([this, pipeline_config, callback, id] {
         GError* error = nullptr;
         GstElement* pipeline = gst_parse_launch(pipeline_config.c_str(), &error);
 
         if (error) {
             std::cerr << "Failed to create pipeline: " << error->message << "\n";
             g_error_free(error);
+            launch_admitted(m_budget.release(id));
             return;
         }
 
         auto pipeline_data = std::make_unique<PipelineData>();
+        pipeline_data->executor = this;
+        pipeline_data->id = id;
         pipeline_data->pipeline = pipeline;
         pipeline_data->running = true;
         pipeline_data->callback = callback;
+        pipeline_data->cpus = m_budget.placement(id);
+        PipelineData* data = pipeline_data.get();
 
-        // Set up bus callback
+        // Set up bus callback; stream status messages are handled synchronously,
+        // on the streaming thread that posts them, before the pipeline starts
         GstBus* bus = gst_element_get_bus(pipeline);
-        pipeline_data->bus_watch_id = gst_bus_add_watch(bus, bus_callback, pipeline_data.get());
+        pipeline_data->bus_watch_id = gst_bus_add_watch(bus, bus_callback, data);
+        gst_bus_enable_sync_message_emission(bus);
+        pipeline_data->stream_status_handler = g_signal_connect(bus, "sync-message::stream-status",
+                                                                G_CALLBACK(stream_status_callback), data);
         gst_object_unref(bus);
 
         {
-            std::lock_guard<std::mutex> lock(m_pipeline_mutex);
+            std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
             m_pipelines[id] = std::move(pipeline_data);
         }
 
@@ -71,32 +113,89 @@ void GStreamerPipelineExecutor::execute_pipeline(const std::string& pipeline_con
 
         // Run main loop for this pipeline
         GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
-        while (m_pipelines[id]->running) {
+        while (data->running) {
             g_main_context_iteration(g_main_loop_get_context(loop), FALSE);
             std::this_thread::yield(); // Avoid busy waiting
         }
         g_main_loop_unref(loop);
+        // frees its budget for the queued starts
+        cleanup_pipeline(id);
     });
 }
 
+void GStreamerPipelineExecutor::launch_admitted(const std::vector<std::string>& pipeline_ids) {
+    for (const std::string& id : pipeline_ids) {
+        PendingStart start;
+        {
+            std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
+            auto it = m_pending.find(id);
+            if (it == m_pending.end()) {
+                continue;
+            }
+            start = std::move(it->second);
+            m_pending.erase(it);
+        }
+        launch(id, start.pipeline_config, std::move(start.callback));
+    }
+}
+
 void GStreamerPipelineExecutor::stop_pipeline(const std::string& pipeline_id) {
-    std::lock_guard<std::mutex> lock(m_pipeline_mutex);
-    auto it = m_pipelines.find(pipeline_id);
-    if (it != m_pipelines.end()) {
-        it->second->running = false;
+    std::vector<std::string> admitted;
+    {
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
+        auto it = m_pipelines.find(pipeline_id);
+        if (it != m_pipelines.end()) {
+            it->second->running = false;
+        } else if (m_pending.erase(pipeline_id)) {
+            admitted = m_budget.release(pipeline_id);
+        }
     }
+    launch_admitted(admitted);
 }
 
 void GStreamerPipelineExecutor::stop_all_pipelines() {
-    std::lock_guard<std::mutex> lock(m_pipeline_mutex);
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
+    // dropping a queued start may admit the next ones, which are dropped as well
+    std::vector<std::string> dropped;
+    for (auto& [id, start] : m_pending) {
+        dropped.push_back(id);
+    }
+    m_pending.clear();
+    while (!dropped.empty()) {
+        std::vector<std::string> admitted = m_budget.release(dropped.back());
+        dropped.pop_back();
+        dropped.insert(dropped.end(), admitted.begin(), admitted.end());
+    }
     for (auto& [id, pipeline_data] : m_pipelines) {
         pipeline_data->running = false;
     }
 }
 
+void GStreamerPipelineExecutor::sample_pipelines() {
+    {
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
+        for (auto& [id, pipeline_data] : m_pipelines) {
+            m_budget.report_cpu(id, pipeline_data->cpu.sample());
+
+            GstQuery* query = gst_query_new_latency();
+            if (gst_element_query(pipeline_data->pipeline, query)) {
+                gboolean live = FALSE;
+                GstClockTime min_latency = 0, max_latency = 0;
+                gst_query_parse_latency(query, &live, &min_latency, &max_latency);
+                if (live && GST_CLOCK_TIME_IS_VALID(min_latency)) {
+                    pipeline_data->min_latency = min_latency;
+                }
+            }
+            gst_query_unref(query);
+        }
+    }
+    // measurements may have freed budget
+    launch_admitted(m_budget.admit_queued());
+}
+
 gboolean GStreamerPipelineExecutor::bus_callback(GstBus* bus, GstMessage* message, gpointer data) {
     auto* pipeline_data = static_cast<PipelineData*>(data);
-    
+
     switch (GST_MESSAGE_TYPE(message)) {
         case GST_MESSAGE_EOS:
             pipeline_data->running = false;
@@ -111,6 +210,20 @@ gboolean GStreamerPipelineExecutor::bus_callback(GstBus* bus, GstMessage* messag
             pipeline_data->running = false;
             break;
         }
+        case GST_MESSAGE_QOS: {
+            // proportion > 1: the sinks want upstream slower, the pipeline does not keep up.
+            // A live pipeline whose buffers arrive later than its latency lets them is short too.
+            gint64 jitter = 0;
+            gdouble proportion = 1.0;
+            gint quality = 0;
+            gst_message_parse_qos_values(message, &jitter, &proportion, &quality);
+            const GstClockTime min_latency = pipeline_data->min_latency;
+            if (jitter > 0 && min_latency > 0) {
+                proportion = std::max(proportion, 1.0 + (double)jitter / (double)min_latency);
+            }
+            pipeline_data->executor->m_budget.report_qos(pipeline_data->id, proportion);
+            break;
+        }
         default:
             break;
     }
@@ -122,23 +235,50 @@ gboolean GStreamerPipelineExecutor::bus_callback(GstBus* bus, GstMessage* messag
     return TRUE;
 }
 
+void GStreamerPipelineExecutor::stream_status_callback(GstBus* bus, GstMessage* message, gpointer data) {
+    auto* pipeline_data = static_cast<PipelineData*>(data);
+    GstStreamStatusType type;
+    GstElement* owner = nullptr;
+    gst_message_parse_stream_status(message, &type, &owner);
+
+    switch (type) {
+        case GST_STREAM_STATUS_TYPE_ENTER:
+            pipeline_data->cpu.add_current_thread();
+            CpuPlacement::pin_current_thread(pipeline_data->cpus);
+            break;
+        case GST_STREAM_STATUS_TYPE_LEAVE:
+            pipeline_data->cpu.remove_current_thread();
+            break;
+        default:
+            break;
+    }
+}
+
 void GStreamerPipelineExecutor::cleanup_pipeline(const std::string& pipeline_id) {
-    std::lock_guard<std::mutex> lock(m_pipeline_mutex);
-    auto it = m_pipelines.find(pipeline_id);
-    if (it != m_pipelines.end()) {
-        auto* pipeline_data = it->second.get();
-        
-        if (pipeline_data->bus_watch_id) {
-            GstBus* bus = gst_element_get_bus(pipeline_data->pipeline);
-            gst_bus_remove_watch(bus);
-            gst_object_unref(bus);
+    {
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_pipeline_mutex);
+        auto it = m_pipelines.find(pipeline_id);
+        if (it == m_pipelines.end()) {
+            return;
         }
-        
+        auto* pipeline_data = it->second.get();
+
         if (pipeline_data->pipeline) {
+            // stops the streaming threads, which still post their LEAVE status
             gst_element_set_state(pipeline_data->pipeline, GST_STATE_NULL);
+
+            GstBus* bus = gst_element_get_bus(pipeline_data->pipeline);
+            if (pipeline_data->stream_status_handler) {
+                g_signal_handler_disconnect(bus, pipeline_data->stream_status_handler);
+            }
+            if (pipeline_data->bus_watch_id) {
+                gst_bus_remove_watch(bus);
+            }
+            gst_object_unref(bus);
             gst_object_unref(pipeline_data->pipeline);
         }
-        
+
         m_pipelines.erase(it);
     }
-}
\ No newline at end of file
+    launch_admitted(m_budget.release(pipeline_id));
+}
@@ -4,20 +4,39 @@
 #include <memory>
 #include <string>
 #include <functional>
-#include <bs_thread_pool.hpp>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
+#include "BS_thread_pool.hpp"
+#include "pipeline_budget.hpp"
+#include "tracer.hpp"
+
+/**
+* Runs GStreamer pipelines within the host's CPU budget (PipelineBudget).
+* Every pipeline's streaming threads are measured (per-thread CPU time) and
+* pinned to the CPUs the budget placed it on as they start; its QoS messages
+* and a periodic latency query tell when it runs late. A Start that does not
+* fit is queued and launched once running pipelines free enough, or rejected
+* when the queue is full.
+*/
 class GStreamerPipelineExecutor {
 public:
     using PipelineCallback = std::function<void(GstMessage*)>;
-    
+    using Admission = PipelineBudget::Admission;
+
     // Pipeline configurations
     static const std::string AUDIO_TEST_PIPELINE;
     static const std::string VIDEO_TEST_PIPELINE;
     static const std::string AUDIO_VIDEO_TEST_PIPELINE;
 
-    GStreamerPipelineExecutor(size_t thread_count = std::thread::hardware_concurrency());
+    GStreamerPipelineExecutor(size_t thread_count = std::thread::hardware_concurrency(),
+                              PipelineBudget::Options budget = {},
+                              std::chrono::milliseconds sample_interval = std::chrono::milliseconds(1000));
     ~GStreamerPipelineExecutor();
 
     // Delete copy/move constructors and assignment operators
@@ -26,29 +45,57 @@ public:
     GStreamerPipelineExecutor(GStreamerPipelineExecutor&&) = delete;
     GStreamerPipelineExecutor& operator=(GStreamerPipelineExecutor&&) = delete;
 
-    // Execute a pipeline asynchronously
-    void execute_pipeline(const std::string& pipeline_config, 
-                         PipelineCallback callback = nullptr,
-                         const std::string& pipeline_id = "");
+    // Execute a pipeline asynchronously, expected to use cpu_estimate cores (0 = the budget's default):
+    // Admitted starts it now, Queued once there is budget, Rejected does not start it
+    Admission execute_pipeline(const std::string& pipeline_config,
+                               PipelineCallback callback = nullptr,
+                               const std::string& pipeline_id = "",
+                               double cpu_estimate = 0);
 
-    // Stop a specific pipeline
+    // Stop a specific pipeline (or drop its queued start)
     void stop_pipeline(const std::string& pipeline_id);
 
     // Stop all pipelines
     void stop_all_pipelines();
 
+    // cores committed to the running pipelines, and how many run and wait
+    PipelineBudget::Stats budget_stats() const { return m_budget.stats(); }
+
 private:
     struct PipelineData {
+        GStreamerPipelineExecutor* executor = nullptr;
+        std::string id;
         GstElement* pipeline = nullptr;
         std::atomic<bool> running{false};
         guint bus_watch_id = 0;
+        gulong stream_status_handler = 0;
+        PipelineCallback callback;
+        std::vector<unsigned> cpus;                 // its streaming threads are pinned here
+        ThreadCpuMeter cpu;                         // its streaming threads' CPU time
+        std::atomic<GstClockTime> min_latency{0};   // from the last latency query, 0 = unknown
+    };
+    struct PendingStart {
+        std::string pipeline_config;
         PipelineCallback callback;
     };
 
-    bs::thread_pool m_thread_pool;
+    BS::thread_pool<> m_thread_pool;
     std::unordered_map<std::string, std::unique_ptr<PipelineData>> m_pipelines;
-    std::mutex m_pipeline_mutex;
+    std::unordered_map<std::string, PendingStart> m_pending;    // queued by the budget
+    TRACY_LOCKABLE(std::mutex, m_pipeline_mutex, "pipelines");
+    PipelineBudget m_budget;
+    const std::chrono::milliseconds m_sample_interval;
+    std::condition_variable_any m_sampler_wakeup;
+    std::jthread m_sampler;     // last: measures the pipelines above
+
+    void launch(const std::string& pipeline_id, const std::string& pipeline_config, PipelineCallback callback);
+    // launches the queued starts the budget admitted
+    void launch_admitted(const std::vector<std::string>& pipeline_ids);
+    // sampler thread: CPU use and latency of every pipeline, then the queued starts that fit now
+    void sample_pipelines();
 
     static gboolean bus_callback(GstBus* bus, GstMessage* message, gpointer data);
+    // streaming threads announce themselves on their own thread (GST_MESSAGE_STREAM_STATUS)
+    static void stream_status_callback(GstBus* bus, GstMessage* message, gpointer data);
     void cleanup_pipeline(const std::string& pipeline_id);
-};
\ No newline at end of file
+};
@@ -1,6 +1,7 @@
 #ifndef _C6A9C1C6_1DD6_46CA_91B2_4D7CE9409612_
 #define _C6A9C1C6_1DD6_46CA_91B2_4D7CE9409612_
 
+#include <algorithm>
 #include <cassert>
 #include <csignal>
 #include <fmt/format.h>
@@ -13,9 +14,28 @@
 
 #include "BS_thread_pool.hpp"
 
+#include "busy_poll.hpp"
+#include "timer_wheel.hpp"
+#include "coro_task.hpp"
+#include "cpu_placement.hpp"
+#include "pipeline_budget.hpp"
+#include "doorbell.hpp"
+#include "request_arena.hpp"
 #include "methods.hpp"
-#include "messages.hpp"
+#include "fair_queue.hpp"
+#include "metrics.hpp"
 #include "mpsc_queue.hpp"
+#include "numa_memory.hpp"
+#include "slab_allocator.hpp"
+#include "publish_proxy.hpp"
+#include "response_writer.hpp"
+#include "response_cache.hpp"
+#include "retransmit_buffer.hpp"
+#include "messages.hpp"
+#include "request_journal.hpp"
+#include "rpc_client.hpp"
+#include "broker.hpp"
+#include "dispatcher_server.hpp"
 #include "shutdown.hpp"
 #include "tracer.hpp"
 #include "utils.hpp"
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <simdjson.h>
+#include <zmq.hpp>
+
+/**
+* Decoding of JSON-RPC request text into the same MethodParams<MID> the
+* binary frames decode to:
+*   {"jsonrpc":"2.0","id":7,"method":"GStreamer_Pipeline_Stop","params":{"pipeline_id":3}}
+* Param names are the Payload<MID> field names. String params stay views into
+* the frame: escaped strings are unescaped in place (they only get shorter).
+* The frame therefore has to be writable, stable and not shared: the one
+* make_parseable() returns.
+*/
+namespace json_ingress
+{
+    // A frame simdjson can parse in place: a copy of msg in a slab backed
+    // message of its own, followed by SIMDJSON_PADDING zeroed bytes. The
+    // received frame is never written to nor read past its end: zmq may share
+    // it (zmq_msg_copy) with the journal or other holders.
+    inline zmq::message_t make_parseable(zmq::message_t&& msg)
+    {
+        return SlabBuffer::copy_to_message(msg.to_string_view(), simdjson::SIMDJSON_PADDING);
+    }
+
+    // string value as a view into the frame
+    inline simdjson::error_code get_string_in_place(simdjson::ondemand::value value, std::string_view& out)
+    {
+        // the raw token is "..." followed by any whitespace up to the next structural
+        const std::string_view raw = value.raw_json_token();
+        std::string_view unescaped;
+        if (auto err = value.get_string().get(unescaped)) return err;
+
+        char* pDest = const_cast<char*>(raw.data()) + 1;
+        const size_t raw_len = raw.rfind('"') - 1;
+        // no escapes: the bytes in the frame are the string already
+        if (raw_len != unescaped.size())
+            std::memcpy(pDest, unescaped.data(), unescaped.size());
+        out = { pDest, unescaped.size() };
+        return simdjson::SUCCESS;
+    }
+
+    inline simdjson::error_code get_pipeline_id(simdjson::ondemand::object& params, TPipelineID& out)
+    {
+        uint64_t id = 0;
+        if (auto err = params.find_field_unordered("pipeline_id").get_uint64().get(id)) return err;
+        if (id > UINT32_MAX) return simdjson::NUMBER_OUT_OF_RANGE;
+        out = (TPipelineID)id;
+        return simdjson::SUCCESS;
+    }
+
+    // per method "params" decoding, mirrors Payload<MID>::decode
+    template<MethodID MID>
+    simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MID>& out);
+
+    template<>
+    inline simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MethodID::GStreamer_Pipeline_Start>& out)
+    {
+        simdjson::ondemand::value value;
+        if (auto err = params.find_field_unordered("pipeline_config").get(value)) return err;
+        return get_string_in_place(value, out.pipeline_config);
+    }
+
+    template<>
+    inline simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MethodID::GStreamer_Pipeline_Stop>& out)
+    {
+        return get_pipeline_id(params, out.pipeline_id);
+    }
+
+    template<>
+    inline simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MethodID::GStreamer_Pipeline_Pause>& out)
+    {
+        return get_pipeline_id(params, out.pipeline_id);
+    }
+
+    template<>
+    inline simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MethodID::GStreamer_Pipeline_Resume>& out)
+    {
+        return get_pipeline_id(params, out.pipeline_id);
+    }
+
+    template<>
+    inline simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MethodID::GStreamer_Pipeline_Status>& out)
+    {
+        return get_pipeline_id(params, out.pipeline_id);
+    }
+
+    template<>
+    inline simdjson::error_code decode_payload(simdjson::ondemand::object& params, Payload<MethodID::RPC_Resend>& out)
+    {
+        return params.find_field_unordered("req_id").get_uint64().get(out.req_id);
+    }
+}
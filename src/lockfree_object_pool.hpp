@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <memory>
 #include <vector>
 #include <thread>
@@ -8,7 +10,9 @@
 #include <stdexcept>
 #include <concepts>
 #include <condition_variable>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <optional>
@@ -16,9 +20,15 @@
 #include <iostream>
 #include <future>
 #include <chrono>
+#include <utility>
+
+#include "numa_memory.hpp"
+#include "tracer.hpp"
 
 // Enable PMR support if available
-#define LFOP_USE_PMR 0
+#ifndef LFOP_USE_PMR
+#define LFOP_USE_PMR 1
+#endif
 
 #if LFOP_USE_PMR
 #include <memory_resource>
@@ -26,37 +36,130 @@
 
 #if defined(_DEBUG)
 #define LFOP_DEBUG 1
-#else 
+#else
 #undef LFOP_DEBUG
 #endif
 
+// Number of live pools per element type T. Each pool owns one slot of a flat
+// thread_local array, so acquire/release index straight into their cache.
+#ifndef LFOP_MAX_POOL_SLOTS
+#define LFOP_MAX_POOL_SLOTS 16
+#endif
+
+static_assert(LFOP_MAX_POOL_SLOTS <= 64, "pool slots are tracked in a 64-bit mask");
+
+// The global free list is sharded per NUMA node (node id modulo this count)
+#ifndef LFOP_MAX_NUMA_NODES
+#define LFOP_MAX_NUMA_NODES 4
+#endif
+
+// Objects up to this size are packed tightly instead of one per cache line.
+// Neighbouring objects may then share a line; set to 0 to always pad.
+#ifndef LFOP_COMPACT_NODE_MAX_SIZE
+#define LFOP_COMPACT_NODE_MAX_SIZE 32
+#endif
+
+struct ObjectPoolStats
+{
+    uint64_t acquires = 0;      // lags by what threads did since their last slow path
+    uint64_t local_hits = 0;    // served from the thread's magazines
+    uint64_t global_hits = 0;   // magazines popped from the node-local global list
+    uint64_t remote_hits = 0;   // magazines stolen from another node's list
+    uint64_t expansions = 0;    // blocks allocated after construction
+    uint64_t global_pushes = 0; // magazines handed back to the global lists
+    size_t total_objects = 0;
+
+    ObjectPoolStats& operator+=(const ObjectPoolStats& o) noexcept
+    {
+        acquires += o.acquires; local_hits += o.local_hits; global_hits += o.global_hits;
+        remote_hits += o.remote_hits; expansions += o.expansions; global_pushes += o.global_pushes;
+        total_objects += o.total_objects;
+        return *this;
+    }
+};
+
+/**
+* Objects move between threads and the global free list in magazines: a
+* linked batch of nodes whose head records the batch size. A thread holds at
+* most two magazines (loaded + spare), and the global list is a Treiber stack
+* of magazines, so the shared CAS is paid once per magazine, not per object.
+* There is one such stack per NUMA node; threads push to and pop from their
+* own node's stack and steal from remote nodes only when they cannot expand.
+*/
 template <typename T>
 class alignas(64) LockFreeObjectPool
 {
-    struct alignas(64) Node
+    static constexpr size_t NODE_ALIGN = sizeof(T) > LFOP_COMPACT_NODE_MAX_SIZE
+        ? 64 : std::max(alignof(T), alignof(void*));
+
+    // Pointers fit in 48 bits; the upper 16 bits of a tagged word carry
+    // either an ABA tag or a magazine size.
+    static constexpr unsigned TAG_SHIFT = 48;
+    static constexpr uint64_t PTR_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+    static_assert(sizeof(void*) == 8, "tagged free list assumes 64-bit pointers");
+
+    // While a node is free its link fields overlay the (destroyed) object
+    // storage, so the bookkeeping costs nothing while the object is in use.
+    struct alignas(NODE_ALIGN) Node
+    {
+        union
+        {
+            struct
+            {
+                Node* next;             // next node within the same magazine
+                uint64_t next_magazine; // head node only: next magazine on the global stack | node count << 48
+            } link;
+            alignas(T) std::byte storage[sizeof(T)];
+        };
+        Node() noexcept { }
+    };
+
+    struct Magazine
     {
-        std::atomic<Node*> next;
-        alignas(T) std::byte storage[sizeof(T)];
+        Node* head = nullptr;
+        size_t count = 0;
+    };
+
+    struct Block
+    {
+        Node* nodes;
+        size_t count;
     };
 
     // Configuration
-    const size_t m_nMax_Thread_Cache;
-    const size_t m_nBlockSize;
+    const size_t m_nMagazineSize;
 
-    // Free list
-    std::atomic<Node*> m_pFreeList { nullptr };
+    // Global stacks of magazines, one per NUMA node. The tag in the head is
+    // bumped on every update, so a pop racing with a pop+push of the same
+    // head node fails its CAS instead of corrupting the list (ABA).
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> head { 0 };
+    };
+    Shard m_shards[LFOP_MAX_NUMA_NODES];
 
-    // Thread-local state
+    // Thread-local state: one flat array per element type, indexed by pool slot
     struct ThreadCache
     {
-        Node* cache = nullptr;
-        size_t size = 0;
+        uint64_t owner = 0;     // generation of the pool that owns this slot; 0 = unused
+        uint64_t trim_epoch = 0;
+        unsigned shard = 0;     // free list shard of the thread's NUMA node
+        uint64_t acquires = 0;  // folded into m_nAcquires on the slow paths
+        Magazine loaded;        // acquire/release work on this magazine
+        Magazine spare;         // absorbs alternating acquire/release bursts
+#ifdef LFOP_DEBUG
+        bool registered = false;
+#endif
     };
-    thread_local static inline std::unordered_map<const void*, ThreadCache> m_PerPoolCache; // per pool, per thread cache
-    ThreadCache* m_pThreadCache = nullptr;
+    thread_local static inline ThreadCache m_tlsCaches[LFOP_MAX_POOL_SLOTS];
+    static inline std::atomic<uint64_t> s_nSlotsInUse { 0 };
+    static inline std::atomic<uint64_t> s_nGeneration { 0 };
+    size_t m_nSlot;
+    uint64_t m_nGeneration;
 
     // Scavenger thread (optional)
     std::jthread m_scavenger;
+    std::atomic<uint64_t> m_nTrimEpoch { 0 };
 
     // Reset hook
     using ResetHook = void(*)(T*);
@@ -67,64 +170,82 @@ class alignas(64) LockFreeObjectPool
     std::pmr::memory_resource* m_pmr;
 #endif
 
-    // Internal data
-    std::vector<std::unique_ptr<Node[]>> m_vecPreAllocBlocks;
+    // Internal data (guarded by m_mutex_Expand; touched only on expansion)
+    std::vector<Block> m_vecBlocks;
+    TRACY_LOCKABLE(std::mutex, m_mutex_Expand, "LockFreeObjectPool::expand");
 
     // dynamic expantion
     const bool m_bDynamicExpansion;
     size_t m_nMaxTotalObjects; // optional max limit
     std::atomic<size_t> m_nCurrentTotalObjects { 0 };
 
+    // statistics, only updated on the magazine (slow) paths
+    alignas(64) std::atomic<uint64_t> m_nAcquires { 0 };
+    std::atomic<uint64_t> m_nGlobalPops { 0 };
+    std::atomic<uint64_t> m_nGlobalPushes { 0 };
+    std::atomic<uint64_t> m_nSteals { 0 };
+    std::atomic<uint64_t> m_nExpansions { 0 };
+
 public:
+    using Stats = ObjectPoolStats;
+
+    Stats stats() const noexcept
+    {
+        Stats st;
+        st.acquires = m_nAcquires.load(std::memory_order_relaxed);
+        st.global_hits = m_nGlobalPops.load(std::memory_order_relaxed);
+        st.remote_hits = m_nSteals.load(std::memory_order_relaxed);
+        st.expansions = m_nExpansions.load(std::memory_order_relaxed);
+        st.global_pushes = m_nGlobalPushes.load(std::memory_order_relaxed);
+        st.total_objects = m_nCurrentTotalObjects.load(std::memory_order_relaxed);
+        const uint64_t misses = st.global_hits + st.remote_hits + st.expansions;
+        st.local_hits = st.acquires > misses ? st.acquires - misses : 0;
+        return st;
+    }
+
     void init_thread_cache()
     {
-        if (!m_pThreadCache)
-        {
-            const void* poolId = this;
-            auto [it, inserted] = m_PerPoolCache.try_emplace(poolId);
-            m_pThreadCache = &it->second;
-        }
+        this->thread_cache();
     }
 
+    /**
+    * @param max_thread_cache upper bound of objects cached per thread; a
+    *        magazine holds half of it.
+    * @param mr where blocks come from; numa::pool_resource() is NUMA-local,
+    *        huge page backed memory once the application installed it.
+    */
     explicit LockFreeObjectPool(size_t prealloc_count = 1024,
-        size_t max_thread_cache = 32, 
+        size_t max_thread_cache = 32,
         bool dynamic_expansion = true,
         size_t max_total_objects = SIZE_MAX,
         ResetHook reset_hook = nullptr
 #if LFOP_USE_PMR
-        , std::pmr::memory_resource* mr = std::pmr::get_default_resource()
+        , std::pmr::memory_resource* mr = numa::pool_resource()
 #endif
     )
-        : m_nMax_Thread_Cache(max_thread_cache),
-        m_nBlockSize((prealloc_count + max_thread_cache - 1) / max_thread_cache + 1),
-        m_bDynamicExpansion(dynamic_expansion),
-        m_nMaxTotalObjects(max_total_objects),
-        m_fnResetHook(reset_hook)
+        : m_nMagazineSize(std::clamp<size_t>(max_thread_cache / 2, 1, 0xFFFF)),
+        m_nSlot(acquire_slot()),
+        m_nGeneration(s_nGeneration.fetch_add(1, std::memory_order_relaxed) + 1),
+        m_fnResetHook(reset_hook),
 #if LFOP_USE_PMR
-        , m_pmr(mr)
+        m_pmr(mr),
 #endif
+        m_bDynamicExpansion(dynamic_expansion),
+        m_nMaxTotalObjects(max_total_objects)
     {
-        // Allocate memory using selected resource
-        auto block = this->allocate_block(prealloc_count);
-        m_vecPreAllocBlocks.push_back(std::move(block));
+        if (prealloc_count == 0) return;
 
-        // Build linked list
-        Node* head = block.get();
-        for (size_t i = 0; i < prealloc_count - 1; ++i)
-        {
-            block[i].next.store(&block[i + 1], std::memory_order_relaxed);
-        }
-        block[prealloc_count - 1].next.store(nullptr, std::memory_order_relaxed);
+        // Allocate memory using selected resource and hand it out in magazines.
+        // It lands on the constructing thread's node; other nodes expand locally.
+        Node* block = this->allocate_block(prealloc_count);
+        m_vecBlocks.push_back({ block, prealloc_count });
+        m_nCurrentTotalObjects.store(prealloc_count, std::memory_order_relaxed);
 
-        // Push into global list
-        Node* old_head = m_pFreeList.load(std::memory_order_relaxed);
-        do
+        const unsigned shard = numa::current_node() % LFOP_MAX_NUMA_NODES;
+        for (size_t i = 0; i < prealloc_count; i += m_nMagazineSize)
         {
-            block[prealloc_count - 1].next.store(old_head, std::memory_order_relaxed);
-        } while (!m_pFreeList.compare_exchange_weak(
-            old_head, &block[0],
-            std::memory_order_release,
-            std::memory_order_relaxed));
+            push_global(make_magazine(block + i, std::min(m_nMagazineSize, prealloc_count - i)), shard);
+        }
     }
 
     ~LockFreeObjectPool()
@@ -144,27 +265,24 @@ public:
             m_scavenger.join();
         }
 
-        // 4. Traverse and destroy global free list
-        this->clear_global_list();
+        // 4. Forget the destroying thread's cache. Caches of threads that never
+        // drained are discarded lazily: the slot generation no longer matches.
+        ThreadCache& tc = m_tlsCaches[m_nSlot];
+        if (tc.owner == m_nGeneration) tc = ThreadCache {};
+        s_nSlotsInUse.fetch_and(~(uint64_t(1) << m_nSlot), std::memory_order_release);
 
-        // 5. Deallocate preallocated blocks
-        for (auto& block : m_vecPreAllocBlocks)
+        // 5. Deallocate blocks. Free nodes hold no live objects (release()
+        // already ran their destructors); objects still acquired are leaked.
+        for (const Block& block : m_vecBlocks)
         {
-            for (size_t i = 0; i < m_nBlockSize; ++i)
-            {
-                Node& n = block[i];
-                T* obj = reinterpret_cast<T*>(n.storage.data());
-                if (reinterpret_cast<uintptr_t>(obj) & 1) continue; // skip already freed
-                obj->~T();
-                // Mark as freed
-                new (&obj) T* { nullptr }; // poison pointer
-            }
+            this->deallocate_block(block.nodes, block.count);
         }
     }
 
     template <typename... Args>
     T* acquire(Args&&... args)
     {
+        ThreadCache& tc = thread_cache();
 #ifdef LFOP_DEBUG
         if (m_bIsShuttingDown.load(std::memory_order_relaxed))
         {
@@ -172,27 +290,20 @@ public:
                 << " tried to acquire from a destroyed pool.\n";
             assert(false && "LFOP Misuse detected");
         }
-        if (!m_debugState.registered)
+        // Threads that never register (e.g. the ZMQ IO thread releasing sent
+        // buffers) still get a lazily created cache; registering only matters
+        // for draining that cache before the pool is destroyed.
+#endif
+        ++tc.acquires;
+        Node* node = tc.loaded.head;
+        if (node) [[likely]]
         {
-            std::cerr << "[ERROR] Thread " << std::this_thread::get_id()
-                << " used pool without registering via ThreadLocalPoolGuard.\n";
-            assert(false && "LFOP Misuse detected");
+            tc.loaded.head = node->link.next;
+            --tc.loaded.count;
         }
-#endif
-        Node* node = pop_cache();
-        if (!node) node = pop_global();
-
-        // allocate dynamically
-        if (!node && m_bDynamicExpansion)
+        else
         {
-            if (m_nCurrentTotalObjects.load(std::memory_order_relaxed) < m_nMaxTotalObjects)
-            {
-                node = allocate_new_node();
-                if (node)
-                {
-                    ++m_nCurrentTotalObjects;
-                }
-            }
+            node = refill(tc);
         }
 
         if (!node) [[unlikely]] {
@@ -201,15 +312,15 @@ public:
 
         try
         {
-            new (reinterpret_cast<T*>(node->storage.data())) T(std::forward<Args>(args)...);
+            new (node->storage) T(std::forward<Args>(args)...);
         }
         catch (...)
         {
-            push_global(node);
+            push_cache(tc, node);
             throw;
         }
 
-        return reinterpret_cast<T*>(node->storage.data());
+        return std::launder(reinterpret_cast<T*>(node->storage));
     }
 
     void release(T* obj) noexcept
@@ -223,9 +334,14 @@ public:
         if (m_fnResetHook) m_fnResetHook(obj);
         obj->~T();
 
-        push_cache(node);
+        push_cache(thread_cache(), node);
     }
 
+    /**
+    * Periodically asks every thread to hand its spare magazine back to the
+    * global list. Threads act on it at their next magazine exchange, since
+    * thread-local caches cannot be touched from another thread.
+    */
     void start_scavenger(size_t interval_ms = 1000)
     {
         m_scavenger = std::jthread([this, interval_ms](std::stop_token stoken)
@@ -233,7 +349,7 @@ public:
                 while (!stoken.stop_requested())
                 {
                     std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
-                    move_thread_cache_to_global();
+                    m_nTrimEpoch.fetch_add(1, std::memory_order_relaxed);
                 }
             });
     }
@@ -245,170 +361,216 @@ public:
         return std::shared_ptr<T>(obj, [this](T* ptr) { this->release(ptr); });
     }
 
+    // Returns the calling thread's magazines to the global list
+    void move_thread_cache_to_global() noexcept
+    {
+        ThreadCache& tc = thread_cache();
+        m_nAcquires.fetch_add(std::exchange(tc.acquires, 0), std::memory_order_relaxed);
+        push_global(std::exchange(tc.loaded, {}), tc.shard);
+        push_global(std::exchange(tc.spare, {}), tc.shard);
+    }
+
 private:
-    Node* allocate_block(size_t count)
+    static size_t acquire_slot()
     {
-#if LFOP_USE_PMR
-        void* raw = m_pmr->allocate(count * sizeof(Node), alignof(Node));
-        return new (raw) Node[count];
-#else
-        return new Node[count];
-#endif
+        uint64_t used = s_nSlotsInUse.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const uint64_t avail = ~used & (LFOP_MAX_POOL_SLOTS == 64 ? ~uint64_t(0) : (uint64_t(1) << LFOP_MAX_POOL_SLOTS) - 1);
+            if (!avail)
+                throw std::length_error("LockFreeObjectPool: more than LFOP_MAX_POOL_SLOTS live pools of one type");
+            const size_t slot = std::countr_zero(avail);
+            if (s_nSlotsInUse.compare_exchange_weak(used, used | (uint64_t(1) << slot), std::memory_order_acquire, std::memory_order_relaxed))
+                return slot;
+        }
     }
 
-    void deallocate_block(Node* ptr, size_t count)
+    ThreadCache& thread_cache() noexcept
     {
-#if LFOP_USE_PMR
-        m_pmr->deallocate(ptr, count * sizeof(Node), alignof(Node));
-#else
-        delete[] ptr;
-#endif
+        ThreadCache& tc = m_tlsCaches[m_nSlot];
+        if (tc.owner != m_nGeneration) [[unlikely]]
+        {
+            // first use on this thread, or the slot is left over from a destroyed pool
+            tc = ThreadCache {};
+            tc.owner = m_nGeneration;
+            tc.shard = numa::current_node() % LFOP_MAX_NUMA_NODES;
+            tc.trim_epoch = m_nTrimEpoch.load(std::memory_order_relaxed);
+        }
+        return tc;
     }
 
-    Node* allocate_new_node()
+    Node* allocate_block(size_t count)
     {
 #if LFOP_USE_PMR
-        void* raw = m_pmr->allocate(sizeof(Node), alignof(Node));
-        return new (raw) Node();
+        Node* nodes = static_cast<Node*>(m_pmr->allocate(count * sizeof(Node), alignof(Node)));
+        std::uninitialized_default_construct_n(nodes, count);
+        return nodes;
 #else
-        return new Node();
+        return new Node[count];
 #endif
     }
 
-    void deallocate_node(Node* node) noexcept
+    void deallocate_block(Node* ptr, [[maybe_unused]] size_t count)
     {
-        if (!node) return;
-
 #if LFOP_USE_PMR
-        m_pmr->deallocate(
-            reinterpret_cast<std::byte*>(node),
-            sizeof(Node),
-            alignof(Node)
-        );
+        m_pmr->deallocate(ptr, count * sizeof(Node), alignof(Node));
 #else
-        delete node;
+        delete[] ptr;
 #endif
     }
 
-    Node* pop_cache() noexcept
+    static Magazine make_magazine(Node* nodes, size_t count) noexcept
     {
-        if (m_pThreadCache->cache)
+        for (size_t i = 0; i + 1 < count; ++i)
         {
-            Node* node = m_pThreadCache->cache;
-            m_pThreadCache->cache = node->next.load(std::memory_order_relaxed);
-            --m_pThreadCache->size;
-            return node;
+            nodes[i].link.next = &nodes[i + 1];
         }
-        return nullptr;
+        nodes[count - 1].link.next = nullptr;
+        return { nodes, count };
     }
 
-    void push_cache(Node* node)
+    void push_cache(ThreadCache& tc, Node* node) noexcept
     {
-        if (m_pThreadCache->size < m_nMax_Thread_Cache)
-        {
-            node->next.store(m_pThreadCache->cache, std::memory_order_relaxed);
-            m_pThreadCache->cache = node;
-            ++m_pThreadCache->size;
-        }
-        else
+        if (tc.loaded.count >= m_nMagazineSize) [[unlikely]]
         {
-            push_global(node);
+            // loaded is full: park it as spare, shipping the older spare out if needed
+            if (tc.spare.count)
+            {
+                push_global(tc.spare, tc.shard);
+                m_nGlobalPushes.fetch_add(1, std::memory_order_relaxed);
+            }
+            tc.spare = std::exchange(tc.loaded, {});
+            trim(tc);
         }
+        node->link.next = tc.loaded.head;
+        tc.loaded.head = node;
+        ++tc.loaded.count;
     }
 
-    Node* pop_global() noexcept
+    // Slow path of acquire(): the loaded magazine is empty
+    Node* refill(ThreadCache& tc)
     {
-        Node* old_head = m_pFreeList.load(std::memory_order_acquire);
-        while (old_head)
+        m_nAcquires.fetch_add(std::exchange(tc.acquires, 0), std::memory_order_relaxed);
+        if (tc.spare.count)
         {
-            Node* new_head = old_head->next.load(std::memory_order_relaxed);
-            if (m_pFreeList.compare_exchange_weak(
-                old_head, new_head,
-                std::memory_order_release,
-                std::memory_order_acquire))
-            {
-                return old_head;
-            }
+            std::swap(tc.loaded, tc.spare);
+        }
+        else if (pop_global(tc.loaded, tc.shard))
+        {
+            m_nGlobalPops.fetch_add(1, std::memory_order_relaxed);
         }
-        return nullptr;
+        else if (!expand(tc.loaded, tc.shard))
+        {
+            if (!steal(tc.loaded, tc.shard)) return nullptr;
+            m_nSteals.fetch_add(1, std::memory_order_relaxed);
+        }
+        trim(tc);
+
+        Node* node = tc.loaded.head;
+        tc.loaded.head = node->link.next;
+        --tc.loaded.count;
+        return node;
     }
 
-    void push_global(Node* node) noexcept
+    void trim(ThreadCache& tc) noexcept
     {
-        Node* old_head;
-        do
+        const uint64_t epoch = m_nTrimEpoch.load(std::memory_order_relaxed);
+        if (tc.trim_epoch != epoch) [[unlikely]]
         {
-            old_head = m_pFreeList.load(std::memory_order_relaxed);
-            node->next.store(old_head, std::memory_order_relaxed);
-        } while (!m_pFreeList.compare_exchange_weak(
-            old_head, node,
-            std::memory_order_release,
-            std::memory_order_relaxed));
+            tc.trim_epoch = epoch;
+            push_global(std::exchange(tc.spare, {}), tc.shard);
+        }
     }
 
-    void move_thread_cache_to_global()
+    // new blocks come from mr on the calling thread's node
+    bool expand(Magazine& mag, unsigned shard)
     {
-        Node* head = m_pThreadCache->cache;
-        m_pThreadCache->cache = nullptr;
-        m_pThreadCache->size = 0;
+        if (!m_bDynamicExpansion) return false;
 
-        while (head)
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex_Expand);
+        // another thread may have refilled the global list while we waited
+        if (pop_global(mag, shard))
         {
-            Node* next = head->next.load(std::memory_order_relaxed);
-            push_global(head);
-            head = next;
+            m_nGlobalPops.fetch_add(1, std::memory_order_relaxed);
+            return true;
         }
+
+        const size_t total = m_nCurrentTotalObjects.load(std::memory_order_relaxed);
+        if (total >= m_nMaxTotalObjects) return false;
+        const size_t count = std::min(m_nMagazineSize, m_nMaxTotalObjects - total);
+
+        Node* block = this->allocate_block(count);
+        m_vecBlocks.push_back({ block, count });
+        m_nCurrentTotalObjects.store(total + count, std::memory_order_relaxed);
+        mag = make_magazine(block, count);
+        m_nExpansions.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
 
-    void clear_global_list()
+    static Node* untag(uint64_t tagged) noexcept
     {
-        Node* node = m_pFreeList.exchange(nullptr, std::memory_order_acquire);
-        while (node)
-        {
-            T* obj = reinterpret_cast<T*>(node->storage.data());
-            obj->~T(); // Explicitly destroy object
+        return reinterpret_cast<Node*>(tagged & PTR_MASK);
+    }
 
-            Node* next = node->next.load(std::memory_order_relaxed);
+    static uint64_t retag(Node* node, uint64_t prev) noexcept
+    {
+        return (((prev >> TAG_SHIFT) + 1) << TAG_SHIFT) | reinterpret_cast<uintptr_t>(node);
+    }
 
-            // If this node was dynamically allocated, we need to deallocate it
-            if (!is_from_preallocated_block(node))
+    bool pop_global(Magazine& mag, unsigned shard) noexcept
+    {
+        std::atomic<uint64_t>& global_head = m_shards[shard].head;
+        uint64_t old_head = global_head.load(std::memory_order_acquire);
+        while (Node* head = untag(old_head))
+        {
+            // head may be popped and reused concurrently; the read stays within
+            // pool memory and a stale value is rejected by the tagged CAS
+            const uint64_t link = std::atomic_ref<uint64_t>(head->link.next_magazine).load(std::memory_order_relaxed);
+            if (global_head.compare_exchange_weak(
+                old_head, retag(untag(link), old_head),
+                std::memory_order_acquire,
+                std::memory_order_acquire))
             {
-                deallocate_node(node);
+                mag = { head, static_cast<size_t>(link >> TAG_SHIFT) };
+                return true;
             }
-
-            node = next;
         }
+        return false;
     }
 
-protected:
-    bool is_from_preallocated_block(Node* node) const noexcept
+    // last resort: take a magazine of remote node memory
+    bool steal(Magazine& mag, unsigned shard) noexcept
     {
-        uintptr_t node_addr = reinterpret_cast<uintptr_t>(node);
-        for (const auto& block : m_vecPreAllocBlocks)
+        for (unsigned i = 1; i < LFOP_MAX_NUMA_NODES; ++i)
         {
-            uintptr_t block_start = reinterpret_cast<uintptr_t>(block.get());
-            uintptr_t block_end = block_start + (sizeof(Node) * block_size_);
-            if (node_addr >= block_start && node_addr < block_end)
-            {
+            if (pop_global(mag, (shard + i) % LFOP_MAX_NUMA_NODES))
                 return true;
-            }
         }
         return false;
     }
 
+    void push_global(Magazine mag, unsigned shard) noexcept
+    {
+        if (!mag.head) return;
+
+        std::atomic<uint64_t>& global_head = m_shards[shard].head;
+        uint64_t old_head = global_head.load(std::memory_order_relaxed);
+        do
+        {
+            std::atomic_ref<uint64_t>(mag.head->link.next_magazine).store(
+                (uint64_t(mag.count) << TAG_SHIFT) | (old_head & PTR_MASK), std::memory_order_relaxed);
+        } while (!global_head.compare_exchange_weak(
+            old_head, retag(mag.head, old_head),
+            std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
     // helper mechanism for ThreadLocalPoolGuard
 private:
     std::atomic<bool> m_bIsShuttingDown { false };
     std::atomic<size_t> m_nActiveThreads { 0 };
-    std::mutex m_mutex_Shutdown;
-    std::condition_variable m_cv_Shutdown;
-#ifdef LFOP_DEBUG
-    thread_local static struct ThreadLocalDebug
-    {
-        bool registered = false;
-        bool used_after_shutdown = false;
-    } m_debugState;
-#endif
+    TRACY_LOCKABLE(std::mutex, m_mutex_Shutdown, "LockFreeObjectPool::shutdown");
+    std::condition_variable_any m_cv_Shutdown;
 public:
     void register_thread()
     {
@@ -420,13 +582,14 @@ public:
             assert(false && "LFOP Misuse detected");
         }
         auto tid = std::this_thread::get_id();
-        if (m_debugState.registered)
+        ThreadCache& tc = thread_cache();
+        if (tc.registered)
         {
             std::cerr << "[ERROR] Thread " << tid
                 << " tried to double-register with the pool!\n";
             assert(false && "LFOP Misuse detected");
         }
-        m_debugState.registered = true;
+        tc.registered = true;
 #endif
         ++m_nActiveThreads;
     }
@@ -435,31 +598,32 @@ public:
     {
 #ifdef LFOP_DEBUG
         auto tid = std::this_thread::get_id();
-        if (!m_debugState.registered)
+        ThreadCache& tc = thread_cache();
+        if (!tc.registered)
         {
             std::cerr << "[ERROR] Thread " << tid
                 << " called unregister_thread() without registering.\n";
             assert(false && "LFOP Misuse detected");
         }
-        m_debugState.registered = false;
+        tc.registered = false;
 #endif
         const size_t prev = m_nActiveThreads.fetch_sub(1, std::memory_order_acq_rel);
         if (m_bIsShuttingDown && prev == 1)
         {
-            std::unique_lock<std::mutex> lock(m_mutex_Shutdown);
+            std::unique_lock<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex_Shutdown);
             m_cv_Shutdown.notify_all();
         }
     }
 
     void wait_for_threads_shutdown()
     {
-        std::unique_lock<std::mutex> lock(m_mutex_Shutdown);
+        std::unique_lock<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex_Shutdown);
         m_cv_Shutdown.wait(lock, [this] { return m_nActiveThreads == 0; });
     }
 };
 
 /**
-* ThreadLocalPoolGuard ensures all the thread local cache objects are 
+* ThreadLocalPoolGuard ensures all the thread local cache objects are
 * cleared per thread, since the ~LockFreeObjectPool() cannot automatically
 * destroy thread local caches from all threads.
 * @example:
@@ -508,4 +672,4 @@ public:
         m_lfPool.move_thread_cache_to_global();
         m_lfPool.unregister_thread();
     }
-};
\ No newline at end of file
+};
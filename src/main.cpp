@@ -2,107 +2,108 @@
 #include "custom-memory.hpp"  // should come first
 #include "headers.hpp"
 
-// Globals
-const char* szCmdSubAddress = "tcp://localhost:5555";
-const char* szLogPubAddress = "tcp://localhost:5556";
+#include <charconv>
 
 // Initialize ZeroMQ zmq_ctx with single IO thread
 static zmq::context_t zmq_ctx { 1 };
 
-// Publishers for Acks, Results etc.. one for each thread
-static std::map<decltype(std::this_thread::get_id()), zmq::socket_t> gThread_pub_sockets;
-
-zmq::socket_t create_pub_socket(zmq::context_t& ctx, const char* address, bool bBind)
-{
-    zmq::socket_t publisher(ctx, ZMQ_PUB);
-    // set socket options for performance
-    publisher.set(zmq::sockopt::sndbuf, 1024 * 1024);  // 1MB send buffer
-    publisher.set(zmq::sockopt::sndhwm, 1000);         // High-water mark
-    publisher.set(zmq::sockopt::linger, 0);            // after close, die immediately
-    publisher.set(zmq::sockopt::immediate, 1);         // drop messages if client is not fully connected
-    bBind ? publisher.bind(address) : publisher.connect(address); // for main thread, we bind, and for other threads we connect
-    return std::move(publisher);
-}
-
 #define ONEGB	((uint64_t)1 << 30)
 
 int main()
 {
     TRACY_ZONE;
+    TRACY_THREAD_NAME("ingress");
+
+    // optional CPU placement, applied before anything is allocated or a socket exists:
+    // RESERVE_CPUS=N, or explicit INGRESS_CPUS / IO_CPUS / WORKER_CPUS lists ("0", "1", "2-15")
+    CpuPlacement placement;
+    if (const char* szReserve = std::getenv("RESERVE_CPUS"))
+        placement = CpuPlacement::reserve((unsigned)std::atoi(szReserve));
+    else
+    {
+        auto env = [](const char* szName) { const char* sz = std::getenv(szName); return std::string_view { sz ? sz : "" }; };
+        placement = CpuPlacement::from_lists(env("INGRESS_CPUS"), env("IO_CPUS"), env("WORKER_CPUS"));
+    }
+    placement.apply_io(zmq_ctx);
+    placement.pin_ingress();
     // reserve memory 
     mi_reserve_os_memory(ONEGB, false /*commit*/, true /*allow large*/);
 
-    // setup shutdown signaling
-    setup_shutdown_handlers(zmq_ctx);
-    
-    // setup shutdown signal listener
-    zmq::socket_t shutdown_listener(zmq_ctx, ZMQ_PAIR);
-    shutdown_listener.bind(SHUTDOWN_INPROC_ADDR);
-    shutdown_listener.set(zmq::sockopt::linger, 0);
-
-    // setup Command listener
-    zmq::socket_t zmq_cmd_listener(zmq_ctx, ZMQ_SUB);
-    // Set socket options for performance
-    zmq_cmd_listener.set(zmq::sockopt::rcvbuf, 1024 * 1024);  // 1MB receive buffer
-    zmq_cmd_listener.set(zmq::sockopt::rcvhwm, 1000);         // High-water mark
-    zmq_cmd_listener.set(zmq::sockopt::linger, 0);            // after close, die immediately
-    zmq_cmd_listener.bind(szCmdSubAddress);
-    zmq_cmd_listener.set(zmq::sockopt::subscribe, "");        // receive all topics
-
-    // setup Publisher for Acks, Results, Logs and Notifications for the main thread
-    MessageHandler msgHandler(create_pub_socket(zmq_ctx, szLogPubAddress, true));
-
-    std::cout << "Server started listening for commands" << std::endl;
-
-    // Polling items
-    std::vector<zmq::pollitem_t> items = { 
-        {zmq_cmd_listener, 0, ZMQ_POLLIN, 0}, 
-        {shutdown_listener, 0, ZMQ_POLLIN, 0},
-    };
-
-    while (shouldExit() == false)
+#ifdef ENABLE_NUMA_POOLS
+    // object pools carve their blocks from node-local, huge page backed arenas
+    static numa::NumaArenaResource poolArena(ONEGB);
+    numa::set_pool_resource(&poolArena);
+#endif
+
+    DispatcherServer::Options options;
+    options.handle_signals = true;
+    options.placement = std::move(placement);
+    // endpoints can be overridden, e.g. ipc:// for local benchmarking
+    if (const char* szAddress = std::getenv("SUB_ENDPOINT")) options.cmd_address = szAddress;
+    if (const char* szAddress = std::getenv("PUB_ENDPOINT")) options.pub_address = szAddress;
+    if (const char* szAddress = std::getenv("JSON_SUB_ENDPOINT")) options.json_cmd_address = szAddress;
+    // optional direct publishing: WORKER_PUBLISH=1 lets workers publish results through an inproc proxy
+    if (const char* szWorkerPublish = std::getenv("WORKER_PUBLISH")) options.worker_publish = std::atoi(szWorkerPublish) != 0;
+    // optional periodic rpc.stats notifications (STATS_INTERVAL_MS, 0 = off)
+    if (const char* szStatsInterval = std::getenv("STATS_INTERVAL_MS")) options.stats_interval_ms = std::atoll(szStatsInterval);
+    // optional traffic capture for zmq-journal-replay: CAPTURE_JOURNAL=<file>, CAPTURE_JOURNAL_MB=<size on disk> (1024)
+    if (const char* szJournal = std::getenv("CAPTURE_JOURNAL")) options.journal_path = szJournal;
+    if (const char* szJournalMb = std::getenv("CAPTURE_JOURNAL_MB")) options.journal_size_mb = (size_t)std::atoll(szJournalMb);
+    // optional per-client fair queuing: FAIR_QUEUE=1, FAIR_QUEUE_WINDOW=<requests on the pool> (2 per worker),
+    // FAIR_QUEUE_MAX_QUEUED=<per client> (4096), FAIR_QUEUE_CLIENTS="id:weight[:max_in_flight],..."
+    if (const char* szFairQueue = std::getenv("FAIR_QUEUE")) options.fair_queue.enabled = std::atoi(szFairQueue) != 0;
+    if (const char* szWindow = std::getenv("FAIR_QUEUE_WINDOW")) options.fair_queue.window = (size_t)std::atoll(szWindow);
+    if (const char* szMaxQueued = std::getenv("FAIR_QUEUE_MAX_QUEUED")) options.fair_queue.max_queued = (size_t)std::atoll(szMaxQueued);
+    if (const char* szClients = std::getenv("FAIR_QUEUE_CLIENTS"); szClients && !options.fair_queue.parse_clients(szClients))
+        std::cerr << "Skipped malformed entries of FAIR_QUEUE_CLIENTS: " << szClients << std::endl;
+    // results kept for rpc.resend: RETRANSMIT_MB=<bytes of frames> (64), RETRANSMIT_RESULTS=<frames> (65536), either 0 = off
+    if (const char* szMb = std::getenv("RETRANSMIT_MB")) options.retransmit.max_bytes = (size_t)std::atoll(szMb) << 20;
+    if (const char* szResults = std::getenv("RETRANSMIT_RESULTS")) options.retransmit.max_results = (size_t)std::atoll(szResults);
+    // optional cap on pipeline Starts: PIPELINE_BUDGET=1, PIPELINE_MAX_UTILIZATION=<share of the CPUs> (0.85),
+    // PIPELINE_DEFAULT_COST=<cores charged per pipeline> (1); nothing measures the dispatcher's pipelines, so every one
+    // costs PIPELINE_DEFAULT_COST: at most MAX_UTILIZATION * CPUs / DEFAULT_COST pipelines run at a time
+    if (const char* szBudget = std::getenv("PIPELINE_BUDGET"); szBudget && std::atoi(szBudget) != 0)
     {
-        try
-        {
-            // Wait indefinitely either till a message or SIG event received
-            zmq::poll(items, std::chrono::milliseconds { -1 });  //zmq_ack_publisher.send(zmq::message_t("From main"), zmq::send_flags::dontwait);
-
-            // Check for shutdown
-            if (items[1].revents & ZMQ_POLLIN)
-                break;
-
-            if (items[0].revents & ZMQ_POLLIN)
-            {
-                // Process all available messages
-                while (shouldExit() == false)
-                {
-                    zmq::message_t msg;
-                    auto result = zmq_cmd_listener.recv(msg, zmq::recv_flags::dontwait);
-                    if (shouldExit() || !result.has_value())
-                    {
-                        break; // No more messages
-                    }
-                    // Parse and dispatch with zero-copy
-                    msgHandler.handle_incoming_message(std::move(msg));
-
-                    // TODO: use MPSC + Lock-free Object Pool to send logs/responses from 
-                    // inside the threads to the main thread.
-                    msgHandler.publish_outgoing_messages();
-                }
-            }
-        }
-        catch (const zmq::error_t& e)
-        {
-            std::cerr << "ZeroMQ error: " << e.what() << '\n';
-            break;
-        }
-        catch (const std::exception& e)
+        options.pipeline_budget.emplace();
+        if (const char* szUtilization = std::getenv("PIPELINE_MAX_UTILIZATION")) options.pipeline_budget->max_utilization = std::atof(szUtilization);
+        if (const char* szCost = std::getenv("PIPELINE_DEFAULT_COST")) options.pipeline_budget->default_cost = std::atof(szCost);
+    }
+    // optional scale-out behind zmq-dispatch-broker: BROKER_ENDPOINT=<its registry>, INSTANCE_ID=<1-255, unique>,
+    // ADVERTISE_SUB_ENDPOINT / ADVERTISE_PUB_ENDPOINT when the broker reaches this host by another address, LOAD_REPORT_MS (200)
+    if (const char* szAddress = std::getenv("BROKER_ENDPOINT")) options.broker_address = szAddress;
+    if (const char* szInstance = std::getenv("INSTANCE_ID"))
+    {
+        const std::string_view instance(szInstance);
+        unsigned nInstance = 0;
+        const auto [p, ec] = std::from_chars(instance.data(), instance.data() + instance.size(), nInstance);
+        if (ec != std::errc() || p != instance.data() + instance.size() || nInstance > UINT8_MAX)
         {
-            std::cerr << "Error: " << e.what() << '\n';
+            std::cerr << "INSTANCE_ID must be a number from 1 to 255: " << szInstance << std::endl;
+            return 1;
         }
+        options.instance_id = (uint8_t)nInstance;
+    }
+    // 0 stamps no instance on the pipeline ids: the broker could not route them
+    if (!options.broker_address.empty() && options.instance_id == 0)
+    {
+        std::cerr << "BROKER_ENDPOINT needs an INSTANCE_ID from 1 to 255, unique among the broker's instances" << std::endl;
+        return 1;
     }
+    if (const char* szAddress = std::getenv("ADVERTISE_SUB_ENDPOINT")) options.advertised_cmd_address = szAddress;
+    if (const char* szAddress = std::getenv("ADVERTISE_PUB_ENDPOINT")) options.advertised_pub_address = szAddress;
+    if (const char* szReportMs = std::getenv("LOAD_REPORT_MS")) options.report_interval_ms = std::atoll(szReportMs);
+    // optional hybrid ingress: spin up to BUSY_POLL_US after the last message before blocking (0 = off)
+    if (const char* szBusyPoll = std::getenv("BUSY_POLL_US")) options.busy_poll_us = std::atoll(szBusyPoll);
 
-    std::cout << "Shutting down, waiting for thread pool to complete" << std::endl;
+    {
+        DispatcherServer server(zmq_ctx, std::move(options));
+
+        std::cout << "Server started listening for commands" << std::endl;
+
+        server.run();
+
+        std::cout << "Shutting down, waiting for thread pool to complete" << std::endl;
+    }
 
     // print memory usage statistics
     mi_stats_print_out(NULL, NULL);
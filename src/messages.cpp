@@ -1,122 +1,470 @@
 #include "headers.hpp"
+#include "json_ingress.hpp"
 
 #define RUN_TASK_IN_POOL  \
-    std::move_only_function<void()> task = [method_params = std::move(params)]() noexcept \
-        { handleMethod(method_params);  };  \
-    m_threadPool.detach_task(std::move(task)); // fire and forget
-
-// static member variables
-fmt::memory_buffer MessageHandler::ackBuf;
-fmt::memory_buffer MessageHandler::errBuf;
+    const TClientID client_id = params.client_id; \
+    const TReqID req_id = params.base()->req_id; \
+    params.received_at = received_at; \
+    std::move_only_function<void()> task = [this, cache_epoch = cache_epoch_of(params), method_params = std::move(params), dispatched_at = metrics::now_ns()]() mutable noexcept \
+        { \
+            TRACY_ZONE_NAMED("executor.task"); \
+            TRACY_ZONE_FLOW(method_params.base()->req_id); \
+            this->execute(method_params, cache_epoch, dispatched_at); \
+        };  \
+    if (this->submit(client_id, std::move(task))) \
+    { \
+        ++m_nInFlight; \
+        metrics::record(method_id, metrics::Stage::Dispatch, metrics::now_ns() - received_at); \
+    } \
+    else this->sendError(req_id, jsonrpc::SERVER_BUSY, "Server busy: too many queued requests from this client");
 
 // Parse params with zero-copy and dispatch to the thread-pool for execution
 void MessageHandler::handle_incoming_message(zmq::message_t&& msg)
 {
-    size_t msgSize = msg.size();
-    assert(msgSize >= sizeof(ParamsBase) && "Message too small");
+    TRACY_ZONE_NAMED("ingress");
+    const uint64_t received_at = metrics::now_ns();
+    assert(msg.size() >= sizeof(ParamsBase) && "Message too small");
+
+    RequestHeader header;
+    [[maybe_unused]] const bool bValid = read_header(msg.to_string_view(), header);
+    assert(bValid && header.base.req_id && "Request ID cannot be NULL");
+    assert(header.base.method_id < (TMethodID)MethodID::Unknown && "Invalid Method ID");
+    TRACY_ZONE_FLOW(header.base.req_id);
+    TRACY_ZONE_TEXT(method_name(header.method()));
+
+    if (header.method() == MethodID::RPC_Batch)
+    {
+        this->handle_batch(std::move(msg), received_at);
+        this->plot_gauges();
+        return;
+    }
+
+    // the ingress thread reads rpc.resend's payload itself: a short one is answered, not read past its end
+    if (header.method() == MethodID::RPC_Resend && (!bValid || !is_dispatchable(MethodID::RPC_Resend, msg.size() - header.size)))
+    {
+        this->sendError(header.base.req_id, jsonrpc::INVALID_PARAMS, "Invalid params");
+        this->plot_gauges();
+        return;
+    }
+
+    // Steps:
+    //  1. send ACK to the sender that we received the message
+    //     (not for rpc.resend: the result it publishes again is the answer).
+    if (header.method() != MethodID::RPC_Resend)
+        this->sendAck(&header.base);
+    //  2. send the message to thread pool to get the work done; the task
+    //     posts its result back through m_outgoing.
+
+    // the config is kept as a view: small frames live inside zmq_msg_t
+    // and would move away from it, so they are copied to the slab first
+    if (header.method() == MethodID::GStreamer_Pipeline_Start && utils::is_inline_message(msg))
+        msg = SlabBuffer::copy_to_message(msg.to_string_view());
+    const std::string_view record = msg.to_string_view();
+    this->dispatch_request(std::move(msg), record, received_at);
+
+    this->plot_gauges();
+    return;
+}
+
+// Splits a batch frame into its records without copying: every request takes
+// a reference counted copy of the one frame, and the batch is acked once.
+void MessageHandler::handle_batch(zmq::message_t&& frame, uint64_t received_at)
+{
+    TRACY_ZONE_NAMED("ingress.batch");
+    const TReqID batch_id = reinterpret_cast<const ParamsBase*>(frame.data())->req_id;
+
+    // the records are views into the frame, so it must not be an inline (VSM) one
+    if (utils::is_inline_message(frame))
+        frame = SlabBuffer::copy_to_message(frame.to_string_view());
 
-    const ParamsBase* pParamsBase = reinterpret_cast<const ParamsBase*>(msg.data());
-    assert(pParamsBase->req_id && "Request ID cannot be NULL");
-    assert(pParamsBase->method_id < (TMethodID)MethodID::Unknown && "Invalid Method ID");
+    // the whole frame is validated first: a batch is acked, and dispatched, as a unit
+    thread_local std::vector<std::string_view> records;
+    const bool bValid = decode_batch(frame.to_string_view(), records) && !records.empty()
+        && std::ranges::all_of(records, [](std::string_view record) {
+            RequestHeader header;
+            return read_header(record, header) && header.base.req_id && is_dispatchable(header.method(), record.size() - header.size);
+        });
+    if (!bValid)
+    {
+        this->sendError(batch_id, jsonrpc::INVALID_REQUEST, "Invalid batch");
+        return;
+    }
 
-    const char* pBuffer = static_cast<const char*>(msg.data());
-    const char* payload_start = pBuffer + sizeof(ParamsBase);
-    const size_t payload_size = msgSize - sizeof(ParamsBase);
+    this->sendBatchAck(batch_id, records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        // the last record takes the frame itself
+        zmq::message_t shared;
+        if (i + 1 < records.size()) shared.copy(frame);
+        else shared = std::move(frame);
+        this->dispatch_request(std::move(shared), records[i], received_at);
+    }
+}
 
-    // Steps: 
-    //  1. send ACK to the sender that we received the message.
-    this->sendAck(pParamsBase);
-    //  2. send the message to thread pool to get the work done.
+// Decodes the request record that lives in frame and runs it on the pool
+void MessageHandler::dispatch_request(zmq::message_t&& frame, std::string_view record, uint64_t received_at)
+{
+    // copied out: the frame it lives in is moved into the task below
+    RequestHeader header;
+    read_header(record, header);
+    const TMethodID method_id = header.base.method_id;
 
-    // TODO: use MPSC + Lock-free Object Pool to send logs/responses from 
-    // inside the threads to the main thread.
-    // The static buffers will not work across threads.
-    
     // Create a dispatcher that calls the appropriate handle method
-    switch (static_cast<MethodID>(pParamsBase->method_id))
+    switch (static_cast<MethodID>(method_id))
     {
         case MethodID::GStreamer_Pipeline_Start:
         {
-            MethodParams<MethodID::GStreamer_Pipeline_Start> params { 
-                std::string_view(payload_start, payload_size), 
-                std::move(msg)
-            };
+            auto params = decode_params<MethodID::GStreamer_Pipeline_Start>(std::move(frame), record, header);
             RUN_TASK_IN_POOL
             break;
         }
         case MethodID::GStreamer_Pipeline_Stop:
         {
-            MethodParams<MethodID::GStreamer_Pipeline_Stop> params {
-                *reinterpret_cast<const TPipelineID*>(payload_start),
-                std::move(msg)
-            };
+            auto params = decode_params<MethodID::GStreamer_Pipeline_Stop>(std::move(frame), record, header);
             RUN_TASK_IN_POOL
-                break;
+            break;
         }
         case MethodID::GStreamer_Pipeline_Pause:
         {
-            MethodParams<MethodID::GStreamer_Pipeline_Pause> params {
-                *reinterpret_cast<const TPipelineID*>(payload_start),
-                std::move(msg)
-            };
+            auto params = decode_params<MethodID::GStreamer_Pipeline_Pause>(std::move(frame), record, header);
             RUN_TASK_IN_POOL
-                break;
+            break;
         }
         case MethodID::GStreamer_Pipeline_Resume:
         {
-            MethodParams<MethodID::GStreamer_Pipeline_Resume> params {
-                *reinterpret_cast<const TPipelineID*>(payload_start),
-                std::move(msg)
-            };
+            auto params = decode_params<MethodID::GStreamer_Pipeline_Resume>(std::move(frame), record, header);
+            RUN_TASK_IN_POOL
+            break;
+        }
+        case MethodID::GStreamer_Pipeline_List:
+        {
+            auto params = decode_params<MethodID::GStreamer_Pipeline_List>(std::move(frame), record, header);
+            if (this->serve_cached(params, received_at)) break;
+            RUN_TASK_IN_POOL
+            break;
+        }
+        case MethodID::GStreamer_Pipeline_Status:
+        {
+            auto params = decode_params<MethodID::GStreamer_Pipeline_Status>(std::move(frame), record, header);
+            if (this->serve_cached(params, received_at)) break;
             RUN_TASK_IN_POOL
-                break;
+            break;
+        }
+        case MethodID::RPC_Stats:
+        {
+            this->sendStats(&header.base);
+            break;
+        }
+        case MethodID::RPC_Resend:
+        {
+            this->resend(Payload<MethodID::RPC_Resend>::decode(record.substr(header.size)).req_id);
+            break;
         }
         default:
             assert(false && "Unknown method ID");
             break;
     }
-    
-    return;
+}
+
+template<MethodID MID>
+static bool decode_json_params(simdjson::ondemand::object& request, MethodParams<MID>& params)
+{
+    // methods without params may leave "params" out
+    if constexpr (std::is_empty_v<Payload<MID>>) return true;
+    else
+    {
+        simdjson::ondemand::object jsonParams;
+        return !request.find_field_unordered("params").get_object().get(jsonParams)
+            && !json_ingress::decode_payload<MID>(jsonParams, params);
+    }
+}
+
+void MessageHandler::handle_incoming_json(zmq::message_t&& msg)
+{
+    TRACY_ZONE_NAMED("ingress.json");
+    const uint64_t received_at = metrics::now_ns();
+
+    // one reusable parser per ingress thread; its buffers grow to the largest request seen
+    thread_local simdjson::ondemand::parser parser;
+
+    zmq::message_t frame = json_ingress::make_parseable(std::move(msg));
+    simdjson::ondemand::document doc;
+    simdjson::ondemand::object request;
+    if (parser.iterate(static_cast<const char*>(frame.data()), frame.size(), frame.size() + simdjson::SIMDJSON_PADDING).get(doc)
+        || doc.get_object().get(request))
+    {
+        this->sendError(nullptr, jsonrpc::PARSE_ERROR, "Parse error");
+        return;
+    }
+
+    std::string_view version, method;
+    TReqID req_id = 0;
+    if (request.find_field_unordered("jsonrpc").get_string().get(version) || version != "2.0"
+        || request.find_field_unordered("id").get_uint64().get(req_id) || !req_id)
+    {
+        this->sendError(nullptr, jsonrpc::INVALID_REQUEST, "Invalid Request: jsonrpc \"2.0\" and a non-zero integer id are required");
+        return;
+    }
+    TRACY_ZONE_FLOW(req_id);
+    if (request.find_field_unordered("method").get_string().get(method))
+    {
+        this->sendError(req_id, jsonrpc::INVALID_REQUEST, "Invalid Request: method is missing");
+        return;
+    }
+
+    // optional "client": the producer the request is queued for (see FairQueue)
+    uint64_t client_id = 0;
+    const simdjson::error_code clientError = request.find_field_unordered("client").get_uint64().get(client_id);
+    if ((clientError && clientError != simdjson::NO_SUCH_FIELD) || client_id > UINT32_MAX)
+    {
+        this->sendError(req_id, jsonrpc::INVALID_REQUEST, "Invalid Request: client must be a 32 bit unsigned integer");
+        return;
+    }
+
+    // optional "timing": the result carries the stage timestamps (METHOD_FLAG_TIMING)
+    bool timed = false;
+    const simdjson::error_code timingError = request.find_field_unordered("timing").get_bool().get(timed);
+    if (timingError && timingError != simdjson::NO_SUCH_FIELD)
+    {
+        this->sendError(req_id, jsonrpc::INVALID_REQUEST, "Invalid Request: timing must be a boolean");
+        return;
+    }
+
+    const MethodID mid = method_from_name(method);
+    const TMethodID method_id = (TMethodID)mid;
+    const ParamsBase header { req_id, method_id };
+    TRACY_ZONE_TEXT(method_name(mid));
+
+    // decodes into params (views point into frame), then acks and dispatches
+#define DISPATCH_JSON_REQUEST(MID) \
+    { \
+        MethodParams<MID> params; \
+        if (!decode_json_params(request, params)) \
+        { \
+            this->sendError(req_id, jsonrpc::INVALID_PARAMS, "Invalid params"); \
+            break; \
+        } \
+        params.raw_msg = std::move(frame); \
+        params.header = header; \
+        params.client_id = (TClientID)client_id; \
+        params.timed = timed; \
+        this->sendAck(&header); \
+        if (this->serve_cached(params, received_at)) break; \
+        RUN_TASK_IN_POOL \
+    }
+
+    switch (mid)
+    {
+        case MethodID::GStreamer_Pipeline_Start:
+            DISPATCH_JSON_REQUEST(MethodID::GStreamer_Pipeline_Start)
+            break;
+        case MethodID::GStreamer_Pipeline_Stop:
+            DISPATCH_JSON_REQUEST(MethodID::GStreamer_Pipeline_Stop)
+            break;
+        case MethodID::GStreamer_Pipeline_Pause:
+            DISPATCH_JSON_REQUEST(MethodID::GStreamer_Pipeline_Pause)
+            break;
+        case MethodID::GStreamer_Pipeline_Resume:
+            DISPATCH_JSON_REQUEST(MethodID::GStreamer_Pipeline_Resume)
+            break;
+        case MethodID::GStreamer_Pipeline_List:
+            DISPATCH_JSON_REQUEST(MethodID::GStreamer_Pipeline_List)
+            break;
+        case MethodID::GStreamer_Pipeline_Status:
+            DISPATCH_JSON_REQUEST(MethodID::GStreamer_Pipeline_Status)
+            break;
+        case MethodID::RPC_Stats:
+            this->sendAck(&header);
+            this->sendStats(&header);
+            break;
+        case MethodID::RPC_Resend:
+        {
+            MethodParams<MethodID::RPC_Resend> params;
+            if (!decode_json_params(request, params))
+                this->sendError(req_id, jsonrpc::INVALID_PARAMS, "Invalid params");
+            else
+                this->resend(params.req_id);
+            break;
+        }
+        default:
+            this->sendError(req_id, jsonrpc::METHOD_NOT_FOUND, "Method not found");
+            break;
+    }
+#undef DISPATCH_JSON_REQUEST
+
+    this->plot_gauges();
+}
+
+bool MessageHandler::submit(TClientID client_id, std::move_only_function<void()>&& task)
+{
+    TRACY_ZONE_NAMED("dispatch");
+    if (m_pFairQueue) return m_pFairQueue->push(client_id, std::move(task));
+    m_threadPool.detach_task(std::move(task)); /* fire and forget */
+    return true;
+}
+
+void MessageHandler::publish(zmq::message_t&& msg)
+{
+    // async fire and forget; a subscriber at its HWM loses the message without
+    // an error (see create_pub_socket), only failed sends are counted
+    if (!this->m_publisher.send(std::move(msg), zmq::send_flags::dontwait))
+        ++m_nPubDrops;
+}
+
+void MessageHandler::publish_result(TReqID req_id, zmq::message_t&& msg)
+{
+    // the last shard is the main thread's; the ones before belong to the worker publishers
+    m_retransmit.store(m_workerPublishers.size(), req_id, msg);
+    this->publish(std::move(msg));
+}
+
+void MessageHandler::resend(TReqID req_id)
+{
+    TRACY_ZONE_NAMED("resend");
+    TRACY_ZONE_FLOW(req_id);
+    zmq::message_t frame;
+    if (m_retransmit.fetch(req_id, frame))
+        this->publish(std::move(frame));
 }
 
 void MessageHandler::publish_outgoing_messages()
 {
-    // TODO: use MPSC + ObjectPool to pump responses from inside
-    // the thread pool tasks to here on main thread (to be published
-    // on ZMQ_PUB)
+    while (auto out = m_outgoing.pop())
+    {
+        TRACY_ZONE_NAMED("publish");
+        TRACY_ZONE_FLOW(out->req_id);
+        if (out->published_offset)
+            jsonrpc::set_published(static_cast<char*>(out->msg.data()) + out->published_offset, metrics::now_ns());
+        this->publish_result(out->req_id, std::move(out->msg));
+        metrics::record(out->method_id, metrics::Stage::Publish, metrics::now_ns() - out->posted_at);
+        --m_nInFlight;
+    }
+    m_scheduler.on_backlog_drained();
+    // requests completed meanwhile: the fair queue may send more
+    if (m_pFairQueue) m_pFairQueue->pump();
+    this->plot_gauges();
+}
+
+bool MessageHandler::publish_from_worker(OutgoingMessage& out)
+{
+    const std::optional<std::size_t> idx = BS::this_thread::get_index();
+    if (!idx || *idx >= m_workerPublishers.size()) return false;
+
+    WorkerPublisher& publisher = m_workerPublishers[*idx];
+    if (!publisher.bReady && !(publisher.bReady = PublishProxy::wait_ready(publisher.socket, std::chrono::milliseconds(0))))
+        return false;
+
+    TRACY_ZONE_NAMED("publish.direct");
+    TRACY_ZONE_FLOW(out.req_id);
+    if (out.published_offset)
+        jsonrpc::set_published(static_cast<char*>(out.msg.data()) + out.published_offset, metrics::now_ns());
+    m_retransmit.store(*idx, out.req_id, out.msg);
+    // an XPUB drops for a subscriber at its HWM by itself; a failed send is counted here
+    if (!publisher.socket.send(std::move(out.msg), zmq::send_flags::dontwait))
+        m_nDirectDrops.fetch_add(1, std::memory_order_relaxed);
+    metrics::record(out.method_id, metrics::Stage::Publish, metrics::now_ns() - out.posted_at);
+    m_nDirectPublished.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
-void no_delete(void* data, void* hint)
+void MessageHandler::on_outgoing_ready()
 {
-    // Custom free function that does nothing, preventing deallocation
+    m_outgoingBell.reset();
+    this->publish_outgoing_messages();
 }
 
+// Response buffers come from the slab allocator and are handed to ZMQ
+// without a copy; ZMQ frees them back into the slab once they are sent.
+
 void MessageHandler::sendAck(const ParamsBase* pParamsBase)
 {
-    // reuse buffer
-    MessageHandler::ackBuf.clear();
-    fmt::format_to(std::back_inserter(MessageHandler::ackBuf),
-        R"({{"jsonrpc":"2.0","ack":1,"id":{}}})",
-        pParamsBase->req_id
-    );
-    // reuse the ackBuf for the zmq::message_t
-    zmq::message_t ack(ackBuf.data(), ackBuf.size(), no_delete, nullptr);
+    TRACY_ZONE_NAMED("format.ack");
+    SlabBuffer ackBuf;
+    jsonrpc::write_ack(ackBuf, pParamsBase->req_id);
     // zero-copy call with async fire and forget mode
-    this->m_publisher.send(std::move(ack), zmq::send_flags::dontwait);
+    this->publish(std::move(ackBuf).to_message());
+}
+
+void MessageHandler::sendBatchAck(TReqID batch_id, size_t count)
+{
+    TRACY_ZONE_NAMED("format.ack");
+    SlabBuffer ackBuf;
+    jsonrpc::write_batch_ack(ackBuf, batch_id, count);
+    this->publish(std::move(ackBuf).to_message());
 }
 
 void MessageHandler::sendError(const ParamsBase* pParamsBase, zmq::error_t&& err)
 {
-    // reuse buffer
-    MessageHandler::errBuf.clear();
-    fmt::format_to(std::back_inserter(MessageHandler::errBuf),
-        R"({{"jsonrpc":"2.0","id":{},"error":{{ code:{}, message:"{}" }} }})",
-        pParamsBase->req_id,
-        err.num(),
-        err.what()
-    );
-    // reuse the ackBuf for the zmq::message_t
-    zmq::message_t errMsg(errBuf.data(), errBuf.size(), no_delete, nullptr);
+    SlabBuffer errBuf;
+    jsonrpc::write_error(errBuf, pParamsBase->req_id, err.num(), err.what());
     // zero-copy call with async fire and forget mode
-    this->m_publisher.send(std::move(errMsg), zmq::send_flags::dontwait);
+    this->publish(std::move(errBuf).to_message());
+}
+
+static void write_pool_stats_json(SlabBuffer& out, std::string_view name, const ObjectPoolStats& st)
+{
+    fmt::format_to(std::back_inserter(out),
+        R"("{}":{{"acquires":{},"local_hits":{},"global_hits":{},"remote_hits":{},"expansions":{},"objects":{},"local_hit_rate":{:.4f}}})",
+        name, st.acquires, st.local_hits, st.global_hits, st.remote_hits, st.expansions, st.total_objects,
+        st.acquires ? (double)st.local_hits / (double)st.acquires : 1.0);
+}
+
+void MessageHandler::write_stats_json(SlabBuffer& out)
+{
+    fmt::format_to(std::back_inserter(out),
+        R"({{"uptime_ms":{},"gauges":{{"executor_queued":{},"executor_running":{},"outgoing_queue":{},"in_flight":{},"pub_drops":{}}},)",
+        (metrics::now_ns() - m_nStartedAt) / 1000000,
+        m_threadPool.get_tasks_queued(),
+        m_threadPool.get_tasks_running(),
+        m_outgoing.size(),
+        in_flight(),
+        m_nPubDrops + m_nDirectDrops.load(std::memory_order_relaxed));
+    if (m_pBusyPoll)
+    {
+        const uint64_t nSpin = m_pBusyPoll->spin_wakeups(), nBlock = m_pBusyPoll->block_wakeups();
+        fmt::format_to(std::back_inserter(out),
+            R"("busy_poll":{{"spin_wakeups":{},"block_wakeups":{},"spin_ratio":{:.3f},"budget_us":{:.1f}}},)",
+            nSpin, nBlock, nSpin + nBlock ? (double)nSpin / (double)(nSpin + nBlock) : 0.0, m_pBusyPoll->budget_ns() / 1000.0);
+    }
+    if (m_pFairQueue)
+    {
+        fmt::format_to(std::back_inserter(out),
+            R"("fair_queue":{{"clients":{},"queued":{},"in_flight":{},"window":{},"rejected":{}}},)",
+            m_pFairQueue->clients(), m_pFairQueue->queued(), m_pFairQueue->in_flight(), m_pFairQueue->window(), m_pFairQueue->rejected());
+    }
+    fmt::format_to(std::back_inserter(out), R"("cache":{{"hits":{},"misses":{},"entries":{}}},)",
+        m_nCacheHits, m_nCacheMisses, ResponseCache::instance().size());
+    if (m_retransmit.enabled())
+    {
+        const RetransmitBuffer::Stats st = m_retransmit.stats();
+        fmt::format_to(std::back_inserter(out), R"("retransmit":{{"results":{},"bytes":{},"evicted":{},"resent":{},"misses":{}}},)",
+            st.results, st.bytes, st.evicted, st.resent, st.misses);
+    }
+    out.append(R"("pools":{)");
+    write_pool_stats_json(out, "slab", SlabAllocator::instance().stats());
+    out.push_back(',');
+    write_pool_stats_json(out, "outgoing_nodes", m_outgoing.pool_stats());
+    out.append(R"(},"methods":{)");
+    metrics::write_methods_json(out);
+    out.append("}}");
+}
+
+void MessageHandler::sendStats(const ParamsBase* pParamsBase)
+{
+    SlabBuffer statsBuf;
+    jsonrpc::write_result_prefix(statsBuf, pParamsBase->req_id);
+    this->write_stats_json(statsBuf);
+    statsBuf.push_back('}');
+    this->publish(std::move(statsBuf).to_message());
+}
+
+void MessageHandler::publish_stats_notification()
+{
+    SlabBuffer statsBuf;
+    statsBuf.append(jsonrpc::NOTIFICATION_PREFIX);
+    statsBuf.append(R"("rpc.stats")");
+    statsBuf.append(jsonrpc::PARAMS_KEY);
+    this->write_stats_json(statsBuf);
+    statsBuf.push_back('}');
+    this->publish(std::move(statsBuf).to_message());
 }
\ No newline at end of file
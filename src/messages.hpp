@@ -83,19 +83,279 @@ struct Message
 // tasks at the time of destruction.
 class MessageHandler
 {
+    struct OutgoingMessage
+    {
+        zmq::message_t msg;
+        TReqID req_id;
+        TMethodID method_id;
+        uint64_t posted_at;     // metrics::now_ns() when the worker posted it
+        size_t published_offset = 0;    // timed requests: where the publisher writes its time (jsonrpc::set_published)
+    };
+
+    // Results posted by the worker threads, published by the main thread.
+    // Declared before the pool: tasks still post while the pool drains.
+    MpscQueue<OutgoingMessage> m_outgoing;
+    Doorbell m_outgoingBell;
+    // direct publishing mode: worker idx connects m_workerPublishers[idx] to the
+    // proxy when it starts and publishes its results itself once the socket is
+    // ready, through m_outgoing until then (declared before the pool too)
+    struct WorkerPublisher
+    {
+        zmq::socket_t socket;
+        bool bReady = false;    // the proxy's subscription arrived: nothing sent is filtered out
+    };
+    const PublishProxy* m_pProxy;
+    std::vector<WorkerPublisher> m_workerPublishers;
+    // recent result frames for rpc.resend: a shard per worker publisher, then the main thread's (also declared before the pool)
+    RetransmitBuffer m_retransmit;
+    std::atomic<uint64_t> m_nDirectPublished { 0 };
+    std::atomic<uint64_t> m_nDirectDrops { 0 };     // failed sends of the worker publishers
+    // per-client fair queuing in front of the pool, when enabled; its tasks report to it while the pool drains
+    std::unique_ptr<FairQueue> m_pFairQueue;
     BS::thread_pool<> m_threadPool;
+    // resumes coroutine handlers on the pool, so constructed after it (its timer thread posts to it);
+    // ~MessageHandler waits for the pool before the scheduler goes, since running tasks post to it
+    coro::Scheduler m_scheduler;
     zmq::socket_t m_publisher;
+    uint64_t m_nPubDrops = 0;   // main thread only: failed sends
+    uint64_t m_nCacheHits = 0;  // main thread only: requests answered from the ResponseCache
+    uint64_t m_nCacheMisses = 0;
+    uint64_t m_nInFlight = 0;   // main thread only: dispatched; results published directly are subtracted in in_flight()
+    const AdaptiveSpin* m_pBusyPoll = nullptr;  // main thread only: reported in the stats when set
+    const uint64_t m_nStartedAt = metrics::now_ns();
+    // coro::outgoing_capacity() suspends while more results than this are queued
+    static constexpr size_t OUTGOING_BACKLOG_LIMIT = 1024;
+    // a worker starting up waits this long for its publisher, then posts to m_outgoing until it is ready
+    static constexpr std::chrono::milliseconds WORKER_PUBLISHER_WAIT { 100 };
 public:
-    inline MessageHandler(zmq::socket_t&& publisher):
-        m_threadPool(std::thread::hardware_concurrency()), 
+    // one worker per placement.workers CPU, each pinned to it (hardware_concurrency() unpinned workers without);
+    // with pProxy, publisher is connected to it and the workers publish their results directly;
+    // with fairQueue.enabled, requests reach the pool through a FairQueue;
+    // the results last published are kept for rpc.resend within the retransmit limits
+    inline MessageHandler(zmq::socket_t&& publisher, const CpuPlacement& placement = {}, const PublishProxy* pProxy = nullptr,
+        const FairQueue::Options& fairQueue = {}, const RetransmitBuffer::Options& retransmit = {}):
+        m_pProxy(pProxy),
+        m_workerPublishers(pProxy ? placement.worker_count() : 0),
+        m_retransmit(retransmit, m_workerPublishers.size() + 1),
+        m_threadPool(placement.worker_count(),
+            [this, placement](std::size_t idx) {
+                placement.pin_worker(idx);
+                // after pinning, so the heap's pages come from the worker's node
+                worker_heap::attach();
+                if (idx < m_workerPublishers.size())
+                {
+                    WorkerPublisher& publisher = m_workerPublishers[idx];
+                    publisher.socket = m_pProxy->connect_publisher();
+                    publisher.bReady = PublishProxy::wait_ready(publisher.socket, WORKER_PUBLISHER_WAIT);
+                }
+                TRACY_THREAD_NAME(fmt::format("worker {}", idx).c_str());
+            }),
+        m_scheduler(m_threadPool),
         m_publisher(std::move(publisher))
-    { }
+    {
+        m_scheduler.set_backlog([this] { return m_outgoing.size(); }, OUTGOING_BACKLOG_LIMIT);
+        // completions ring the outgoing doorbell, which pumps the queue (publish_outgoing_messages)
+        if (fairQueue.enabled)
+            m_pFairQueue = std::make_unique<FairQueue>(m_threadPool, m_outgoingBell, fairQueue);
+    }
+    // queued requests still run, suspended coroutines are resumed (timers fire early),
+    // and all of them finish before the scheduler and the pool go
+    ~MessageHandler()
+    {
+        if (m_pFairQueue) m_pFairQueue->flush();
+        m_scheduler.shutdown();
+        m_threadPool.wait();
+    }
+    // timers and delayed tasks on the worker pool (post_after, cancel; utils::retry_async)
+    coro::Scheduler& scheduler() noexcept { return m_scheduler; }
     void handle_incoming_message(zmq::message_t&& msg);
+    // JSON-RPC request text, decoded onto the same MethodParams as binary frames
+    void handle_incoming_json(zmq::message_t&& msg);
     void sendAck(const ParamsBase*);
+    // one ack for the count requests of a batch frame
+    void sendBatchAck(TReqID batch_id, size_t count);
     void sendError(const ParamsBase*, zmq::error_t&& err);
+    // error response to a request id, or to nullptr when the id could not be read
+    template<typename TId>
+    void sendError(TId req_id, int code, std::string_view message)
+    {
+        SlabBuffer errBuf;
+        jsonrpc::write_error(errBuf, req_id, code, message);
+        this->publish(std::move(errBuf).to_message());
+    }
+    // thread-safe: publishes the result from the worker in the direct mode,
+    // otherwise queues it for the main thread to publish
+    // (with the request's stage timestamps when pTiming is given)
+    template<MethodID MID>
+    void postResult(const ParamsBase* pParamsBase, const Result<MID>& result, const jsonrpc::RequestTiming* pTiming = nullptr)
+    {
+        SlabBuffer resultBuf;
+        size_t published_offset;
+        {
+            TRACY_ZONE_NAMED("format.result");
+            published_offset = jsonrpc::write_result(resultBuf, pParamsBase->req_id, result, pTiming);
+        }
+        this->post(OutgoingMessage { std::move(resultBuf).to_message(), pParamsBase->req_id, pParamsBase->method_id, metrics::now_ns(), published_offset });
+    }
+    // thread-safe: likewise for the error a handler threw (MethodError)
+    void postError(const ParamsBase* pParamsBase, const MethodError& error)
+    {
+        SlabBuffer errBuf;
+        jsonrpc::write_error(errBuf, pParamsBase->req_id, error.code, error.what());
+        this->post(OutgoingMessage { std::move(errBuf).to_message(), pParamsBase->req_id, pParamsBase->method_id, metrics::now_ns() });
+    }
+    // main thread: publishes the queued results
     void publish_outgoing_messages();
+    // main thread: the doorbell fd fired; re-arms it and publishes
+    void on_outgoing_ready();
+    // poll this for ZMQ_POLLIN to learn about queued results (-1 if unsupported)
+    zmq_fd_t outgoing_fd() const noexcept { return m_outgoingBell.fd(); }
+    // main thread: reports the hybrid ingress loop's spin/block wakeups in the stats
+    void set_busy_poll(const AdaptiveSpin* pSpin) noexcept { m_pBusyPoll = pSpin; }
+    // main thread: publishes the metrics snapshot as the result of an rpc.stats request
+    void sendStats(const ParamsBase*);
+    // main thread: publishes the result frame of req_id again (rpc.resend); nothing when it is not held
+    void resend(TReqID req_id);
+    // main thread: publishes the metrics snapshot as an rpc.stats notification
+    void publish_stats_notification();
+    // main thread: what a Broker balances instances on (see DispatcherServer::Options::broker_address)
+    struct Load
+    {
+        uint64_t queued;        // waiting for a worker, in the pool and the fair queue
+        uint64_t in_flight;     // dispatched, result not yet published
+        uint64_t pipelines;
+    };
+    Load load() const
+    {
+        return { m_threadPool.get_tasks_queued() + (m_pFairQueue ? m_pFairQueue->queued() : 0), in_flight(), pipeline_count() };
+    }
 protected:
-    // TODO: replace these with object pool based buffers
-    static fmt::memory_buffer ackBuf;
-    static fmt::memory_buffer errBuf;
+    // the cache epoch a request is dispatched at (see ResponseCache); 0 for methods that are not Cacheable
+    template<MethodID MID>
+    static uint64_t cache_epoch_of(const MethodParams<MID>&) noexcept
+    {
+        if constexpr (Cacheable<MID>::ttl_ms > 0) return ResponseCache::instance().epoch((TMethodID)MID);
+        else return 0;
+    }
+    // worker thread: keeps the serialized result of a Cacheable method for its TTL
+    template<MethodID MID>
+    void cache_result(const MethodParams<MID>& params, const Result<MID>& result, uint64_t epoch)
+    {
+        if constexpr (Cacheable<MID>::ttl_ms > 0)
+        {
+            SlabBuffer resultBuf;
+            JsonWriter w(resultBuf);
+            result.write_json(w);
+            ResponseCache::instance().store((TMethodID)MID, Cacheable<MID>::key(params), epoch,
+                { resultBuf.data(), resultBuf.size() }, metrics::now_ns() + Cacheable<MID>::ttl_ms * 1000000);
+        }
+    }
+    // main thread: answers a Cacheable request from the cache, without the executor; false on a miss
+    template<MethodID MID>
+    bool serve_cached(const MethodParams<MID>& params, uint64_t received_at)
+    {
+        if constexpr (Cacheable<MID>::ttl_ms > 0)
+        {
+            TRACY_ZONE_NAMED("cache.hit");
+            SlabBuffer resultBuf;
+            jsonrpc::write_result_prefix(resultBuf, params.base()->req_id);
+            if (!ResponseCache::instance().append_to((TMethodID)MID, Cacheable<MID>::key(params), metrics::now_ns(), resultBuf))
+            {
+                ++m_nCacheMisses;
+                return false;
+            }
+            resultBuf.push_back('}');
+            this->publish_result(params.base()->req_id, std::move(resultBuf).to_message());
+            ++m_nCacheHits;
+            metrics::record((TMethodID)MID, metrics::Stage::Dispatch, metrics::now_ns() - received_at);
+            return true;
+        }
+        else return false;
+    }
+    // worker thread: runs the handler and posts its result; a coroutine handler
+    // continues on the scheduler and posts its result when it completes
+    template<MethodID MID>
+    void execute(MethodParams<MID>& params, uint64_t cache_epoch, uint64_t dispatched_at)
+    {
+        const uint64_t started_at = metrics::now_ns();
+        metrics::record((TMethodID)MID, metrics::Stage::QueueWait, started_at - dispatched_at);
+        if constexpr (coro::is_task_v<typename HandlerReturn<MID>::type>)
+            run_coroutine<MID>(std::move(params), cache_epoch, dispatched_at, started_at).start(m_scheduler);
+        else
+        {
+            // declared first: result (on the arena) is gone before the lease releases it
+            const RequestArena::Lease arena = RequestArena::acquire();
+            params.arena = arena.get();
+            std::optional<Result<MID>> result;
+            try
+            {
+                TRACY_ZONE_NAMED("handleMethod");
+                TRACY_ZONE_TEXT(method_name(MID));
+                result.emplace(handleMethod(params));
+            }
+            catch (const MethodError& e)
+            {
+                this->postError(params.base(), e);
+                return;
+            }
+            const uint64_t finished_at = metrics::now_ns();
+            metrics::record((TMethodID)MID, metrics::Stage::Execution, finished_at - started_at);
+            this->cache_result(params, *result, cache_epoch);
+            const jsonrpc::RequestTiming timing { params.received_at, dispatched_at, started_at, finished_at };
+            this->postResult(params.base(), *result, params.timed ? &timing : nullptr);
+        }
+    }
+    // the frame owns params and their arena; its execution time includes the time spent suspended
+    template<MethodID MID>
+    coro::Detached run_coroutine(MethodParams<MID> params, uint64_t cache_epoch, uint64_t dispatched_at, uint64_t started_at)
+    {
+        // taken before the first suspension: the request counts against the fair queue's window until it completes
+        const FairQueue::Slot slot = FairQueue::hold_slot();
+        const RequestArena::Lease arena = RequestArena::acquire();
+        params.arena = arena.get();
+        std::optional<Result<MID>> result;
+        try
+        {
+            result.emplace(co_await handleMethod(params));
+        }
+        catch (const MethodError& e)
+        {
+            this->postError(params.base(), e);
+            co_return;
+        }
+        const uint64_t finished_at = metrics::now_ns();
+        metrics::record((TMethodID)MID, metrics::Stage::Execution, finished_at - started_at);
+        this->cache_result(params, *result, cache_epoch);
+        const jsonrpc::RequestTiming timing { params.received_at, dispatched_at, started_at, finished_at };
+        this->postResult(params.base(), *result, params.timed ? &timing : nullptr);
+    }
+    // main thread: runs task on the pool, through the fair queue when enabled; false when the client's queue is full
+    bool submit(TClientID client_id, std::move_only_function<void()>&& task);
+    // worker thread: publishes out directly when it can, otherwise queues it for the main thread
+    void post(OutgoingMessage&& out)
+    {
+        if (m_pProxy && publish_from_worker(out))
+            return;
+        m_outgoing.push(std::move(out));
+        m_outgoingBell.ring();
+    }
+    // worker thread: sends on its own proxy connected socket; false when not called on a pool
+    // worker, or before its socket is ready (the result then goes through m_outgoing)
+    bool publish_from_worker(OutgoingMessage& out);
+    uint64_t in_flight() const noexcept { return m_nInFlight - m_nDirectPublished.load(std::memory_order_relaxed); }
+    void handle_batch(zmq::message_t&& frame, uint64_t received_at);
+    // frame owns record: a single request frame, or a shared reference to a batch frame
+    void dispatch_request(zmq::message_t&& frame, std::string_view record, uint64_t received_at);
+    void publish(zmq::message_t&& msg);
+    // main thread: publishes a result frame, kept for rpc.resend
+    void publish_result(TReqID req_id, zmq::message_t&& msg);
+    void write_stats_json(SlabBuffer& out);
+    // profiler plots of the queue depths; empty without ENABLE_TRACY
+    void plot_gauges() const
+    {
+        TRACY_PLOT("executor queued", m_threadPool.get_tasks_queued());
+        TRACY_PLOT("executor running", m_threadPool.get_tasks_running());
+        TRACY_PLOT("outgoing queue", m_outgoing.size());
+        TRACY_PLOT("in flight", in_flight());
+    }
 };
\ No newline at end of file
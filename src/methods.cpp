@@ -1,28 +1,127 @@
 #include "headers.hpp"
 
+namespace
+{
+    // the pipelines as the handlers see them; List and Status answer from here
+    TRACY_LOCKABLE(std::mutex, g_pipelinesMutex, "pipelines");
+    std::map<TPipelineID, PipelineState> g_pipelines;
+    TPipelineID g_pipelineInstance = 0;     // the high byte of the ids; set before requests run
+    TPipelineID g_nPipelineSequence = 0;    // the low bits of the last id handed out, under g_pipelinesMutex
+    // admission of the Starts, when set; keyed by the decimal pipeline id
+    std::unique_ptr<PipelineBudget> g_pBudget;
+
+    // sets (or with Unknown, removes) the state of a running pipeline and drops the cached answers it changes;
+    // false, changing nothing, when there is no such pipeline
+    bool set_pipeline_state(TPipelineID pipeline_id, PipelineState state)
+    {
+        {
+            std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_pipelinesMutex);
+            auto it = g_pipelines.find(pipeline_id);
+            if (it == g_pipelines.end()) return false;
+            if (state == PipelineState::Unknown) g_pipelines.erase(it);
+            else it->second = state;
+        }
+        ResponseCache::instance().invalidate((TMethodID)MethodID::GStreamer_Pipeline_List);
+        ResponseCache::instance().invalidate((TMethodID)MethodID::GStreamer_Pipeline_Status, pipeline_id);
+        return true;
+    }
+
+    [[noreturn]] void throw_no_pipeline(TPipelineID pipeline_id)
+    {
+        throw MethodError(jsonrpc::NO_PIPELINE, "No such pipeline: " + std::to_string(pipeline_id));
+    }
+
+    // a new pipeline in state: the sequence wraps within PIPELINE_SEQUENCE_MASK and never carries into the instance byte
+    TPipelineID add_pipeline(PipelineState state)
+    {
+        TPipelineID pipeline_id;
+        {
+            std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_pipelinesMutex);
+            do
+            {
+                g_nPipelineSequence = (g_nPipelineSequence + 1) & PIPELINE_SEQUENCE_MASK;
+                pipeline_id = g_pipelineInstance | g_nPipelineSequence;
+            } while (g_nPipelineSequence == 0 || g_pipelines.contains(pipeline_id));
+            g_pipelines[pipeline_id] = state;
+        }
+        ResponseCache::instance().invalidate((TMethodID)MethodID::GStreamer_Pipeline_List);
+        ResponseCache::instance().invalidate((TMethodID)MethodID::GStreamer_Pipeline_Status, pipeline_id);
+        return pipeline_id;
+    }
+}
+
+void set_pipeline_instance(uint8_t instance_id) noexcept
+{
+    g_pipelineInstance = TPipelineID(instance_id) << PIPELINE_INSTANCE_SHIFT;
+}
+
+void set_pipeline_budget(PipelineBudget::Options options)
+{
+    // a queued Start would need someone to launch it later; the handler answers right away
+    options.max_queued = 0;
+    g_pBudget = std::make_unique<PipelineBudget>(std::move(options));
+}
+
+size_t pipeline_count()
+{
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_pipelinesMutex);
+    return g_pipelines.size();
+}
+
 template<MethodID MID>
-void handleMethod(const MethodParams<MID>& params) { std::cerr << "Unknown Method" << std::endl; }
+typename HandlerReturn<MID>::type handleMethod(const MethodParams<MID>& params) { std::cerr << "Unknown Method" << std::endl; return {}; }
 
 template<>
-void handleMethod<MethodID::GStreamer_Pipeline_Start>(const MethodParams<MethodID::GStreamer_Pipeline_Start>& params)
+Result<MethodID::GStreamer_Pipeline_Start> handleMethod<MethodID::GStreamer_Pipeline_Start>(const MethodParams<MethodID::GStreamer_Pipeline_Start>& params)
 {
     std::cout << "GStreamer_Pipeline_Start" << std::endl;
+    const TPipelineID pipeline_id = add_pipeline(PipelineState::Running);
+    if (g_pBudget && g_pBudget->admit(std::to_string(pipeline_id)) != PipelineBudget::Admission::Admitted)
+    {
+        set_pipeline_state(pipeline_id, PipelineState::Unknown);
+        throw MethodError(jsonrpc::OVER_BUDGET, "Over budget: not enough CPU for another pipeline");
+    }
+    return { pipeline_id };
 }
 
 template<>
-void handleMethod<MethodID::GStreamer_Pipeline_Pause>(const MethodParams<MethodID::GStreamer_Pipeline_Pause>& params)
+Result<MethodID::GStreamer_Pipeline_Pause> handleMethod<MethodID::GStreamer_Pipeline_Pause>(const MethodParams<MethodID::GStreamer_Pipeline_Pause>& params)
 {
     std::cout << "GStreamer_Pipeline_Pause" << std::endl;
+    if (!set_pipeline_state(params.pipeline_id, PipelineState::Paused)) throw_no_pipeline(params.pipeline_id);
+    return {};
 }
 
 template<>
-void handleMethod<MethodID::GStreamer_Pipeline_Resume>(const MethodParams<MethodID::GStreamer_Pipeline_Resume>& params)
+Result<MethodID::GStreamer_Pipeline_Resume> handleMethod<MethodID::GStreamer_Pipeline_Resume>(const MethodParams<MethodID::GStreamer_Pipeline_Resume>& params)
 {
     std::cout << "GStreamer_Pipeline_Resume" << std::endl;
+    if (!set_pipeline_state(params.pipeline_id, PipelineState::Running)) throw_no_pipeline(params.pipeline_id);
+    return {};
 }
 
 template<>
-void handleMethod<MethodID::GStreamer_Pipeline_Stop>(const MethodParams<MethodID::GStreamer_Pipeline_Stop>& params)
+Result<MethodID::GStreamer_Pipeline_Stop> handleMethod<MethodID::GStreamer_Pipeline_Stop>(const MethodParams<MethodID::GStreamer_Pipeline_Stop>& params)
 {
     std::cout << "GStreamer_Pipeline_Stop" << std::endl;
-}
\ No newline at end of file
+    set_pipeline_state(params.pipeline_id, PipelineState::Unknown);
+    if (g_pBudget) g_pBudget->release(std::to_string(params.pipeline_id));
+    return {};
+}
+
+template<>
+Result<MethodID::GStreamer_Pipeline_List> handleMethod<MethodID::GStreamer_Pipeline_List>(const MethodParams<MethodID::GStreamer_Pipeline_List>& params)
+{
+    Result<MethodID::GStreamer_Pipeline_List> result { decltype(result.pipelines)(params.memory()) };
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_pipelinesMutex);
+    result.pipelines.assign(g_pipelines.begin(), g_pipelines.end());
+    return result;
+}
+
+template<>
+Result<MethodID::GStreamer_Pipeline_Status> handleMethod<MethodID::GStreamer_Pipeline_Status>(const MethodParams<MethodID::GStreamer_Pipeline_Status>& params)
+{
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_pipelinesMutex);
+    auto it = g_pipelines.find(params.pipeline_id);
+    return { params.pipeline_id, it != g_pipelines.end() ? it->second : PipelineState::Unknown };
+}
@@ -6,6 +6,9 @@
 typedef std::uint64_t   TReqID;
 typedef std::uint8_t    TMethodID;
 typedef std::uint32_t   TPipelineID;
+typedef std::uint32_t   TBatchCount;    // number of records in a batch frame
+typedef std::uint32_t   TRecordSize;    // size of one batch record (ParamsBase + payload)
+typedef std::uint32_t   TClientID;      // producer a request is queued for (see FairQueue), 0 = anonymous
 
 #pragma pack(push, 1) // prevent padding
 struct ParamsBase
@@ -15,9 +18,26 @@ struct ParamsBase
 };
 #pragma pack(pop) // Resets to default packing
 
+// method_id flags: optional header fields that follow ParamsBase, in this order
+//   ParamsBase | [TClientID if METHOD_FLAG_CLIENT] | payload
+// METHOD_FLAG_TIMING adds no field: the result reports the request's stage timestamps
+constexpr TMethodID METHOD_FLAG_CLIENT = 0x80;
+constexpr TMethodID METHOD_FLAG_TIMING = 0x40;
+constexpr TMethodID METHOD_FLAGS = METHOD_FLAG_CLIENT | METHOD_FLAG_TIMING;
+
 struct ParamsEnd
 {
     zmq::message_t raw_msg; // Maintains ownership for zero-copy
+    ParamsBase header;      // copied out of the frame (flags stripped): JSON frames have no binary header
+    TClientID client_id = 0;
+    bool timed = false;             // METHOD_FLAG_TIMING: the result carries the stage timestamps
+    uint64_t received_at = 0;       // metrics::now_ns() when the ingress thread read the request
+    RequestArena* arena = nullptr;  // set by the executor for the handler's run, released after the result is published
+
+    // the header of the request these params were decoded from
+    const ParamsBase* base() const noexcept { return &header; }
+    // for the handler's per-request allocations (its Result's pmr containers); the default resource outside a worker
+    std::pmr::memory_resource* memory() const noexcept { return arena ? static_cast<std::pmr::memory_resource*>(arena) : std::pmr::get_default_resource(); }
 };
 
 enum class MethodID : TMethodID
@@ -30,39 +50,374 @@ enum class MethodID : TMethodID
     VIDEO,
     CONTROL,
     SHUTDOWN,
+    RPC_Stats,  // reserved: metrics snapshot, answered by the ingress thread
+    RPC_Batch,  // reserved: frame of many requests, see decode_batch()
+    GStreamer_Pipeline_List,
+    GStreamer_Pipeline_Status,
+    RPC_Resend, // reserved: publishes a recent result again (see RetransmitBuffer), answered by the ingress thread
     Unknown // dummy sentinel for validation (value < Methods::Unknown)
 };
 
+constexpr std::string_view method_name(MethodID mid) noexcept
+{
+    switch (mid)
+    {
+        case MethodID::GStreamer_Pipeline_Start:  return "GStreamer_Pipeline_Start";
+        case MethodID::GStreamer_Pipeline_Pause:  return "GStreamer_Pipeline_Pause";
+        case MethodID::GStreamer_Pipeline_Resume: return "GStreamer_Pipeline_Resume";
+        case MethodID::GStreamer_Pipeline_Stop:   return "GStreamer_Pipeline_Stop";
+        case MethodID::AUDIO:                     return "AUDIO";
+        case MethodID::VIDEO:                     return "VIDEO";
+        case MethodID::CONTROL:                   return "CONTROL";
+        case MethodID::SHUTDOWN:                  return "SHUTDOWN";
+        case MethodID::RPC_Stats:                 return "rpc.stats";
+        case MethodID::RPC_Batch:                 return "rpc.batch";
+        case MethodID::GStreamer_Pipeline_List:   return "GStreamer_Pipeline_List";
+        case MethodID::GStreamer_Pipeline_Status: return "GStreamer_Pipeline_Status";
+        case MethodID::RPC_Resend:                return "rpc.resend";
+        default:                                  return "Unknown";
+    }
+}
+
+// reverse of method_name(); MethodID::Unknown when there is no such method
+constexpr MethodID method_from_name(std::string_view name) noexcept
+{
+    for (TMethodID mid = 0; mid < (TMethodID)MethodID::Unknown; ++mid)
+        if (method_name((MethodID)mid) == name) return (MethodID)mid;
+    return MethodID::Unknown;
+}
+
 template<MethodID MID = MethodID::Unknown>
 struct Payload { };
 
+// Each payload decodes itself, zero-copy, from the bytes after the request
+// header, and encode() returns the bytes decode() reads back (a view into the
+// payload) for clients building requests (see encode_request)
 template<>
 struct Payload<MethodID::GStreamer_Pipeline_Start>
 {
     std::string_view pipeline_config;
+    static Payload decode(std::string_view payload) { return { payload }; }
+    std::string_view encode() const noexcept { return pipeline_config; }
 };
 
 template<>
 struct Payload<MethodID::GStreamer_Pipeline_Stop>
 {
     TPipelineID pipeline_id;
+    static Payload decode(std::string_view payload) { return { *reinterpret_cast<const TPipelineID*>(payload.data()) }; }
+    std::string_view encode() const noexcept { return { reinterpret_cast<const char*>(&pipeline_id), sizeof(pipeline_id) }; }
 };
 template<>
 struct Payload<MethodID::GStreamer_Pipeline_Pause>
 {
     TPipelineID pipeline_id;
+    static Payload decode(std::string_view payload) { return { *reinterpret_cast<const TPipelineID*>(payload.data()) }; }
+    std::string_view encode() const noexcept { return { reinterpret_cast<const char*>(&pipeline_id), sizeof(pipeline_id) }; }
 };
 template<>
 struct Payload<MethodID::GStreamer_Pipeline_Resume>
 {
     TPipelineID pipeline_id;
+    static Payload decode(std::string_view payload) { return { *reinterpret_cast<const TPipelineID*>(payload.data()) }; }
+    std::string_view encode() const noexcept { return { reinterpret_cast<const char*>(&pipeline_id), sizeof(pipeline_id) }; }
+};
+
+template<>
+struct Payload<MethodID::GStreamer_Pipeline_List>
+{
+    static Payload decode(std::string_view) { return {}; }
+    std::string_view encode() const noexcept { return {}; }
+};
+template<>
+struct Payload<MethodID::GStreamer_Pipeline_Status>
+{
+    TPipelineID pipeline_id;
+    static Payload decode(std::string_view payload) { return { *reinterpret_cast<const TPipelineID*>(payload.data()) }; }
+    std::string_view encode() const noexcept { return { reinterpret_cast<const char*>(&pipeline_id), sizeof(pipeline_id) }; }
+};
+template<>
+struct Payload<MethodID::RPC_Resend>
+{
+    TReqID req_id;      // of the result to publish again
+    static Payload decode(std::string_view payload) { TReqID req_id; std::memcpy(&req_id, payload.data(), sizeof(req_id)); return { req_id }; }
+    std::string_view encode() const noexcept { return { reinterpret_cast<const char*>(&req_id), sizeof(req_id) }; }
+};
+
+// Methods whose response can be served from the ResponseCache (by the ingress
+// thread, without the executor) for ttl_ms after it was computed; entries are
+// keyed by key(payload) and invalidated by the handlers that change the state.
+template<MethodID MID = MethodID::Unknown>
+struct Cacheable
+{
+    static constexpr uint64_t ttl_ms = 0;   // not cacheable
+};
+template<>
+struct Cacheable<MethodID::GStreamer_Pipeline_List>
+{
+    static constexpr uint64_t ttl_ms = 1000;
+    static uint64_t key(const Payload<MethodID::GStreamer_Pipeline_List>&) noexcept { return 0; }
+};
+template<>
+struct Cacheable<MethodID::GStreamer_Pipeline_Status>
+{
+    static constexpr uint64_t ttl_ms = 1000;
+    static uint64_t key(const Payload<MethodID::GStreamer_Pipeline_Status>& payload) noexcept { return payload.pipeline_id; }
 };
 
 template<MethodID MID = MethodID::Unknown>
 struct MethodParams : public Payload<MID>, ParamsEnd { };
 
+// whether the dispatcher runs mid and payload_size holds its Payload
+constexpr bool is_dispatchable(MethodID mid, size_t payload_size) noexcept
+{
+    switch (mid)
+    {
+        case MethodID::GStreamer_Pipeline_Start:
+        case MethodID::GStreamer_Pipeline_List:
+        case MethodID::RPC_Stats:
+            return true;
+        case MethodID::GStreamer_Pipeline_Stop:
+        case MethodID::GStreamer_Pipeline_Pause:
+        case MethodID::GStreamer_Pipeline_Resume:
+        case MethodID::GStreamer_Pipeline_Status:
+            return payload_size >= sizeof(TPipelineID);
+        case MethodID::RPC_Resend:
+            return payload_size >= sizeof(TReqID);
+        default:
+            return false;
+    }
+}
+
+// What a method returns; written as the "result" member of the response
+// (see jsonrpc::write_result). Methods without a specialization return null.
 template<MethodID MID = MethodID::Unknown>
-void handleMethod(const MethodParams<MID>& params);
+struct Result { };
+
+template<>
+struct Result<MethodID::GStreamer_Pipeline_Start>
+{
+    TPipelineID pipeline_id;
+
+    template<typename Writer>
+    void write_json(Writer& w) const
+    {
+        w.raw(R"({"pipeline_id":)");
+        w.u64(pipeline_id);
+        w.raw('}');
+    }
+};
+
+enum class PipelineState : uint8_t
+{
+    Unknown,    // no such pipeline
+    Running,
+    Paused
+};
+
+constexpr std::string_view pipeline_state_name(PipelineState state) noexcept
+{
+    switch (state)
+    {
+        case PipelineState::Running: return "running";
+        case PipelineState::Paused:  return "paused";
+        default:                     return "unknown";
+    }
+}
+
+template<>
+struct Result<MethodID::GStreamer_Pipeline_List>
+{
+    std::pmr::vector<std::pair<TPipelineID, PipelineState>> pipelines;    // on the request's arena
+
+    template<typename Writer>
+    void write_json(Writer& w) const
+    {
+        w.raw(R"({"pipelines":[)");
+        for (size_t i = 0; i < pipelines.size(); ++i)
+        {
+            if (i) w.raw(',');
+            w.raw(R"({"pipeline_id":)");
+            w.u64(pipelines[i].first);
+            w.raw(R"(,"state":)");
+            w.string(pipeline_state_name(pipelines[i].second));
+            w.raw('}');
+        }
+        w.raw("]}");
+    }
+};
+
+template<>
+struct Result<MethodID::GStreamer_Pipeline_Status>
+{
+    TPipelineID pipeline_id;
+    PipelineState state;
+
+    template<typename Writer>
+    void write_json(Writer& w) const
+    {
+        w.raw(R"({"pipeline_id":)");
+        w.u64(pipeline_id);
+        w.raw(R"(,"state":)");
+        w.string(pipeline_state_name(state));
+        w.raw('}');
+    }
+};
+
+// What handleMethod<MID> returns: Result<MID>, or coro::Task<Result<MID>> for
+// a handler that co_awaits (state changes, timers) instead of blocking a worker.
+template<MethodID MID = MethodID::Unknown>
+struct HandlerReturn
+{
+    using type = Result<MID>;
+};
+
+template<MethodID MID = MethodID::Unknown>
+typename HandlerReturn<MID>::type handleMethod(const MethodParams<MID>& params);
+
+// thrown by a handler to answer its request with a JSON-RPC error (jsonrpc:: codes) instead of a Result
+struct MethodError : std::runtime_error
+{
+    int code;
+    MethodError(int code, const std::string& message) : std::runtime_error(message), code(code) { }
+};
+
+// Pipeline ids carry the id of the instance that started them in the high
+// byte, so a Broker sends every later command for a pipeline to its owner
+// without keeping a table (the low 24 bits count the instance's Starts and
+// wrap around within them, skipping 0 and the ids still running)
+constexpr unsigned PIPELINE_INSTANCE_SHIFT = 24;
+constexpr TPipelineID PIPELINE_SEQUENCE_MASK = (TPipelineID(1) << PIPELINE_INSTANCE_SHIFT) - 1;
+constexpr uint8_t pipeline_instance(TPipelineID pipeline_id) noexcept { return uint8_t(pipeline_id >> PIPELINE_INSTANCE_SHIFT); }
+
+// stamps instance_id on the pipeline ids started from now on; call before requests run
+void set_pipeline_instance(uint8_t instance_id) noexcept;
+// admits the Starts from now on within a CPU budget: one that does not fit fails with
+// jsonrpc::OVER_BUDGET at once (options.max_queued is ignored); call before requests run.
+// The handlers report no CPU use, so each pipeline costs options.default_cost: a count cap
+void set_pipeline_budget(PipelineBudget::Options options);
+// the pipelines this instance runs
+size_t pipeline_count();
+
+// the pipeline a request operates on, if it is bound to one; payload is the bytes after its header
+inline std::optional<TPipelineID> bound_pipeline(MethodID mid, std::string_view payload) noexcept
+{
+    switch (mid)
+    {
+        case MethodID::GStreamer_Pipeline_Stop:
+        case MethodID::GStreamer_Pipeline_Pause:
+        case MethodID::GStreamer_Pipeline_Resume:
+        case MethodID::GStreamer_Pipeline_Status:
+            if (payload.size() < sizeof(TPipelineID)) return std::nullopt;
+            TPipelineID pipeline_id;
+            std::memcpy(&pipeline_id, payload.data(), sizeof(pipeline_id));
+            return pipeline_id;
+        default:
+            return std::nullopt;
+    }
+}
+
+// The header of a request record: ParamsBase with the flags stripped from
+// method_id, and the optional fields the flags announced
+struct RequestHeader
+{
+    ParamsBase base;
+    TClientID client_id = 0;
+    bool timed = false;                 // METHOD_FLAG_TIMING
+    size_t size = sizeof(ParamsBase);   // offset of the payload in the record
+
+    MethodID method() const noexcept { return (MethodID)base.method_id; }
+};
+
+// false when record is too short for the fields its flags announce
+inline bool read_header(std::string_view record, RequestHeader& header) noexcept
+{
+    if (record.size() < sizeof(ParamsBase)) return false;
+    std::memcpy(&header.base, record.data(), sizeof(ParamsBase));
+    const TMethodID flags = header.base.method_id & METHOD_FLAGS;
+    header.base.method_id &= ~METHOD_FLAGS;
+    header.size = sizeof(ParamsBase);
+    header.client_id = 0;
+    header.timed = flags & METHOD_FLAG_TIMING;
+    if (flags & METHOD_FLAG_CLIENT)
+    {
+        if (record.size() < header.size + sizeof(TClientID)) return false;
+        std::memcpy(&header.client_id, record.data() + header.size, sizeof(TClientID));
+        header.size += sizeof(TClientID);
+    }
+    return true;
+}
+
+// Decodes one request record (header + payload) that lives in frame; the
+// params take ownership of the frame, the payload fields point into it.
+// A frame holds one record, or many when it is a batch.
+template<MethodID MID>
+MethodParams<MID> decode_params(zmq::message_t&& frame, std::string_view record, const RequestHeader& header)
+{
+    return MethodParams<MID> { Payload<MID>::decode(record.substr(header.size)), { std::move(frame), header.base, header.client_id, header.timed } };
+}
+
+template<MethodID MID>
+MethodParams<MID> decode_params(zmq::message_t&& frame, std::string_view record)
+{
+    RequestHeader header;
+    read_header(record, header);
+    return decode_params<MID>(std::move(frame), record, header);
+}
+
+// Decodes a request frame (header + payload) into its params
+template<MethodID MID>
+MethodParams<MID> decode_params(zmq::message_t&& msg)
+{
+    const std::string_view record = msg.to_string_view();
+    return decode_params<MID>(std::move(msg), record);
+}
+
+// Encodes a request frame for MID: the header, with the client id when one
+// is given (METHOD_FLAG_CLIENT), and the payload; timed asks for the stage
+// timestamps in the result (METHOD_FLAG_TIMING)
+template<MethodID MID>
+zmq::message_t encode_request(TReqID req_id, const Payload<MID>& payload, TClientID client_id = 0, bool timed = false)
+{
+    const std::string_view bytes = payload.encode();
+    const size_t header_size = sizeof(ParamsBase) + (client_id ? sizeof(TClientID) : 0);
+    zmq::message_t msg(header_size + bytes.size());
+    char* pData = static_cast<char*>(msg.data());
+    const ParamsBase header { req_id, TMethodID((TMethodID)MID | (client_id ? METHOD_FLAG_CLIENT : 0) | (timed ? METHOD_FLAG_TIMING : 0)) };
+    std::memcpy(pData, &header, sizeof(header));
+    if (client_id) std::memcpy(pData + sizeof(header), &client_id, sizeof(client_id));
+    if (!bytes.empty()) std::memcpy(pData + header_size, bytes.data(), bytes.size());
+    return msg;
+}
+
+// A batch frame carries many requests behind one ParamsBase { batch id, RPC_Batch }:
+//   ParamsBase | TBatchCount n | n x ( TRecordSize size | record[size] )
+// where every record is a request header (with its own flags) and payload.
+// Splits it into the records (views into frame); false if the layout is broken.
+inline bool decode_batch(std::string_view frame, std::vector<std::string_view>& records)
+{
+    constexpr size_t HEADER_SIZE = sizeof(ParamsBase) + sizeof(TBatchCount);
+    if (frame.size() < HEADER_SIZE) return false;
+    TBatchCount count;
+    std::memcpy(&count, frame.data() + sizeof(ParamsBase), sizeof(count));
+    frame.remove_prefix(HEADER_SIZE);
+    // a count the frame cannot hold is rejected before anything is reserved
+    if (count > frame.size() / (sizeof(TRecordSize) + sizeof(ParamsBase))) return false;
+
+    records.clear();
+    records.reserve(count);
+    for (TBatchCount i = 0; i < count; ++i)
+    {
+        TRecordSize size;
+        if (frame.size() < sizeof(size)) return false;
+        std::memcpy(&size, frame.data(), sizeof(size));
+        frame.remove_prefix(sizeof(size));
+        if (size < sizeof(ParamsBase) || size > frame.size()) return false;
+        records.push_back(frame.substr(0, size));
+        frame.remove_prefix(size);
+    }
+    return frame.empty();
+}
 
 // Compile-time checks
 static_assert(sizeof(ParamsBase) == 9, "ParamsBase must be exactly 9 bytes");
@@ -0,0 +1,101 @@
+#include "headers.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace metrics
+{
+    static constexpr size_t NUM_METHODS = (size_t)MethodID::Unknown;
+    static constexpr size_t NUM_STAGES = (size_t)Stage::Count;
+
+    static constexpr std::string_view STAGE_NAMES[NUM_STAGES] = { "dispatch", "queue_wait", "execution", "publish" };
+
+    struct ThreadMetrics
+    {
+        Histogram latencies[NUM_METHODS][NUM_STAGES];
+    };
+
+    // Every thread that ever recorded; entries are kept after the thread exits
+    // so their samples stay in the totals.
+    static TRACY_LOCKABLE(std::mutex, g_registryMutex, "metrics registry");
+    static std::vector<std::unique_ptr<ThreadMetrics>> g_registry;
+
+    static ThreadMetrics& thread_metrics()
+    {
+        thread_local ThreadMetrics* pMetrics = [] {
+            auto metrics = std::make_unique<ThreadMetrics>();
+            std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_registryMutex);
+            return g_registry.emplace_back(std::move(metrics)).get();
+        }();
+        return *pMetrics;
+    }
+
+    void record(TMethodID method_id, Stage stage, uint64_t ns) noexcept
+    {
+        if (method_id >= NUM_METHODS) [[unlikely]] return;
+        thread_metrics().latencies[method_id][(size_t)stage].record(ns);
+    }
+
+    void HistogramSnapshot::merge(const Histogram& h) noexcept
+    {
+        for (unsigned i = 0; i < Histogram::BUCKETS; ++i)
+            counts[i] += h.m_counts[i].load(std::memory_order_relaxed);
+        count += h.m_nCount.load(std::memory_order_relaxed);
+        sum += h.m_nSum.load(std::memory_order_relaxed);
+        max = std::max(max, h.m_nMax.load(std::memory_order_relaxed));
+    }
+
+    uint64_t HistogramSnapshot::percentile(double p) const noexcept
+    {
+        // bucket counts and the total are read independently; rank against the buckets
+        uint64_t total = 0;
+        for (uint64_t c : counts) total += c;
+        if (!total) return 0;
+
+        const uint64_t rank = std::max<uint64_t>(1, (uint64_t)(p / 100.0 * (double)total + 0.5));
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < Histogram::BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank) return std::min(Histogram::bucket_upper(i), max);
+        }
+        return max;
+    }
+
+    HistogramSnapshot snapshot(TMethodID method_id, Stage stage)
+    {
+        HistogramSnapshot snap;
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(g_registryMutex);
+        for (const auto& pMetrics : g_registry)
+            snap.merge(pMetrics->latencies[method_id][(size_t)stage]);
+        return snap;
+    }
+
+    void write_methods_json(SlabBuffer& out)
+    {
+        bool bFirst = true;
+        for (TMethodID mid = 0; mid < NUM_METHODS; ++mid)
+        {
+            HistogramSnapshot stages[NUM_STAGES];
+            for (size_t stage = 0; stage < NUM_STAGES; ++stage)
+                stages[stage] = snapshot(mid, (Stage)stage);
+            if (!stages[(size_t)Stage::Dispatch].count && !stages[(size_t)Stage::Execution].count)
+                continue;
+
+            fmt::format_to(std::back_inserter(out), R"({}"{}":{{"count":{})",
+                bFirst ? "" : ",", method_name((MethodID)mid), stages[(size_t)Stage::Execution].count);
+            for (size_t stage = 0; stage < NUM_STAGES; ++stage)
+            {
+                const HistogramSnapshot& h = stages[stage];
+                fmt::format_to(std::back_inserter(out),
+                    R"(,"{}":{{"p50":{:.3f},"p90":{:.3f},"p99":{:.3f},"p999":{:.3f},"max":{:.3f},"mean":{:.3f}}})",
+                    STAGE_NAMES[stage],
+                    h.percentile(50) / 1e3, h.percentile(90) / 1e3, h.percentile(99) / 1e3, h.percentile(99.9) / 1e3,
+                    h.max / 1e3, h.count ? (double)h.sum / (double)h.count / 1e3 : 0.0);
+            }
+            out.push_back('}');
+            bFirst = false;
+        }
+    }
+}
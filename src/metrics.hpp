@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include "methods.hpp"
+#include "slab_allocator.hpp"
+
+/**
+* Lock-free, per-thread request metrics. Every recording thread owns its
+* counters (single writer, relaxed atomics, no RMW), and snapshots merge all
+* threads on the reader side. Latencies go into log-linear (HDR style)
+* histograms: 16 linear sub-buckets per power of two, i.e. ~3% resolution,
+* up to ~4.3 s (longer values land in the last bucket, max stays exact).
+*/
+namespace metrics
+{
+    enum class Stage : uint8_t
+    {
+        Dispatch,   // frame received -> task handed to the executor
+        QueueWait,  // handed to the executor -> task started
+        Execution,  // handleMethod() run time
+        Publish,    // result posted by the worker -> published on the PUB socket
+        Count
+    };
+
+    inline uint64_t now_ns() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    class Histogram
+    {
+    public:
+        static constexpr unsigned SUB_BITS = 4;
+        static constexpr unsigned SUB_COUNT = 1u << SUB_BITS;
+        static constexpr unsigned MAX_BITS = 32;
+        static constexpr unsigned BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+        static constexpr unsigned bucket_of(uint64_t v) noexcept
+        {
+            if (v < SUB_COUNT) return (unsigned)v;
+            const unsigned shift = std::bit_width(v) - 1 - SUB_BITS;
+            const unsigned idx = (shift + 1) * SUB_COUNT + (unsigned)((v >> shift) - SUB_COUNT);
+            return idx < BUCKETS ? idx : BUCKETS - 1;
+        }
+
+        // highest value that maps into the bucket
+        static constexpr uint64_t bucket_upper(unsigned idx) noexcept
+        {
+            if (idx < SUB_COUNT) return idx;
+            const unsigned shift = idx / SUB_COUNT - 1;
+            return ((uint64_t(idx % SUB_COUNT + SUB_COUNT) + 1) << shift) - 1;
+        }
+
+        // owning thread only
+        void record(uint64_t v) noexcept
+        {
+            bump(m_counts[bucket_of(v)], 1);
+            bump(m_nCount, 1);
+            bump(m_nSum, v);
+            if (v > m_nMax.load(std::memory_order_relaxed)) m_nMax.store(v, std::memory_order_relaxed);
+        }
+
+    private:
+        friend struct HistogramSnapshot;
+        static void bump(std::atomic<uint64_t>& c, uint64_t n) noexcept
+        {
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        std::atomic<uint64_t> m_counts[BUCKETS] {};
+        std::atomic<uint64_t> m_nCount { 0 };
+        std::atomic<uint64_t> m_nSum { 0 };
+        std::atomic<uint64_t> m_nMax { 0 };
+    };
+
+    struct HistogramSnapshot
+    {
+        uint64_t counts[Histogram::BUCKETS] {};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        void merge(const Histogram& h) noexcept;
+        uint64_t percentile(double p) const noexcept;
+    };
+
+    // records a latency sample (ns) for the method's stage on the calling thread
+    void record(TMethodID method_id, Stage stage, uint64_t ns) noexcept;
+
+    // snapshot of one method/stage merged across all threads
+    HistogramSnapshot snapshot(TMethodID method_id, Stage stage);
+
+    // appends "<method>":{"count":..,"<stage>":{"p50":..,..}},.. for every
+    // method with samples (latencies in microseconds)
+    void write_methods_json(SlabBuffer& out);
+}
@@ -1,26 +1,41 @@
 #pragma once
 
+#include <atomic>
+#include <optional>
+#include <utility>
+
+#include "lockfree_object_pool.hpp"
+
 template<typename T>
 class MpscQueue
 {
     struct Node
     {
         std::atomic<Node*> next = nullptr;
-        T data;
+        std::optional<T> data;
     };
 
+    // nodes are recycled through the pool: pushes on producer threads and pops
+    // on the consumer do not touch the heap in steady state
+    LockFreeObjectPool<Node> m_nodePool;
     alignas(64) std::atomic<Node*> m_pHead;
     alignas(64) Node* m_pTail;  // Only accessed by consumer (main thread)
     std::atomic<size_t> m_nSize { 0 };
 
 public:
-    MpscQueue() : m_pHead(new Node), m_pTail(m_pHead.load()) { }
-    ~MpscQueue() { while (pop()); } // Drain remaining messages
+    explicit MpscQueue(size_t prealloc_count = 1024)
+        : m_nodePool(prealloc_count), m_pHead(m_nodePool.acquire()), m_pTail(m_pHead.load()) { }
+    ~MpscQueue()
+    {
+        while (pop()); // Drain remaining messages
+        m_nodePool.release(m_pTail);
+    }
 
     // Push from any thread (producer)
     void push(T&& item)
     {
-        auto* new_node = new Node { std::move(item), nullptr };
+        Node* new_node = m_nodePool.acquire();
+        new_node->data.emplace(std::move(item));
         Node* prev_head = m_pHead.exchange(new_node, std::memory_order_acq_rel);
         prev_head->next.store(new_node, std::memory_order_release);
         m_nSize.fetch_add(1, std::memory_order_relaxed);
@@ -32,8 +47,9 @@ public:
         Node* first = m_pTail->next.load(std::memory_order_acquire);
         if (!first) return std::nullopt;
 
-        T data = std::move(first->data);
-        delete std::exchange(m_pTail, first);
+        std::optional<T> data = std::move(first->data);
+        first->data.reset();
+        m_nodePool.release(std::exchange(m_pTail, first));
         m_nSize.fetch_sub(1, std::memory_order_relaxed);
         return data;
     }
@@ -42,4 +58,9 @@ public:
     {
         return m_nSize.load(std::memory_order_relaxed);
     }
-};
\ No newline at end of file
+
+    ObjectPoolStats pool_stats() const noexcept
+    {
+        return m_nodePool.stats();
+    }
+};
@@ -0,0 +1,153 @@
+#include "headers.hpp"
+#include "numa_memory.hpp"
+
+#include <fstream>
+#include <mimalloc.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define ONEGB	((size_t)1 << 30)
+
+namespace numa
+{
+    unsigned node_count()
+    {
+        static const unsigned count = [] {
+            unsigned n = 1;
+#if defined(__linux__)
+            std::ifstream online("/sys/devices/system/node/online");
+            std::string list;
+            if (online >> list)
+            {
+                auto ids = utils::parse_id_list(list);
+                if (!ids.empty()) n = ids.back() + 1;
+            }
+#endif
+            return n;
+        }();
+        return count;
+    }
+
+    unsigned node_of_cpu(unsigned cpu)
+    {
+        static const std::vector<unsigned> nodes = [] {
+            std::vector<unsigned> cpuNodes;
+#if defined(__linux__)
+            for (unsigned node = 0; node < node_count(); ++node)
+            {
+                std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string list;
+                if (!(cpulist >> list)) continue;
+                for (unsigned id : utils::parse_id_list(list))
+                {
+                    if (id >= cpuNodes.size()) cpuNodes.resize(id + 1, 0);
+                    cpuNodes[id] = node;
+                }
+            }
+#endif
+            return cpuNodes;
+        }();
+        return cpu < nodes.size() ? nodes[cpu] : 0;
+    }
+
+    void prefer_node(unsigned node)
+    {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+        constexpr int MPOL_PREFERRED = 1;
+        unsigned long mask[4] = {};
+        if (node >= sizeof(mask) * 8) return;
+        mask[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) != 0)
+            std::cerr << "set_mempolicy to NUMA node " << node << " failed, using first-touch placement" << std::endl;
+#endif
+    }
+
+    // prefer (not force) pages of [addr, addr+len) on the given node
+    static void bind_to_node(void* addr, size_t len, unsigned node)
+    {
+#if defined(__linux__) && defined(SYS_mbind)
+        constexpr int MPOL_PREFERRED = 1;
+        unsigned long mask[4] = {};
+        if (node >= sizeof(mask) * 8) return;
+        mask[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+        if (syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0) != 0)
+            std::cerr << "mbind to NUMA node " << node << " failed, using first-touch placement" << std::endl;
+#endif
+    }
+
+    NumaArenaResource::NumaArenaResource(size_t bytes_per_node, std::pmr::memory_resource* upstream)
+        : m_arenas(std::make_unique<Arena[]>(node_count())),
+        m_nNodes(node_count()),
+        m_upstream(upstream)
+    {
+        for (unsigned node = 0; node < m_nNodes; ++node)
+        {
+            Arena& arena = m_arenas[node];
+            mi_arena_id_t arena_id {};
+
+            // 1 GiB huge pages are reserved directly on the node
+            const size_t huge_pages = (bytes_per_node + ONEGB - 1) / ONEGB;
+            if (mi_reserve_huge_os_pages_at_ex(huge_pages, (int)node, 100 * huge_pages, true /*exclusive*/, &arena_id) == 0)
+            {
+                arena.huge = true;
+            }
+            else if (mi_reserve_os_memory_ex(bytes_per_node, true /*commit*/, true /*allow large*/, true /*exclusive*/, &arena_id) == 0)
+            {
+                arena.huge = false;
+            }
+            else
+            {
+                std::cerr << "Could not reserve pool arena on NUMA node " << node << ", falling back to heap" << std::endl;
+                continue;
+            }
+
+            size_t size = 0;
+            arena.base = static_cast<std::byte*>(mi_arena_area(arena_id, &size));
+            arena.size = arena.base ? size : 0;
+            if (arena.base && !arena.huge)
+                bind_to_node(arena.base, arena.size, node);
+        }
+    }
+
+    bool NumaArenaResource::is_huge_page_backed(unsigned node) const noexcept
+    {
+        return node < m_nNodes && m_arenas[node].huge;
+    }
+
+    void* NumaArenaResource::allocate_on(unsigned node, size_t bytes, size_t alignment)
+    {
+        if (node < m_nNodes)
+        {
+            Arena& arena = m_arenas[node];
+            size_t used = arena.used.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                const uintptr_t start = (reinterpret_cast<uintptr_t>(arena.base) + used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+                const size_t end = start - reinterpret_cast<uintptr_t>(arena.base) + bytes;
+                if (!arena.base || end > arena.size) break;
+                if (arena.used.compare_exchange_weak(used, end, std::memory_order_relaxed))
+                    return reinterpret_cast<void*>(start);
+            }
+        }
+        return m_upstream->allocate(bytes, alignment);
+    }
+
+    void* NumaArenaResource::do_allocate(size_t bytes, size_t alignment)
+    {
+        return allocate_on(current_node(), bytes, alignment);
+    }
+
+    void NumaArenaResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        for (unsigned node = 0; node < m_nNodes; ++node)
+        {
+            const Arena& arena = m_arenas[node];
+            if (p >= arena.base && p < arena.base + arena.size)
+                return; // arena memory is never handed back
+        }
+        m_upstream->deallocate(p, bytes, alignment);
+    }
+}
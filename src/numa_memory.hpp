@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace numa
+{
+    // NUMA node of the CPU the calling thread first asked from. Cached per
+    // thread: threads are expected to stay on their node (pin them if not).
+    inline unsigned current_node() noexcept
+    {
+        thread_local const unsigned node = [] {
+            unsigned cpu = 0, node = 0;
+#if defined(__linux__)
+            if (getcpu(&cpu, &node) != 0) node = 0;
+#endif
+            return node;
+        }();
+        return node;
+    }
+
+    // number of NUMA nodes configured on the host (1 when unknown)
+    unsigned node_count();
+
+    // NUMA node of a CPU (0 when unknown)
+    unsigned node_of_cpu(unsigned cpu);
+
+    // the calling thread's new allocations prefer (not force) pages on node
+    void prefer_node(unsigned node);
+
+    /**
+    * Monotonic memory resource that carves allocations out of one exclusive
+    * mimalloc arena per NUMA node. Arenas are backed by 1 GiB huge pages
+    * reserved on the node when the OS has them, otherwise by large (2 MiB) OS
+    * pages bound to the node. Allocations land on the caller's node.
+    *
+    * Meant for long-lived blocks such as object pool storage: deallocating
+    * arena memory is a no-op, the arenas live until process exit. Requests
+    * that do not fit any more are served by the upstream resource.
+    */
+    class NumaArenaResource : public std::pmr::memory_resource
+    {
+    public:
+        explicit NumaArenaResource(size_t bytes_per_node,
+            std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+        NumaArenaResource(const NumaArenaResource&) = delete;
+        NumaArenaResource& operator=(const NumaArenaResource&) = delete;
+
+        void* allocate_on(unsigned node, size_t bytes, size_t alignment);
+
+        bool is_huge_page_backed(unsigned node) const noexcept;
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    private:
+        struct alignas(64) Arena
+        {
+            std::byte* base = nullptr;
+            size_t size = 0;
+            std::atomic<size_t> used { 0 };
+            bool huge = false;
+        };
+        std::unique_ptr<Arena[]> m_arenas;
+        unsigned m_nNodes;
+        std::pmr::memory_resource* m_upstream;
+    };
+
+    namespace detail
+    {
+        inline std::atomic<std::pmr::memory_resource*> g_poolResource { nullptr };
+    }
+
+    // memory resource used for object pool storage; the default pmr resource
+    // until the application installs a NUMA aware one
+    inline std::pmr::memory_resource* pool_resource() noexcept
+    {
+        auto* mr = detail::g_poolResource.load(std::memory_order_acquire);
+        return mr ? mr : std::pmr::get_default_resource();
+    }
+
+    inline void set_pool_resource(std::pmr::memory_resource* mr) noexcept
+    {
+        detail::g_poolResource.store(mr, std::memory_order_release);
+    }
+}
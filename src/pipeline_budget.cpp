@@ -0,0 +1,202 @@
+#include "headers.hpp"
+#include "pipeline_budget.hpp"
+
+#include <cmath>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+PipelineBudget::PipelineBudget(Options options)
+    : m_options(std::move(options))
+{
+    std::vector<unsigned> cpus = m_options.cpus.empty() ? CpuPlacement::usable_cpus() : m_options.cpus;
+
+    // one group per NUMA node when the CPUs span several, one per CPU otherwise
+    std::map<unsigned, std::vector<unsigned>> nodes;
+    for (unsigned cpu : cpus) nodes[numa::node_of_cpu(cpu)].push_back(cpu);
+    m_bNodeGroups = nodes.size() > 1;
+    if (m_bNodeGroups)
+        for (auto& [node, nodeCpus] : nodes) m_groups.push_back({ std::move(nodeCpus) });
+    else
+        for (unsigned cpu : cpus) m_groups.push_back({ { cpu } });
+
+    m_capacity = m_options.max_utilization * (double)cpus.size();
+}
+
+double PipelineBudget::cost(const Pipeline& pipeline) const noexcept
+{
+    const double base = pipeline.measured >= 0 ? pipeline.measured : pipeline.estimate;
+    return base * std::max(pipeline.proportion, 1.0);
+}
+
+bool PipelineBudget::fits(double cost) const noexcept
+{
+    return m_committed + cost <= m_capacity;
+}
+
+void PipelineBudget::place(Pipeline& pipeline)
+{
+    // relative load: a node with twice the CPUs takes twice the cores
+    auto relative = [this](size_t idx) { return m_groups[idx].load / (double)m_groups[idx].cpus.size(); };
+    std::vector<size_t> order(m_groups.size());
+    for (size_t idx = 0; idx < order.size(); ++idx) order[idx] = idx;
+
+    const size_t nGroups = m_bNodeGroups ? 1
+        : std::min(order.size(), (size_t)std::ceil(pipeline.estimate) + 1);
+    std::ranges::partial_sort(order, order.begin() + nGroups, [&](size_t a, size_t b) { return relative(a) < relative(b); });
+    pipeline.groups.assign(order.begin(), order.begin() + nGroups);
+    pipeline.charged = 0;
+    this->charge(pipeline);
+}
+
+void PipelineBudget::charge(Pipeline& pipeline)
+{
+    const double now = this->cost(pipeline);
+    const double delta = now - pipeline.charged;
+    for (size_t idx : pipeline.groups) m_groups[idx].load += delta / (double)pipeline.groups.size();
+    m_committed += delta;
+    pipeline.charged = now;
+}
+
+PipelineBudget::Admission PipelineBudget::admit(const std::string& id, double estimate)
+{
+    if (estimate <= 0) estimate = m_options.default_cost;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running.contains(id)) return Admission::Admitted;
+
+    // in order: a Start does not overtake the queued ones, and one larger than the host never fits
+    if (m_queue.empty() && this->fits(estimate))
+    {
+        Pipeline& pipeline = m_running.emplace(id, Pipeline { estimate }).first->second;
+        this->place(pipeline);
+        ++m_nAdmitted;
+        return Admission::Admitted;
+    }
+    if (estimate <= m_capacity && m_queue.size() < m_options.max_queued)
+    {
+        m_queue.emplace_back(id, estimate);
+        return Admission::Queued;
+    }
+    ++m_nRejected;
+    return Admission::Rejected;
+}
+
+std::vector<unsigned> PipelineBudget::placement(const std::string& id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<unsigned> cpus;
+    if (auto it = m_running.find(id); it != m_running.end())
+        for (size_t idx : it->second.groups)
+            cpus.insert(cpus.end(), m_groups[idx].cpus.begin(), m_groups[idx].cpus.end());
+    return cpus;
+}
+
+void PipelineBudget::report_cpu(const std::string& id, double cores)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_running.find(id);
+    if (it == m_running.end()) return;
+    Pipeline& pipeline = it->second;
+    pipeline.measured = pipeline.measured < 0 ? cores
+        : m_options.smoothing * cores + (1 - m_options.smoothing) * pipeline.measured;
+    this->charge(pipeline);
+}
+
+void PipelineBudget::report_qos(const std::string& id, double proportion)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_running.find(id);
+    if (it == m_running.end() || proportion <= 0) return;
+    it->second.proportion = proportion;
+    this->charge(it->second);
+}
+
+std::vector<std::string> PipelineBudget::release(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_running.find(id); it != m_running.end())
+    {
+        Pipeline& pipeline = it->second;
+        for (size_t idx : pipeline.groups) m_groups[idx].load -= pipeline.charged / (double)pipeline.groups.size();
+        m_committed -= pipeline.charged;
+        m_running.erase(it);
+    }
+    else std::erase_if(m_queue, [&id](const auto& queued) { return queued.first == id; });
+    return this->admit_queued_locked();
+}
+
+std::vector<std::string> PipelineBudget::admit_queued()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return this->admit_queued_locked();
+}
+
+std::vector<std::string> PipelineBudget::admit_queued_locked()
+{
+    std::vector<std::string> admitted;
+    while (!m_queue.empty() && this->fits(m_queue.front().second))
+    {
+        auto [id, estimate] = std::move(m_queue.front());
+        m_queue.pop_front();
+        Pipeline& pipeline = m_running.emplace(id, Pipeline { estimate }).first->second;
+        this->place(pipeline);
+        ++m_nAdmitted;
+        admitted.push_back(std::move(id));
+    }
+    return admitted;
+}
+
+PipelineBudget::Stats PipelineBudget::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return { m_capacity, m_committed, m_running.size(), m_queue.size(), m_nAdmitted, m_nRejected };
+}
+
+void ThreadCpuMeter::add_current_thread()
+{
+#if defined(__linux__)
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threads.push_back({ pthread_self(), clock });
+#endif
+}
+
+void ThreadCpuMeter::remove_current_thread()
+{
+#if defined(__linux__)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::ranges::find_if(m_threads, [](const Thread& t) { return pthread_equal(t.handle, pthread_self()); });
+    if (it == m_threads.end()) return;
+    // its clock dies with the thread: keep what it used
+    timespec ts;
+    if (clock_gettime(it->clock, &ts) == 0) m_nExitedNs += (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    m_threads.erase(it);
+#endif
+}
+
+uint64_t ThreadCpuMeter::cpu_ns_locked() const
+{
+    uint64_t nTotal = m_nExitedNs;
+#if defined(__linux__)
+    for (const Thread& thread : m_threads)
+    {
+        timespec ts;
+        if (clock_gettime(thread.clock, &ts) == 0) nTotal += (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    }
+#endif
+    return nTotal;
+}
+
+double ThreadCpuMeter::sample()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t nCpuNs = this->cpu_ns_locked(), nWallNs = metrics::now_ns();
+    const double cores = m_nLastWallNs && nWallNs > m_nLastWallNs
+        ? (double)(nCpuNs - m_nLastCpuNs) / (double)(nWallNs - m_nLastWallNs) : 0.0;
+    m_nLastCpuNs = nCpuNs;
+    m_nLastWallNs = nWallNs;
+    return cores;
+}
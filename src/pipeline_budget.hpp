@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/**
+* CPU budget admission and placement for media pipelines.
+*
+* Every running pipeline is charged a cost in cores: its estimate until it is
+* measured, then the smoothed CPU time of its streaming threads per wall
+* second, scaled by its QoS proportion while it reports running late (a
+* pipeline that gets 1 core and needs 1.5 reports a proportion of ~1.5).
+* A Start is admitted while the committed cost plus its own stays within
+* max_utilization of the pipeline CPUs; otherwise it waits in a FIFO of up
+* to max_queued Starts, and beyond that it is rejected. Queued Starts are
+* admitted in order as budget frees up (release(), admit_queued()).
+*
+* Each admitted pipeline is placed on the least loaded group of CPUs: a
+* NUMA node when the CPUs span several, otherwise ceil(estimate) + 1 of the
+* least loaded cores (one spare so the measurement can exceed the estimate).
+* The executor pins the pipeline's streaming threads to placement().
+*
+* Thread-safe: a mutex guards everything, none of it is on a request path.
+*/
+class PipelineBudget
+{
+public:
+    struct Options
+    {
+        std::vector<unsigned> cpus {};      // CPUs the pipelines run on, empty = CpuPlacement::usable_cpus()
+        double max_utilization = 0.85;      // share of those CPUs the pipelines may commit
+        double default_cost = 1.0;          // cores a pipeline is charged until measured
+        size_t max_queued = 16;             // Starts waiting for budget, 0 = reject when it is short
+        double smoothing = 0.3;             // weight of a new measurement in the running average
+    };
+
+    enum class Admission : uint8_t { Admitted, Queued, Rejected };
+
+    struct Stats
+    {
+        double capacity;                    // cores the pipelines may commit
+        double committed;                   // cores charged to the running pipelines
+        size_t running;
+        size_t queued;
+        uint64_t admitted;                  // totals since construction
+        uint64_t rejected;
+    };
+
+    explicit PipelineBudget(Options options);
+
+    PipelineBudget(const PipelineBudget&) = delete;
+    PipelineBudget& operator=(const PipelineBudget&) = delete;
+
+    // a Start expected to use estimate cores (0 = default_cost)
+    Admission admit(const std::string& id, double estimate = 0);
+    // the CPUs the pipeline's threads are pinned to; empty when it is not running
+    std::vector<unsigned> placement(const std::string& id) const;
+    // measured CPU use of the pipeline's threads, in cores
+    void report_cpu(const std::string& id, double cores);
+    // the QoS proportion its sinks report: > 1 when the pipeline runs late
+    void report_qos(const std::string& id, double proportion);
+    // frees the pipeline's budget, or drops its queued Start; returns the queued Starts admitted now
+    std::vector<std::string> release(const std::string& id);
+    // admits the queued Starts that fit now (costs change as they are measured), in order
+    std::vector<std::string> admit_queued();
+
+    Stats stats() const;
+
+private:
+    struct Group
+    {
+        std::vector<unsigned> cpus;
+        double load = 0;                    // cores charged to the group
+    };
+    struct Pipeline
+    {
+        double estimate;
+        double measured = -1;               // < 0 until the first report_cpu()
+        double proportion = 1;
+        double charged = 0;                 // cost() when the groups were last charged
+        std::vector<size_t> groups;
+    };
+
+    double cost(const Pipeline& pipeline) const noexcept;
+    bool fits(double cost) const noexcept;
+    void place(Pipeline& pipeline);
+    void charge(Pipeline& pipeline);       // moves the groups' load to the pipeline's current cost
+    std::vector<std::string> admit_queued_locked();
+
+    const Options m_options;
+    std::vector<Group> m_groups;
+    bool m_bNodeGroups = false;             // groups are NUMA nodes, not single CPUs
+    double m_capacity;
+    double m_committed = 0;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Pipeline> m_running;
+    std::deque<std::pair<std::string, double>> m_queue;    // id, estimate
+    uint64_t m_nAdmitted = 0;
+    uint64_t m_nRejected = 0;
+};
+
+/**
+* CPU time of a set of threads, e.g. a pipeline's streaming threads: each
+* thread adds itself when it starts and removes itself before it exits, and
+* sample() returns the cores they used since the previous sample.
+*/
+class ThreadCpuMeter
+{
+public:
+    // on the thread to measure
+    void add_current_thread();
+    void remove_current_thread();
+
+    // cores used since the previous call (0 on the first)
+    double sample();
+
+private:
+    uint64_t cpu_ns_locked() const;
+
+#if defined(__linux__)
+    struct Thread
+    {
+        pthread_t handle;
+        clockid_t clock;
+    };
+    std::vector<Thread> m_threads;
+#endif
+    mutable std::mutex m_mutex;
+    uint64_t m_nExitedNs = 0;               // CPU time of the threads that were removed
+    uint64_t m_nLastCpuNs = 0;
+    uint64_t m_nLastWallNs = 0;
+};
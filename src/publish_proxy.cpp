@@ -0,0 +1,71 @@
+#include "headers.hpp"
+
+PublishProxy::PublishProxy(zmq::context_t& ctx, const std::string& public_address)
+    : m_ctx(ctx),
+    m_inprocAddress(fmt::format("inproc://zmq-task-dispatcher-publish-{}", static_cast<const void*>(this))),
+    m_control(ctx, ZMQ_PAIR)
+{
+    TRACY_ZONE;
+
+    // the external side keeps the options of the single PUB socket, except
+    // that it drops on HWM: a slow subscriber must not stall the proxy
+    zmq::socket_t backend(ctx, ZMQ_XPUB);
+    backend.set(zmq::sockopt::sndbuf, 1024 * 1024);
+    backend.set(zmq::sockopt::sndhwm, 1000);
+    backend.set(zmq::sockopt::linger, 0);
+    backend.set(zmq::sockopt::immediate, 1);
+    backend.bind(public_address);
+
+    zmq::socket_t frontend(ctx, ZMQ_XSUB);
+    frontend.set(zmq::sockopt::linger, 0);
+    frontend.bind(m_inprocAddress);
+    // subscribe to everything: XSUB sends it to every publisher as it connects,
+    // which then passes all it sends (the XPUB backend filters per subscriber)
+    const char subscribeAll = 1;
+    frontend.send(zmq::const_buffer(&subscribeAll, 1), zmq::send_flags::none);
+
+    const std::string controlAddress = m_inprocAddress + "-control";
+    zmq::socket_t control(ctx, ZMQ_PAIR);
+    control.set(zmq::sockopt::linger, 0);
+    control.bind(controlAddress);
+    m_control.set(zmq::sockopt::linger, 0);
+    m_control.connect(controlAddress);
+
+    m_thread = std::thread([frontend = std::move(frontend), backend = std::move(backend), control = std::move(control)]() mutable {
+        TRACY_THREAD_NAME("publish proxy");
+        try
+        {
+            zmq::proxy_steerable(frontend, backend, zmq::socket_ref(), control);
+        }
+        catch (const zmq::error_t& e)
+        {
+            // ETERM when the context is shut down before the proxy
+            if (e.num() != ETERM) std::cerr << "Publish proxy error: " << e.what() << '\n';
+        }
+    });
+}
+
+PublishProxy::~PublishProxy()
+{
+    m_control.send(zmq::str_buffer("TERMINATE"), zmq::send_flags::none);
+    m_thread.join();
+}
+
+zmq::socket_t PublishProxy::connect_publisher() const
+{
+    zmq::socket_t publisher(m_ctx, ZMQ_XPUB);
+    publisher.set(zmq::sockopt::sndhwm, 1000);
+    publisher.set(zmq::sockopt::linger, 0);
+    publisher.connect(m_inprocAddress);
+    return publisher;
+}
+
+bool PublishProxy::wait_ready(zmq::socket_t& publisher, std::chrono::milliseconds timeout)
+{
+    zmq::pollitem_t item { publisher.handle(), 0, ZMQ_POLLIN, 0 };
+    if (zmq::poll(&item, 1, timeout) <= 0) return false;
+    // the subscription message(s); later ones only come for new topics
+    zmq::message_t subscription;
+    while (publisher.recv(subscription, zmq::recv_flags::dontwait)) { }
+    return true;
+}
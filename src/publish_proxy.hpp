@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <zmq.hpp>
+
+/**
+* Owner of the external PUB endpoint in the direct publishing mode: an XPUB
+* bound to the public address, fed by an XSUB bound to an inproc address. The
+* ingress thread and every worker connect their own PUB socket to it and
+* publish without handing messages to another thread; subscriptions flow back
+* through the proxy, so unsubscribed topics are still filtered at the source.
+* zmq::proxy_steerable runs on the proxy's own thread until destruction.
+*
+* The proxy subscribes to everything itself, and the publishers are XPUB
+* sockets: a publisher filters out all it sends until that subscription has
+* reached it (the slow joiner problem), and as an XPUB it receives the
+* subscription, so wait_ready() tells when nothing is lost any more.
+*/
+class PublishProxy
+{
+public:
+    PublishProxy(zmq::context_t& ctx, const std::string& public_address);
+    ~PublishProxy();
+
+    PublishProxy(const PublishProxy&) = delete;
+    PublishProxy& operator=(const PublishProxy&) = delete;
+
+    // a new publisher (XPUB) connected to the proxy; use it on one thread only, once ready
+    zmq::socket_t connect_publisher() const;
+    // whether the proxy's subscription reached publisher, waiting up to timeout for it
+    static bool wait_ready(zmq::socket_t& publisher, std::chrono::milliseconds timeout);
+
+private:
+    zmq::context_t& m_ctx;
+    const std::string m_inprocAddress;
+    zmq::socket_t m_control;    // PAIR to the proxy thread, sends TERMINATE
+    std::thread m_thread;
+};
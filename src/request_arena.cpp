@@ -0,0 +1,109 @@
+#include "headers.hpp"
+
+void worker_heap::attach()
+{
+    struct Owner
+    {
+        mi_heap_t* heap = nullptr;
+        mi_heap_t* previous = nullptr;
+        ~Owner()
+        {
+            if (!heap) return;
+            mi_heap_set_default(previous);
+            mi_heap_delete(heap);   // live blocks move to the thread's default heap
+        }
+    };
+    thread_local Owner owner;
+    if (owner.heap) return;
+    owner.heap = mi_heap_new();
+    if (owner.heap) owner.previous = mi_heap_set_default(owner.heap);
+}
+
+RequestArena::~RequestArena()
+{
+    for (Block* pBlock = m_pFirst; pBlock;)
+    {
+        Block* pNext = pBlock->next;
+        mi_free(pBlock);
+        pBlock = pNext;
+    }
+}
+
+void RequestArena::release() noexcept
+{
+    if (!m_pFirst) return;
+    if (m_nRetained > MAX_RETAINED)
+    {
+        for (Block* pBlock = m_pFirst->next; pBlock;)
+        {
+            Block* pNext = pBlock->next;
+            mi_free(pBlock);
+            pBlock = pNext;
+        }
+        m_pFirst->next = nullptr;
+        m_nRetained = m_pFirst->size;
+    }
+    m_pCurrent = m_pFirst;
+    m_pCursor = reinterpret_cast<char*>(m_pFirst) + HEADER_SIZE;
+    m_pEnd = reinterpret_cast<char*>(m_pFirst) + m_pFirst->size;
+}
+
+void RequestArena::advance(size_t bytes, size_t alignment)
+{
+    const size_t nNeeded = HEADER_SIZE + bytes + alignment;
+    // blocks kept from earlier requests come first
+    Block* pNext = m_pCurrent ? m_pCurrent->next : m_pFirst;
+    if (!pNext || pNext->size < nNeeded)
+    {
+        const size_t nSize = std::max({ nNeeded, FIRST_BLOCK_SIZE, m_pCurrent ? 2 * m_pCurrent->size : 0 });
+        // from the worker's heap; freed by whichever thread ends up releasing the arena
+        auto* pBlock = static_cast<Block*>(mi_heap_malloc_aligned(worker_heap::current(), nSize, alignof(std::max_align_t)));
+        if (!pBlock) throw std::bad_alloc();
+        pBlock->size = nSize;
+        pBlock->next = pNext;
+        if (m_pCurrent) m_pCurrent->next = pBlock;
+        else m_pFirst = pBlock;
+        m_nRetained += nSize;
+        pNext = pBlock;
+    }
+    m_pCurrent = pNext;
+    m_pCursor = reinterpret_cast<char*>(pNext) + HEADER_SIZE;
+    m_pEnd = reinterpret_cast<char*>(pNext) + pNext->size;
+}
+
+void* RequestArena::do_allocate(size_t bytes, size_t alignment)
+{
+    auto align_up = [alignment](char* p) {
+        return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    };
+    char* p = m_pCursor ? align_up(m_pCursor) : nullptr;
+    if (!p || p + bytes > m_pEnd)
+    {
+        this->advance(bytes, alignment);
+        p = align_up(m_pCursor);
+    }
+    m_pCursor = p + bytes;
+    return p;
+}
+
+namespace
+{
+    // a few arenas per thread: enough for the coroutines that finish on it
+    constexpr size_t MAX_CACHED_ARENAS = 8;
+    thread_local std::vector<std::unique_ptr<RequestArena>> t_arenas;
+}
+
+RequestArena::Lease RequestArena::acquire()
+{
+    if (t_arenas.empty()) return Lease(std::make_unique<RequestArena>());
+    std::unique_ptr<RequestArena> pArena = std::move(t_arenas.back());
+    t_arenas.pop_back();
+    return Lease(std::move(pArena));
+}
+
+RequestArena::Lease::~Lease()
+{
+    if (!m_pArena) return;
+    m_pArena->release();
+    if (t_arenas.size() < MAX_CACHED_ARENAS) t_arenas.push_back(std::move(m_pArena));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mimalloc.h>
+
+/**
+* Per-worker mimalloc heaps and request-scoped arenas.
+*
+* Every pool worker owns an mi_heap (worker_heap::attach() when it starts)
+* and makes it the thread's default heap, so what a worker allocates (task
+* state, handler scratch, strings) comes from its own heap instead of
+* contending with the other workers; blocks freed by other threads find their
+* way back through mimalloc's thread-free lists.
+*
+* RequestArena is a bump allocator for what lives as long as one request.
+* handleMethod gets it through params.memory() and builds its Result in
+* allocator-aware containers (std::pmr::vector, std::pmr::string) on it:
+* deallocation is a no-op, and release() rewinds the whole request at once
+* when it completes. The arena's blocks come from the worker's heap and are
+* kept for the next request, so a steady request mix allocates nothing.
+*/
+namespace worker_heap
+{
+    // gives the calling thread its own heap as default heap; deleted (its live blocks migrated) at thread exit
+    void attach();
+    // the calling thread's default heap
+    inline mi_heap_t* current() noexcept { return mi_heap_get_default(); }
+}
+
+class RequestArena final : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t FIRST_BLOCK_SIZE = 16 * 1024;
+    static constexpr size_t MAX_RETAINED = 1024 * 1024;    // release() frees the blocks beyond
+
+    RequestArena() = default;
+    ~RequestArena();
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    // rewinds to the first block; O(1) unless the request grew the arena past MAX_RETAINED
+    void release() noexcept;
+
+    // an arena from the calling thread's cache for one request; the lease releases it
+    // and returns it to the cache of the thread it ends on (a coroutine may move)
+    class Lease
+    {
+    public:
+        explicit Lease(std::unique_ptr<RequestArena> pArena) noexcept : m_pArena(std::move(pArena)) { }
+        Lease(Lease&&) noexcept = default;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        RequestArena* get() const noexcept { return m_pArena.get(); }
+
+    private:
+        std::unique_ptr<RequestArena> m_pArena;
+    };
+    static Lease acquire();
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override { }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    struct Block
+    {
+        Block* next;
+        size_t size;            // including this header
+    };
+    static constexpr size_t HEADER_SIZE = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    // the next block that holds bytes at alignment, allocated when the kept ones are too small
+    void advance(size_t bytes, size_t alignment);
+
+    Block* m_pFirst = nullptr;
+    Block* m_pCurrent = nullptr;
+    char* m_pCursor = nullptr;
+    char* m_pEnd = nullptr;
+    size_t m_nRetained = 0;     // bytes in all blocks
+};
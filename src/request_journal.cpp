@@ -0,0 +1,194 @@
+#include "headers.hpp"
+#include "request_journal.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <system_error>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint64_t MAX_CAPACITY = uint64_t(UINT32_MAX) * 8;   // IndexEntry::offset8
+
+    [[noreturn]] void throw_errno(const std::string& what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    journal::Header* header_of(char* pBase) noexcept { return reinterpret_cast<journal::Header*>(pBase); }
+
+    journal::IndexEntry* index_entry(char* pBase, uint64_t capacity, uint64_t idx) noexcept
+    {
+        return reinterpret_cast<journal::IndexEntry*>(pBase + capacity - (idx + 1) * sizeof(journal::IndexEntry));
+    }
+}
+
+#if defined(__unix__)
+
+RequestJournal::RequestJournal(const std::string& path, size_t capacity)
+    : m_path(path)
+{
+    const size_t nPage = (size_t)sysconf(_SC_PAGESIZE);
+    m_nCapacity = std::min<uint64_t>(capacity, MAX_CAPACITY) / nPage * nPage;
+    if (m_nCapacity < nPage * 2)
+        throw std::invalid_argument("journal capacity too small: " + path);
+
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) throw_errno("open " + path);
+    // allocate the blocks now: a full disk fails here instead of as SIGBUS on a later append
+    if (int err = posix_fallocate(m_fd, 0, (off_t)m_nCapacity); err != 0)
+    {
+        ::close(m_fd);
+        errno = err;
+        throw_errno("posix_fallocate " + path);
+    }
+    void* pMap = ::mmap(nullptr, m_nCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        ::close(m_fd);
+        throw_errno("mmap " + path);
+    }
+    m_pBase = static_cast<char*>(pMap);
+
+    journal::Header* pHeader = header_of(m_pBase);
+    pHeader->magic = journal::Header::MAGIC;
+    pHeader->version = journal::Header::VERSION;
+    pHeader->header_size = sizeof(journal::Header);
+    pHeader->capacity = m_nCapacity;
+    pHeader->count = 0;
+    pHeader->data_end = m_nDataEnd;
+}
+
+RequestJournal::~RequestJournal()
+{
+    sync();
+    ::munmap(m_pBase, m_nCapacity);
+    ::close(m_fd);
+    std::cout << "Request journal " << m_path << ": " << m_nCount << " frames captured, " << m_nDropped << " dropped" << std::endl;
+}
+
+bool RequestJournal::append(journal::Channel channel, const void* pData, size_t size, uint64_t received_at) noexcept
+{
+    const uint64_t nAligned = (size + 7) & ~uint64_t(7);
+    const uint64_t nIndexStart = m_nCapacity - (m_nCount + 1) * sizeof(journal::IndexEntry);
+    if (!m_bFull && (size >= journal::IndexEntry::JSON_BIT || m_nDataEnd + nAligned > nIndexStart))
+    {
+        // a smaller frame would still fit, but a replay must not skip the ones in between
+        m_bFull = true;
+        std::cerr << "Request journal " << m_path << " is full after " << m_nCount << " frames, capture stopped" << std::endl;
+    }
+    if (m_bFull)
+    {
+        ++m_nDropped;
+        return false;
+    }
+
+    std::memcpy(m_pBase + m_nDataEnd, pData, size);
+    *index_entry(m_pBase, m_nCapacity, m_nCount) = {
+        received_at,
+        (uint32_t)(m_nDataEnd / 8),
+        (uint32_t)size | (channel == journal::Channel::Json ? journal::IndexEntry::JSON_BIT : 0u),
+    };
+    m_nDataEnd += nAligned;
+    ++m_nCount;
+
+    // the record is complete before it is counted
+    journal::Header* pHeader = header_of(m_pBase);
+    pHeader->data_end = m_nDataEnd;
+    std::atomic_ref<uint64_t>(pHeader->count).store(m_nCount, std::memory_order_release);
+
+    if ((m_nDataEnd - m_nSyncedEnd) + (m_nCount - m_nSyncedCount) * sizeof(journal::IndexEntry) >= SYNC_BYTES)
+        sync();
+    return true;
+}
+
+void RequestJournal::sync() noexcept
+{
+    if (m_nCount == m_nSyncedCount) return;
+    TRACY_ZONE;
+    static const uintptr_t nPageMask = ~(uintptr_t(sysconf(_SC_PAGESIZE)) - 1);
+    auto sync_range = [](const char* pBegin, const char* pEnd) {
+        char* pPage = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(pBegin) & nPageMask);
+        ::msync(pPage, pEnd - pPage, MS_ASYNC);
+    };
+    sync_range(m_pBase, m_pBase + sizeof(journal::Header));
+    sync_range(m_pBase + m_nSyncedEnd, m_pBase + m_nDataEnd);
+    sync_range(reinterpret_cast<const char*>(index_entry(m_pBase, m_nCapacity, m_nCount - 1)),
+        reinterpret_cast<const char*>(index_entry(m_pBase, m_nCapacity, m_nSyncedCount)) + sizeof(journal::IndexEntry));
+    m_nSyncedEnd = m_nDataEnd;
+    m_nSyncedCount = m_nCount;
+}
+
+JournalReader::JournalReader(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw_errno("open " + path);
+    struct stat st {};
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw_errno("stat " + path);
+    }
+    m_nMapped = (size_t)st.st_size;
+    void* pMap = m_nMapped >= sizeof(journal::Header) ? ::mmap(nullptr, m_nMapped, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (pMap == MAP_FAILED)
+        throw std::runtime_error("not a request journal: " + path);
+    m_pBase = static_cast<const char*>(pMap);
+    ::madvise(pMap, m_nMapped, MADV_SEQUENTIAL);
+
+    journal::Header header;
+    std::memcpy(&header, m_pBase, sizeof(header));
+    if (header.magic != journal::Header::MAGIC || header.version != journal::Header::VERSION
+        || header.capacity != m_nMapped || header.data_end > header.capacity
+        || header.count > (header.capacity - header.data_end) / sizeof(journal::IndexEntry))
+    {
+        ::munmap(pMap, m_nMapped);
+        throw std::runtime_error("not a request journal (or a different version): " + path);
+    }
+    m_nCapacity = header.capacity;
+    m_nCount = header.count;
+}
+
+JournalReader::~JournalReader()
+{
+    ::munmap(const_cast<char*>(m_pBase), m_nMapped);
+}
+
+#else
+
+RequestJournal::RequestJournal(const std::string& path, size_t)
+    : m_path(path)
+{
+    throw std::runtime_error("request journals need mmap: " + path);
+}
+
+RequestJournal::~RequestJournal() { }
+
+bool RequestJournal::append(journal::Channel, const void*, size_t, uint64_t) noexcept { return false; }
+
+void RequestJournal::sync() noexcept { }
+
+JournalReader::JournalReader(const std::string& path)
+{
+    throw std::runtime_error("request journals need mmap: " + path);
+}
+
+JournalReader::~JournalReader() { }
+
+#endif
+
+journal::Record JournalReader::operator[](size_t idx) const noexcept
+{
+    journal::IndexEntry entry;
+    std::memcpy(&entry, index_entry(const_cast<char*>(m_pBase), m_nCapacity, idx), sizeof(entry));
+    if (entry.offset() + entry.size() > m_nCapacity)
+        return { entry.received_at, entry.channel(), {} };
+    return { entry.received_at, entry.channel(), { m_pBase + entry.offset(), entry.size() } };
+}
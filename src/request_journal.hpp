@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+* Append-only, memory-mapped capture of the raw request frames, for replaying
+* production load shapes (zmq-journal-replay). The file is sized up front and
+* mapped shared; appending is a memcpy into the mapping, with no syscall per
+* frame. Dirty pages are handed to msync(MS_ASYNC) in batches of SYNC_BYTES,
+* so the kernel writes them back steadily instead of all at close. A crash of
+* the process loses nothing that was appended: the pages belong to the file.
+*
+* Layout: a 64 byte Header, then the frames, 8 byte aligned, growing up from
+* the header, and the compact index, 16 bytes per frame, growing down from the
+* end of the file. The journal is full when the two meet, and stays full:
+* every later frame is counted as dropped, even one that would still fit, so
+* the capture is a gapless prefix of the traffic. Header::count is published
+* last, so a reader of a live or crashed journal only sees complete records.
+*/
+namespace journal
+{
+    enum class Channel : uint8_t
+    {
+        Binary, // ParamsBase + payload, from the binary SUB socket
+        Json,   // JSON-RPC text, from the JSON SUB socket
+    };
+
+    struct Header
+    {
+        static constexpr uint64_t MAGIC = 0x314C4E5244545A5AULL; // "ZZTDRNL1"
+        static constexpr uint32_t VERSION = 1;
+
+        uint64_t magic;
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t capacity;      // file size
+        uint64_t count;         // published records
+        uint64_t data_end;      // end of the last frame
+        uint64_t reserved[3];
+    };
+    static_assert(sizeof(Header) == 64);
+
+    // index entries are stored from the end of the file: entry i at capacity - (i + 1) * sizeof(IndexEntry)
+    struct IndexEntry
+    {
+        static constexpr uint32_t JSON_BIT = 0x80000000u;
+
+        uint64_t received_at;   // metrics::now_ns() at receive
+        uint32_t offset8;       // frame offset in 8 byte units
+        uint32_t size_channel;  // frame size, JSON_BIT for Channel::Json
+
+        uint64_t offset() const noexcept { return uint64_t(offset8) * 8; }
+        uint32_t size() const noexcept { return size_channel & ~JSON_BIT; }
+        Channel channel() const noexcept { return (size_channel & JSON_BIT) ? Channel::Json : Channel::Binary; }
+    };
+    static_assert(sizeof(IndexEntry) == 16);
+
+    struct Record
+    {
+        uint64_t received_at;
+        Channel channel;
+        std::string_view frame;
+    };
+}
+
+// the capture side; used by the ingress thread only
+class RequestJournal
+{
+public:
+    static constexpr size_t SYNC_BYTES = 4 * 1024 * 1024;
+
+    // creates (or truncates) path and reserves capacity bytes on disk; throws std::system_error
+    RequestJournal(const std::string& path, size_t capacity);
+    ~RequestJournal();
+
+    RequestJournal(const RequestJournal&) = delete;
+    RequestJournal& operator=(const RequestJournal&) = delete;
+
+    // copies the frame in; false (and counted as dropped) once a frame did not fit
+    bool append(journal::Channel channel, const void* pData, size_t size, uint64_t received_at) noexcept;
+
+    // starts write-back of everything appended since the last sync
+    void sync() noexcept;
+
+    uint64_t count() const noexcept { return m_nCount; }
+    uint64_t dropped() const noexcept { return m_nDropped; }
+    bool full() const noexcept { return m_bFull; }
+
+private:
+    std::string m_path;
+    char* m_pBase = nullptr;
+    size_t m_nCapacity = 0;
+    int m_fd = -1;
+    uint64_t m_nCount = 0;
+    uint64_t m_nDataEnd = sizeof(journal::Header);
+    uint64_t m_nSyncedEnd = sizeof(journal::Header);   // frames below this were handed to msync
+    uint64_t m_nSyncedCount = 0;                        // index entries up to this as well
+    uint64_t m_nDropped = 0;
+    bool m_bFull = false;                               // sticky: set by the first frame that did not fit
+};
+
+// the replay side: a read-only mapping of a journal
+class JournalReader
+{
+public:
+    // throws std::system_error when it cannot be opened, std::runtime_error when it is no journal
+    explicit JournalReader(const std::string& path);
+    ~JournalReader();
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    size_t size() const noexcept { return m_nCount; }
+    journal::Record operator[](size_t idx) const noexcept;
+
+private:
+    const char* m_pBase = nullptr;
+    size_t m_nMapped = 0;
+    size_t m_nCount = 0;
+    uint64_t m_nCapacity = 0;
+};
@@ -0,0 +1,54 @@
+#include "headers.hpp"
+#include "response_cache.hpp"
+
+ResponseCache& ResponseCache::instance()
+{
+    static ResponseCache* pInstance = new ResponseCache();
+    return *pInstance;
+}
+
+bool ResponseCache::append_to(TMethodID method_id, uint64_t key, uint64_t now_ns, SlabBuffer& out)
+{
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex);
+    auto it = m_entries.find(slot(method_id, key));
+    if (it == m_entries.end()) return false;
+    if (it->second.expires_at <= now_ns)
+    {
+        m_entries.erase(it);
+        return false;
+    }
+    out.append(it->second.result);
+    return true;
+}
+
+void ResponseCache::store(TMethodID method_id, uint64_t key, uint64_t epoch, std::string_view result, uint64_t expires_at_ns)
+{
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex);
+    // checked under the lock: invalidate() bumps the epoch before it erases
+    if (this->epoch(method_id) != epoch) return;
+    Entry& entry = m_entries[slot(method_id, key)];
+    entry.result.assign(result);
+    entry.expires_at = expires_at_ns;
+}
+
+void ResponseCache::invalidate(TMethodID method_id)
+{
+    if (method_id >= NUM_METHODS) return;
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex);
+    m_epochs[method_id].fetch_add(1, std::memory_order_acq_rel);
+    std::erase_if(m_entries, [method_id](const auto& item) { return (item.first >> 56) == method_id; });
+}
+
+void ResponseCache::invalidate(TMethodID method_id, uint64_t key)
+{
+    if (method_id >= NUM_METHODS) return;
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex);
+    m_epochs[method_id].fetch_add(1, std::memory_order_acq_rel);
+    m_entries.erase(slot(method_id, key));
+}
+
+size_t ResponseCache::size()
+{
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(m_mutex);
+    return m_entries.size();
+}
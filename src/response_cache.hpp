@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "methods.hpp"
+#include "slab_allocator.hpp"
+#include "tracer.hpp"
+
+/**
+* Serialized results of the Cacheable<MID> methods, keyed by method and
+* Cacheable<MID>::key(payload). The ingress thread answers a fresh entry
+* itself; workers store what they computed and invalidate what they changed.
+*
+* Each method has an epoch that every invalidation bumps. A request reads it
+* when dispatched, and its result is only stored if the epoch is unchanged,
+* so a result computed before a state change never outlives the change.
+*/
+class ResponseCache
+{
+public:
+    static ResponseCache& instance();
+
+    uint64_t epoch(TMethodID method_id) const noexcept
+    {
+        return method_id < NUM_METHODS ? m_epochs[method_id].load(std::memory_order_acquire) : 0;
+    }
+
+    // appends the cached result JSON of (method_id, key) to out; false when missing or expired
+    bool append_to(TMethodID method_id, uint64_t key, uint64_t now_ns, SlabBuffer& out);
+
+    // stores the result JSON of a request dispatched at epoch, unless method_id was invalidated since
+    void store(TMethodID method_id, uint64_t key, uint64_t epoch, std::string_view result, uint64_t expires_at_ns);
+
+    // drops the method's entries (or the one for key) and fails stores still in flight
+    void invalidate(TMethodID method_id);
+    void invalidate(TMethodID method_id, uint64_t key);
+
+    size_t size();
+
+private:
+    static constexpr size_t NUM_METHODS = (size_t)MethodID::Unknown;
+
+    // method id in the top byte: keys are pipeline ids and the like
+    static uint64_t slot(TMethodID method_id, uint64_t key) noexcept { return (uint64_t(method_id) << 56) | (key & ((uint64_t(1) << 56) - 1)); }
+
+    struct Entry
+    {
+        std::string result;
+        uint64_t expires_at;
+    };
+
+    std::atomic<uint64_t> m_epochs[NUM_METHODS] {};
+    TRACY_LOCKABLE(std::mutex, m_mutex, "response cache");
+    std::unordered_map<uint64_t, Entry> m_entries;
+};
@@ -0,0 +1,81 @@
+#include "headers.hpp"
+#include "response_writer.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_ESCAPE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define JSON_ESCAPE_NEON
+#endif
+
+static inline bool needs_escape(unsigned char c) noexcept
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// length of the prefix of [p, end) that can be copied verbatim
+static size_t clean_prefix(const char* p, const char* end) noexcept
+{
+    const char* const begin = p;
+#if defined(JSON_ESCAPE_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i maxCtrl = _mm_set1_epi8(0x1f);
+    for (; end - p >= 16; p += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // c < 0x20 as unsigned: min(c, 0x1f) == c
+        const __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(chunk, maxCtrl), chunk);
+        const __m128i hits = _mm_or_si128(ctrl, _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        if (const int mask = _mm_movemask_epi8(hits))
+            return (size_t)(p - begin) + std::countr_zero((unsigned)mask);
+    }
+#elif defined(JSON_ESCAPE_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    for (; end - p >= 16; p += 16)
+    {
+        const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        const uint8x16_t hits = vorrq_u8(vcltq_u8(chunk, space), vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)));
+        if (vmaxvq_u8(hits))
+            break; // locate it with the scalar loop below
+    }
+#endif
+    for (; p < end; ++p)
+        if (needs_escape((unsigned char)*p)) break;
+    return (size_t)(p - begin);
+}
+
+void JsonWriter::append_escaped(SlabBuffer& out, std::string_view s)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+    const char* p = s.data();
+    const char* const end = p + s.size();
+    while (p < end)
+    {
+        const size_t n = clean_prefix(p, end);
+        out.append({ p, n });
+        p += n;
+        if (p == end) break;
+
+        const unsigned char c = (unsigned char)*p++;
+        switch (c)
+        {
+            case '"':  out.append(R"(\")"); break;
+            case '\\': out.append(R"(\\)"); break;
+            case '\n': out.append(R"(\n)"); break;
+            case '\r': out.append(R"(\r)"); break;
+            case '\t': out.append(R"(\t)"); break;
+            case '\b': out.append(R"(\b)"); break;
+            case '\f': out.append(R"(\f)"); break;
+            default:
+            {
+                const char esc[6] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf] };
+                out.append({ esc, sizeof(esc) });
+                break;
+            }
+        }
+    }
+}
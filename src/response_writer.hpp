@@ -0,0 +1,253 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "methods.hpp"
+#include "slab_allocator.hpp"
+
+/**
+* Minimal JSON writer on top of a SlabBuffer. Constant parts are appended as
+* precomputed literals, integers are converted two digits at a time, and
+* strings are escaped with a SIMD scan that copies clean runs in bulk.
+* The writer does not track structure: callers emit keys, commas and braces.
+*/
+class JsonWriter
+{
+public:
+    static constexpr size_t MAX_U64_DIGITS = 20;
+
+    explicit JsonWriter(SlabBuffer& out) noexcept : m_out(out) { }
+
+    SlabBuffer& buffer() noexcept { return m_out; }
+
+    // pre-formatted JSON text (literals, keys with their quotes and colon)
+    void raw(std::string_view text) { m_out.append(text); }
+    void raw(char c) { m_out.push_back(c); }
+
+    void u64(uint64_t v)
+    {
+        char* p = tail(MAX_U64_DIGITS);
+        commit(write_u64(p, v));
+    }
+
+    void i64(int64_t v)
+    {
+        char* p = tail(MAX_U64_DIGITS + 1);
+        if (v < 0)
+        {
+            *p++ = '-';
+            commit(write_u64(p, 0 - (uint64_t)v));
+        }
+        else commit(write_u64(p, (uint64_t)v));
+    }
+
+    // quoted and escaped
+    void string(std::string_view s)
+    {
+        m_out.push_back('"');
+        append_escaped(m_out, s);
+        m_out.push_back('"');
+    }
+
+    // writes the decimal digits of v at p, returns the end
+    static char* write_u64(char* p, uint64_t v) noexcept
+    {
+        const unsigned n = digits10(v);
+        char* end = p + n;
+        char* q = end;
+        while (v >= 100)
+        {
+            q -= 2;
+            std::memcpy(q, &DIGIT_PAIRS[(v % 100) * 2], 2);
+            v /= 100;
+        }
+        if (v >= 10)
+        {
+            q -= 2;
+            std::memcpy(q, &DIGIT_PAIRS[v * 2], 2);
+        }
+        else *--q = char('0' + v);
+        return end;
+    }
+
+    static constexpr unsigned digits10(uint64_t v) noexcept
+    {
+        // log10 estimate from the bit width (1233 / 4096 ~ log10(2)), corrected once
+        const unsigned t = (unsigned)(std::bit_width(v | 1) * 1233) >> 12;
+        return t + ((v | 1) >= POW10[t]);
+    }
+
+    // appends s escaped for use inside a JSON string
+    static void append_escaped(SlabBuffer& out, std::string_view s);
+
+private:
+    char* tail(size_t max_len)
+    {
+        m_out.reserve(m_out.size() + max_len);
+        return m_out.data() + m_out.size();
+    }
+    void commit(char* end) noexcept { m_out.resize(end - m_out.data()); }
+
+    static constexpr uint64_t POW10[20] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+        100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+        10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+        100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull };
+
+    static constexpr char DIGIT_PAIRS[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    SlabBuffer& m_out;
+};
+
+/**
+* JSON-RPC 2.0 response frames. Results are typed per method: Result<MID>
+* serializes itself through write_json(JsonWriter&), results without fields
+* are written as null, so every method's serializer is resolved at compile
+* time.
+*/
+namespace jsonrpc
+{
+    inline constexpr std::string_view ACK_PREFIX = R"({"jsonrpc":"2.0","ack":1,"id":)";
+    inline constexpr std::string_view BATCH_ACK_PREFIX = R"({"jsonrpc":"2.0","ack":)";
+    inline constexpr std::string_view ID_KEY = R"(,"id":)";
+    inline constexpr std::string_view RESPONSE_PREFIX = R"({"jsonrpc":"2.0","id":)";
+    inline constexpr std::string_view RESULT_KEY = R"(,"result":)";
+    inline constexpr std::string_view ERROR_CODE_KEY = R"(,"error":{"code":)";
+    inline constexpr std::string_view ERROR_MESSAGE_KEY = R"(,"message":)";
+    inline constexpr std::string_view NOTIFICATION_PREFIX = R"({"jsonrpc":"2.0","method":)";
+    inline constexpr std::string_view PARAMS_KEY = R"(,"params":)";
+    inline constexpr std::string_view TIMING_KEY = R"(,"timing":{"received":)";
+
+    // standard error codes
+    inline constexpr int PARSE_ERROR = -32700;
+    inline constexpr int INVALID_REQUEST = -32600;
+    inline constexpr int METHOD_NOT_FOUND = -32601;
+    inline constexpr int INVALID_PARAMS = -32602;
+    inline constexpr int INTERNAL_ERROR = -32603;
+    // implementation defined server errors (-32000 to -32099)
+    inline constexpr int SERVER_BUSY = -32000;
+    inline constexpr int NO_INSTANCE = -32001;    // Broker: no instance to run the request on
+    inline constexpr int OVER_BUDGET = -32002;    // a pipeline Start that does not fit the CPU budget
+    inline constexpr int NO_PIPELINE = -32003;    // a pipeline command for an id that is not running
+
+    // {"jsonrpc":"2.0","ack":1,"id":N}
+    inline void write_ack(SlabBuffer& out, TReqID req_id)
+    {
+        constexpr size_t MAX_LEN = ACK_PREFIX.size() + JsonWriter::MAX_U64_DIGITS + 1;
+        out.reserve(out.size() + MAX_LEN);
+        char* p = out.data() + out.size();
+        std::memcpy(p, ACK_PREFIX.data(), ACK_PREFIX.size());
+        p = JsonWriter::write_u64(p + ACK_PREFIX.size(), req_id);
+        *p++ = '}';
+        out.resize(p - out.data());
+    }
+
+    // {"jsonrpc":"2.0","ack":COUNT,"id":N}: one ack for the COUNT requests of batch N
+    inline void write_batch_ack(SlabBuffer& out, TReqID batch_id, size_t count)
+    {
+        JsonWriter w(out);
+        w.raw(BATCH_ACK_PREFIX);
+        w.u64(count);
+        w.raw(ID_KEY);
+        w.u64(batch_id);
+        w.raw('}');
+    }
+
+    // {"jsonrpc":"2.0","id":N,"error":{"code":C,"message":"..."}}
+    inline void write_error(SlabBuffer& out, TReqID req_id, int code, std::string_view message)
+    {
+        JsonWriter w(out);
+        w.raw(RESPONSE_PREFIX);
+        w.u64(req_id);
+        w.raw(ERROR_CODE_KEY);
+        w.i64(code);
+        w.raw(ERROR_MESSAGE_KEY);
+        w.string(message);
+        w.raw("}}");
+    }
+
+    // {"jsonrpc":"2.0","id":null,"error":{...}}: the request id could not be read
+    inline void write_error(SlabBuffer& out, std::nullptr_t, int code, std::string_view message)
+    {
+        JsonWriter w(out);
+        w.raw(RESPONSE_PREFIX);
+        w.raw("null");
+        w.raw(ERROR_CODE_KEY);
+        w.i64(code);
+        w.raw(ERROR_MESSAGE_KEY);
+        w.string(message);
+        w.raw("}}");
+    }
+
+    // {"jsonrpc":"2.0","id":N,"result": -- the caller writes the value and the closing brace
+    inline void write_result_prefix(SlabBuffer& out, TReqID req_id)
+    {
+        JsonWriter w(out);
+        w.raw(RESPONSE_PREFIX);
+        w.u64(req_id);
+        w.raw(RESULT_KEY);
+    }
+
+    // the stages of a request that asked for them (METHOD_FLAG_TIMING), in
+    // metrics::now_ns() of the server: only their differences mean something
+    struct RequestTiming
+    {
+        uint64_t received;      // ingress thread read the request
+        uint64_t dispatched;    // handed to the pool
+        uint64_t started;       // a worker started the handler
+        uint64_t finished;      // the handler returned (a coroutine handler: completed)
+    };
+    // "published" is written when the frame is sent, into a field of this many spaces
+    inline constexpr size_t PUBLISHED_WIDTH = JsonWriter::MAX_U64_DIGITS;
+
+    // ,"timing":{"received":R,"dispatched":D,"started":S,"finished":F,"published":<blank>};
+    // returns the offset of the blank field for set_published()
+    inline size_t write_timing(SlabBuffer& out, const RequestTiming& timing)
+    {
+        JsonWriter w(out);
+        w.raw(TIMING_KEY);
+        w.u64(timing.received);
+        w.raw(R"(,"dispatched":)");
+        w.u64(timing.dispatched);
+        w.raw(R"(,"started":)");
+        w.u64(timing.started);
+        w.raw(R"(,"finished":)");
+        w.u64(timing.finished);
+        w.raw(R"(,"published":)");
+        const size_t offset = out.size();
+        out.resize(offset + PUBLISHED_WIDTH);
+        std::memset(out.data() + offset, ' ', PUBLISHED_WIDTH);
+        w.raw('}');
+        return offset;
+    }
+
+    // fills in the publish time, right aligned: the blanks before it are JSON whitespace
+    inline void set_published(char* field, uint64_t published) noexcept
+    {
+        char digits[JsonWriter::MAX_U64_DIGITS];
+        const size_t len = JsonWriter::write_u64(digits, published) - digits;
+        std::memcpy(field + PUBLISHED_WIDTH - len, digits, len);
+    }
+
+    // {"jsonrpc":"2.0","id":N,"result":<Result<MID>>}, with the stage timestamps
+    // when pTiming is given; returns the offset of their "published" field, 0 without
+    template<MethodID MID>
+    size_t write_result(SlabBuffer& out, TReqID req_id, const Result<MID>& result, const RequestTiming* pTiming = nullptr)
+    {
+        write_result_prefix(out, req_id);
+        JsonWriter w(out);
+        if constexpr (requires { result.write_json(w); })
+            result.write_json(w);
+        else
+            w.raw("null");
+        const size_t published_offset = pTiming ? write_timing(out, *pTiming) : 0;
+        w.raw('}');
+        return published_offset;
+    }
+}
@@ -0,0 +1,86 @@
+#include "headers.hpp"
+
+RetransmitBuffer::RetransmitBuffer(Options options, size_t shards)
+    : m_options(std::move(options)),
+    m_nShards(std::max<size_t>(shards, 1)),
+    m_nShardResults(m_options.max_bytes && m_options.max_results ? (m_options.max_results + m_nShards - 1) / m_nShards : 0),
+    m_nShardBytes((m_options.max_bytes + m_nShards - 1) / m_nShards),
+    m_pShards(std::make_unique<Shard[]>(m_nShards))
+{
+    if (!this->enabled()) return;
+    for (size_t idx = 0; idx < m_nShards; ++idx)
+    {
+        m_pShards[idx].ring.resize(m_nShardResults);
+        m_pShards[idx].index.reserve(m_nShardResults);
+    }
+}
+
+void RetransmitBuffer::store(size_t shard, TReqID req_id, zmq::message_t& frame)
+{
+    const size_t nSize = frame.size();
+    if (!this->enabled() || nSize > m_nShardBytes) return;
+
+    TRACY_ZONE_NAMED("retransmit.store");
+    Shard& s = m_pShards[shard];
+    std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(s.mutex);
+    while (s.tail - s.head == s.ring.size() || s.bytes + nSize > m_nShardBytes)
+        s.evict_oldest_locked();
+
+    Entry& entry = s.ring[s.tail % s.ring.size()];
+    entry.req_id = req_id;
+    entry.stored_at = metrics::now_ns();
+    entry.frame.copy(frame);
+    // a request run twice (a retransmitted request) answers with its latest result
+    s.index[req_id] = s.tail++;
+    s.bytes += nSize;
+}
+
+bool RetransmitBuffer::fetch(TReqID req_id, zmq::message_t& out)
+{
+    // a retransmitted request may have run on several workers: the latest frame wins
+    uint64_t nLatest = 0;
+    for (size_t idx = 0; idx < m_nShards; ++idx)
+    {
+        Shard& s = m_pShards[idx];
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(s.mutex);
+        auto it = s.index.find(req_id);
+        if (it == s.index.end()) continue;
+        Entry& entry = s.ring[it->second % s.ring.size()];
+        if (nLatest && entry.stored_at <= nLatest) continue;
+        nLatest = entry.stored_at;
+        out.copy(entry.frame);
+    }
+    if (!nLatest)
+    {
+        ++m_nMisses;
+        return false;
+    }
+    ++m_nResent;
+    return true;
+}
+
+void RetransmitBuffer::Shard::evict_oldest_locked()
+{
+    Entry& entry = ring[head % ring.size()];
+    // the index may point at a later frame of the same request
+    auto it = index.find(entry.req_id);
+    if (it != index.end() && it->second == head) index.erase(it);
+    bytes -= entry.frame.size();
+    entry.frame.rebuild();
+    ++head;
+    ++evicted;
+}
+
+RetransmitBuffer::Stats RetransmitBuffer::stats()
+{
+    Stats st { 0, 0, 0, m_nResent, m_nMisses };
+    for (size_t idx = 0; idx < m_nShards; ++idx)
+    {
+        Shard& s = m_pShards[idx];
+        std::lock_guard<TRACY_LOCKABLE_BASE(std::mutex)> lock(s.mutex);
+        st.results += (size_t)(s.tail - s.head);
+        st.bytes += s.bytes;
+        st.evicted += s.evicted;
+    }
+    return st;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <zmq.hpp>
+
+#include "methods.hpp"
+#include "tracer.hpp"
+
+/**
+* The most recent result frames, kept so that a client that lost one (PUB
+* drops at the HWM, a slow joiner) can have it published again with
+* rpc.resend, instead of waiting for its timeout and running the request
+* again.
+*
+* Rings in publish order, indexed by req_id. Frames are shared with the
+* ones sent rather than copied (zmq reference counts them; only small inline
+* frames are copied), and the oldest are dropped once more than max_results
+* or max_bytes are held. Every thread that publishes results stores them in
+* a shard of its own (a worker in the direct publishing mode, the main thread
+* otherwise), each with its share of the limits and its own mutex, so the
+* stores do not contend; fetch() looks through all of them.
+*/
+class RetransmitBuffer
+{
+public:
+    struct Options
+    {
+        size_t max_bytes = 64 << 20;    // bytes of frames held, 0 = off
+        size_t max_results = 65536;     // frames held, 0 = off
+    };
+
+    struct Stats
+    {
+        size_t results;
+        size_t bytes;
+        uint64_t evicted;               // totals since construction
+        uint64_t resent;
+        uint64_t misses;                // rpc.resend for a result that is not held
+    };
+
+    // shards: one per thread that stores results, each passing its own index to store()
+    explicit RetransmitBuffer(Options options, size_t shards = 1);
+
+    RetransmitBuffer(const RetransmitBuffer&) = delete;
+    RetransmitBuffer& operator=(const RetransmitBuffer&) = delete;
+
+    bool enabled() const noexcept { return m_nShardResults != 0; }
+    size_t shard_count() const noexcept { return m_nShards; }
+
+    // keeps req_id's result frame in shard, shared with frame, which is sent afterwards
+    void store(size_t shard, TReqID req_id, zmq::message_t& frame);
+    // one thread: a shared copy of req_id's latest result frame; false when it is not held (any more)
+    bool fetch(TReqID req_id, zmq::message_t& out);
+
+    Stats stats();
+
+private:
+    struct Entry
+    {
+        TReqID req_id = 0;
+        uint64_t stored_at = 0;         // metrics::now_ns(): the latest of the shards' frames for a request wins
+        zmq::message_t frame;
+    };
+
+    struct alignas(64) Shard
+    {
+        TRACY_LOCKABLE(std::mutex, mutex, "retransmit shard");
+        std::vector<Entry> ring;                        // max_results / shards slots; sequence number s lives at s % size
+        uint64_t head = 0;                              // sequence number of the oldest frame
+        uint64_t tail = 0;                              // of the next one
+        size_t bytes = 0;
+        std::unordered_map<TReqID, uint64_t> index;     // req_id -> sequence number of its latest frame
+        uint64_t evicted = 0;
+
+        void evict_oldest_locked();
+    };
+
+    const Options m_options;
+    const size_t m_nShards;
+    const size_t m_nShardResults;                   // each shard's share of the limits
+    const size_t m_nShardBytes;
+    std::unique_ptr<Shard[]> m_pShards;
+    uint64_t m_nResent = 0;                         // fetch() only
+    uint64_t m_nMisses = 0;
+};
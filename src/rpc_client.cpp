@@ -0,0 +1,354 @@
+#include "headers.hpp"
+#include "rpc_client.hpp"
+
+#include <bit>
+#include <charconv>
+#include <climits>
+#include <random>
+
+struct RpcClient::Slot
+{
+    std::atomic<TReqID> req_id { 0 };   // 0 = free: claimed by call(), released by the IO thread
+    Callback on_done;
+    zmq::message_t frame;               // what was sent, kept for the retransmits
+    // IO thread only
+    uint64_t sent_at = 0;
+    TimerWheel::TimerId ack_timer = 0;
+    TimerWheel::TimerId deadline_timer = 0;
+    TimerWheel::TimerId resend_timer = 0;   // after the ack, until the result
+    unsigned retransmits = 0;
+    unsigned resends = 0;
+    bool bSent = false;                 // its Send command ran: replies before are not ours
+    bool bAcked = false;
+};
+
+static zmq::socket_t connect_publisher(zmq::context_t& ctx, const RpcClient::Options& options)
+{
+    zmq::socket_t publisher(ctx, ZMQ_PUB);
+    publisher.set(zmq::sockopt::sndhwm, (int)std::min<size_t>(options.max_pending, INT_MAX));
+    publisher.set(zmq::sockopt::linger, 0);
+    publisher.set(zmq::sockopt::immediate, 1);      // queue nothing for a server that is not connected
+    // a request dropped at the HWM is not acked, and the ack timeout retransmits it
+    publisher.connect(options.cmd_address);
+    return publisher;
+}
+
+static zmq::socket_t connect_subscriber(zmq::context_t& ctx, const RpcClient::Options& options)
+{
+    zmq::socket_t subscriber(ctx, ZMQ_SUB);
+    // an ack and a result per request
+    subscriber.set(zmq::sockopt::rcvhwm, (int)std::min<size_t>(2 * options.max_pending, INT_MAX));
+    subscriber.set(zmq::sockopt::linger, 0);
+    subscriber.connect(options.pub_address);
+    subscriber.set(zmq::sockopt::subscribe, "");
+    return subscriber;
+}
+
+static TReqID random_id_prefix()
+{
+    std::random_device rd;
+    uint32_t prefix = 0;
+    while (!prefix) prefix = rd();
+    return TReqID(prefix) << 32;
+}
+
+RpcClient::RpcClient(zmq::context_t& ctx, Options options, NotificationCallback on_notification)
+    : m_options(std::move(options)),
+    m_onNotification(std::move(on_notification)),
+    m_publisher(connect_publisher(ctx, m_options)),
+    m_subscriber(connect_subscriber(ctx, m_options)),
+    m_pSlots(std::make_unique<Slot[]>(std::bit_ceil(std::max<size_t>(m_options.max_pending, 1)))),
+    m_nSlotMask(std::bit_ceil(std::max<size_t>(m_options.max_pending, 1)) - 1),
+    m_idPrefix(random_id_prefix()),
+    m_ioThread([this] { run(); })
+{ }
+
+RpcClient::~RpcClient()
+{
+    m_bStop.store(true, std::memory_order_release);
+    m_commandBell.ring();
+    m_ioThread.join();
+}
+
+TReqID RpcClient::next_id() noexcept
+{
+    return m_idPrefix | m_nNextSeq.fetch_add(1, std::memory_order_relaxed);
+}
+
+RpcClient::Slot& RpcClient::slot_of(TReqID req_id) noexcept
+{
+    return m_pSlots[(uint32_t)req_id & m_nSlotMask];
+}
+
+TReqID RpcClient::submit(TReqID req_id, zmq::message_t&& frame, Callback&& on_done)
+{
+    Slot& slot = slot_of(req_id);
+    TReqID expected = 0;
+    if (!slot.req_id.compare_exchange_strong(expected, req_id, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        m_counters.errors.fetch_add(1, std::memory_order_relaxed);
+        on_done(RpcResponse { req_id, TOO_MANY_PENDING, "Too many pending requests" });
+        return 0;
+    }
+    // published to the IO thread by the queue
+    slot.on_done = std::move(on_done);
+    slot.frame = std::move(frame);
+    m_commands.push({ Command::Kind::Send, req_id });
+    m_commandBell.ring();
+    return req_id;
+}
+
+void RpcClient::cancel(TReqID req_id)
+{
+    m_commands.push({ Command::Kind::Cancel, req_id });
+    m_commandBell.ring();
+}
+
+metrics::HistogramSnapshot RpcClient::ack_latency() const
+{
+    metrics::HistogramSnapshot snap;
+    snap.merge(m_ackLatency);
+    return snap;
+}
+
+metrics::HistogramSnapshot RpcClient::result_latency() const
+{
+    metrics::HistogramSnapshot snap;
+    snap.merge(m_resultLatency);
+    return snap;
+}
+
+RpcClient::Stats RpcClient::stats() const noexcept
+{
+    auto get = [](const std::atomic<uint64_t>& c) { return c.load(std::memory_order_relaxed); };
+    return { get(m_counters.sent), get(m_counters.retransmits), get(m_counters.resends), get(m_counters.acks), get(m_counters.results),
+        get(m_counters.errors), get(m_counters.timeouts), get(m_counters.send_drops), get(m_counters.unexpected) };
+}
+
+// the reply frames are written with fixed prefixes (jsonrpc::write_ack and friends),
+// so they are matched literally instead of being parsed as JSON
+bool RpcClient::parse_reply(std::string_view frame, ReplyKind& kind, RpcResponse& response) noexcept
+{
+    auto skip = [&frame](std::string_view literal) {
+        if (!frame.starts_with(literal)) return false;
+        frame.remove_prefix(literal.size());
+        return true;
+    };
+    auto number = [&frame](auto& value) {
+        auto [p, ec] = std::from_chars(frame.data(), frame.data() + frame.size(), value);
+        if (ec != std::errc {}) return false;
+        frame.remove_prefix(p - frame.data());
+        return true;
+    };
+
+    response = {};
+    // {"jsonrpc":"2.0","ack":COUNT,"id":N}
+    if (skip(jsonrpc::BATCH_ACK_PREFIX))
+    {
+        size_t count;
+        kind = ReplyKind::Ack;
+        return number(count) && skip(jsonrpc::ID_KEY) && number(response.id);
+    }
+    // {"jsonrpc":"2.0","id":N,"result":...} or {"jsonrpc":"2.0","id":N,"error":{"code":C,"message":"..."}}
+    if (!skip(jsonrpc::RESPONSE_PREFIX) || !number(response.id)) return false;
+    if (skip(jsonrpc::RESULT_KEY) && frame.ends_with('}'))
+    {
+        kind = ReplyKind::Result;
+        response.result = frame.substr(0, frame.size() - 1);
+        return true;
+    }
+    if (skip(jsonrpc::ERROR_CODE_KEY) && number(response.error_code) && skip(jsonrpc::ERROR_MESSAGE_KEY)
+        && frame.size() >= 4 && frame.starts_with('"') && frame.ends_with("\"}}"))
+    {
+        kind = ReplyKind::Error;
+        response.result = frame.substr(1, frame.size() - 4);
+        return true;
+    }
+    return false;
+}
+
+void RpcClient::run()
+{
+    TRACY_THREAD_NAME("rpc client");
+    std::vector<zmq::pollitem_t> items = { { m_subscriber, 0, ZMQ_POLLIN, 0 } };
+    if (m_commandBell.fd() >= 0) items.push_back({ nullptr, m_commandBell.fd(), ZMQ_POLLIN, 0 });
+    std::vector<TimerWheel::Callback> expired;
+    zmq::message_t msg;
+
+    while (!m_bStop.load(std::memory_order_acquire))
+    {
+        try
+        {
+            // without the doorbell fd, calls are picked up on a short poll timeout
+            auto timeout = std::chrono::milliseconds { items.size() > 1 ? -1 : 1 };
+            if (const auto next = m_timers.next_expiry())
+            {
+                const auto untilNext = std::max(std::chrono::ceil<std::chrono::milliseconds>(*next - TimerWheel::Clock::now()),
+                    std::chrono::milliseconds { 0 });
+                timeout = timeout.count() < 0 ? untilNext : std::min(timeout, untilNext);
+            }
+            zmq::poll(items, timeout);
+
+            m_commandBell.reset();
+            run_commands();
+            while (m_subscriber.recv(msg, zmq::recv_flags::dontwait))
+                on_reply(msg.to_string_view());
+
+            m_timers.advance(TimerWheel::Clock::now(), expired);
+            for (auto& fn : expired) fn();
+            expired.clear();
+        }
+        catch (const zmq::error_t& e)
+        {
+            std::cerr << "RpcClient: ZeroMQ error: " << e.what() << '\n';
+            break;
+        }
+    }
+
+    // calls that were never sent fail along with the pending ones
+    while (auto command = m_commands.pop())
+    {
+        Slot& slot = slot_of(command->req_id);
+        if (command->kind == Command::Kind::Send) slot.bSent = true;
+    }
+    fail_all(CANCELLED, "Client closed");
+}
+
+void RpcClient::run_commands()
+{
+    while (auto command = m_commands.pop())
+    {
+        const TReqID req_id = command->req_id;
+        Slot& slot = slot_of(req_id);
+        if (command->kind == Command::Kind::Cancel)
+        {
+            if (slot.bSent && slot.req_id.load(std::memory_order_relaxed) == req_id)
+                complete(slot, CANCELLED, "Request cancelled");
+            continue;
+        }
+
+        slot.bSent = true;
+        slot.bAcked = false;
+        slot.retransmits = 0;
+        slot.resends = 0;
+        slot.sent_at = metrics::now_ns();
+        send(slot);
+        if (m_options.max_retransmits)
+            slot.ack_timer = m_timers.schedule_after(m_options.ack_timeout, [this, req_id] { on_ack_timeout(req_id); });
+        slot.deadline_timer = m_timers.schedule_after(m_options.timeout, [this, req_id] {
+            Slot& pending = slot_of(req_id);
+            if (pending.req_id.load(std::memory_order_relaxed) != req_id) return;
+            pending.deadline_timer = 0;
+            m_counters.timeouts.fetch_add(1, std::memory_order_relaxed);
+            complete(pending, TIMEOUT, "Request timed out");
+        });
+    }
+}
+
+void RpcClient::send(Slot& slot)
+{
+    // a reference counted copy: the frame stays for the retransmits
+    zmq::message_t copy;
+    copy.copy(slot.frame);
+    if (m_publisher.send(std::move(copy), zmq::send_flags::dontwait))
+        m_counters.sent.fetch_add(1, std::memory_order_relaxed);
+    else
+        m_counters.send_drops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RpcClient::on_ack_timeout(TReqID req_id)
+{
+    Slot& slot = slot_of(req_id);
+    if (slot.req_id.load(std::memory_order_relaxed) != req_id || slot.bAcked) return;
+    slot.ack_timer = 0;
+    if (slot.retransmits == m_options.max_retransmits)
+    {
+        complete(slot, NOT_ACKED, "No ack from the server");
+        return;
+    }
+    ++slot.retransmits;
+    m_counters.retransmits.fetch_add(1, std::memory_order_relaxed);
+    send(slot);
+    slot.ack_timer = m_timers.schedule_after(m_options.ack_timeout * (1u << slot.retransmits), [this, req_id] { on_ack_timeout(req_id); });
+}
+
+void RpcClient::on_result_overdue(TReqID req_id)
+{
+    Slot& slot = slot_of(req_id);
+    if (slot.req_id.load(std::memory_order_relaxed) != req_id) return;
+    // lost after the ack (a PUB drop, a slow joiner) or still running: the server publishes
+    // the result again when it holds it, and stays silent otherwise
+    ++slot.resends;
+    m_counters.resends.fetch_add(1, std::memory_order_relaxed);
+    if (!m_publisher.send(encode_request<MethodID::RPC_Resend>(req_id, { req_id }), zmq::send_flags::dontwait))
+        m_counters.send_drops.fetch_add(1, std::memory_order_relaxed);
+    slot.resend_timer = m_timers.schedule_after(m_options.resend_after * (1u << std::min(slot.resends, 16u)),
+        [this, req_id] { on_result_overdue(req_id); });
+}
+
+void RpcClient::on_reply(std::string_view frame)
+{
+    ReplyKind kind;
+    RpcResponse response;
+    if (!parse_reply(frame, kind, response) || !response.id)
+    {
+        if (m_onNotification) m_onNotification(frame);
+        return;
+    }
+
+    Slot& slot = slot_of(response.id);
+    if (slot.req_id.load(std::memory_order_relaxed) != response.id || !slot.bSent)
+    {
+        m_counters.unexpected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t elapsed = metrics::now_ns() - slot.sent_at;
+    switch (kind)
+    {
+        case ReplyKind::Ack:
+            m_counters.acks.fetch_add(1, std::memory_order_relaxed);
+            if (slot.bAcked) break;     // the ack of a retransmit
+            slot.bAcked = true;
+            m_timers.cancel(std::exchange(slot.ack_timer, 0));
+            m_ackLatency.record(elapsed);
+            if (m_options.resend_after.count() > 0)
+                slot.resend_timer = m_timers.schedule_after(m_options.resend_after, [this, req_id = response.id] { on_result_overdue(req_id); });
+            break;
+        case ReplyKind::Result:
+            m_counters.results.fetch_add(1, std::memory_order_relaxed);
+            m_resultLatency.record(elapsed);
+            complete(slot, 0, response.result);
+            break;
+        case ReplyKind::Error:
+            complete(slot, response.error_code, response.result);
+            break;
+    }
+}
+
+void RpcClient::complete(Slot& slot, int error_code, std::string_view result)
+{
+    const TReqID req_id = slot.req_id.load(std::memory_order_relaxed);
+    if (error_code) m_counters.errors.fetch_add(1, std::memory_order_relaxed);
+    if (slot.ack_timer) m_timers.cancel(std::exchange(slot.ack_timer, 0));
+    if (slot.deadline_timer) m_timers.cancel(std::exchange(slot.deadline_timer, 0));
+    if (slot.resend_timer) m_timers.cancel(std::exchange(slot.resend_timer, 0));
+
+    Callback on_done = std::move(slot.on_done);
+    slot.on_done = nullptr;
+    slot.frame.rebuild(0);
+    slot.bSent = false;
+    // free for the next call(): everything above happens before its claim
+    slot.req_id.store(0, std::memory_order_release);
+
+    on_done(RpcResponse { req_id, error_code, result });
+}
+
+void RpcClient::fail_all(int error_code, std::string_view message)
+{
+    for (size_t idx = 0; idx <= m_nSlotMask; ++idx)
+    {
+        Slot& slot = m_pSlots[idx];
+        if (slot.bSent && slot.req_id.load(std::memory_order_relaxed)) complete(slot, error_code, message);
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <zmq.hpp>
+
+/**
+* Pipelined client for the dispatcher's binary protocol, the C++ counterpart
+* of examples/js ZMQRPC_Client. Requests are encoded from the method's
+* Payload<MID> (encode_request), so producers no longer write frames by hand:
+*
+*   RpcClient client(ctx, { .cmd_address = "tcp://host:5555", .pub_address = "tcp://host:5556" });
+*   client.call<MethodID::GStreamer_Pipeline_Stop>({ 3 }, [](const RpcResponse& r) { ... });
+*   std::string result = client.call<MethodID::GStreamer_Pipeline_List>({}).get();
+*
+* Any number of requests may be outstanding. call() claims a slot in a
+* fixed, lock-free pending table indexed by req_id and hands the frame to the
+* client's IO thread, which owns both sockets: it sends, matches the acks and
+* results to their slots (the replies are decoded in place, without
+* allocating) and keeps the timeouts in a TimerWheel. PUB/SUB may lose a
+* request silently, so a request that is not acked within ack_timeout is sent
+* again, up to max_retransmits times with doubling delays; a request whose ack
+* was lost may then run twice, so set max_retransmits to 0 for methods that
+* are not idempotent. A result lost after the ack is asked for again with
+* rpc.resend when it is resend_after overdue (doubling until the deadline):
+* the server publishes the frame it kept, without running the request again.
+*
+* Callbacks run on the IO thread and must not block; the RpcResponse views
+* point into the received frame and are valid during the callback only.
+*/
+struct RpcResponse
+{
+    TReqID id = 0;
+    int error_code = 0;         // 0 on success, a JSON-RPC error code, or one of the RpcClient codes
+    std::string_view result;    // the "result" JSON text, or the (escaped) error message
+
+    bool ok() const noexcept { return error_code == 0; }
+};
+
+class RpcError : public std::runtime_error
+{
+public:
+    RpcError(int code, const std::string& message) : std::runtime_error(message), m_nCode(code) { }
+    int code() const noexcept { return m_nCode; }
+
+private:
+    int m_nCode;
+};
+
+class RpcClient
+{
+public:
+    using Callback = std::move_only_function<void(const RpcResponse&)>;
+    // replies without a request id of ours: notifications (rpc.stats, logs), the whole frame
+    using NotificationCallback = std::function<void(std::string_view)>;
+
+    // client side error codes (the server uses -32000 and the standard ones)
+    static constexpr int TIMEOUT = -32090;          // no result before the deadline
+    static constexpr int NOT_ACKED = -32091;        // no ack after every retransmit
+    static constexpr int CANCELLED = -32092;        // cancel(), or the client closed
+    static constexpr int TOO_MANY_PENDING = -32093; // the request's pending table slot is taken
+
+    struct Options
+    {
+        std::string cmd_address = "tcp://localhost:5555";  // the dispatcher's SUB socket: requests out
+        std::string pub_address = "tcp://localhost:5556";  // the dispatcher's PUB socket: acks, results in
+        std::chrono::milliseconds ack_timeout { 50 };      // resend when no ack came by then (doubling)
+        unsigned max_retransmits = 3;
+        std::chrono::milliseconds resend_after { 1000 };   // after the ack: rpc.resend when no result came by then (doubling), 0 = never
+        std::chrono::milliseconds timeout { 30000 };       // deadline for the result
+        size_t max_pending = 65536;     // outstanding requests; rounded up to a power of two
+        TClientID client_id = 0;        // stamped on every request for fair queuing when non-zero
+    };
+
+    struct Stats
+    {
+        uint64_t sent = 0;
+        uint64_t retransmits = 0;
+        uint64_t resends = 0;           // rpc.resend sent for overdue results
+        uint64_t acks = 0;
+        uint64_t results = 0;
+        uint64_t errors = 0;            // error responses and client side failures
+        uint64_t timeouts = 0;
+        uint64_t send_drops = 0;        // sends that failed (left to the retransmits; HWM drops are silent)
+        uint64_t unexpected = 0;        // replies to ids that are not pending (another client's, or late)
+    };
+
+    RpcClient(zmq::context_t& ctx, Options options, NotificationCallback on_notification = {});
+    // fails the pending requests with CANCELLED
+    ~RpcClient();
+
+    RpcClient(const RpcClient&) = delete;
+    RpcClient& operator=(const RpcClient&) = delete;
+
+    // any thread: sends the request; on_done runs once, with the result or the error.
+    // Returns the request id, or 0 (and on_done runs with TOO_MANY_PENDING) when its slot is taken.
+    template<MethodID MID>
+    TReqID call(const Payload<MID>& payload, Callback on_done)
+    {
+        const TReqID req_id = next_id();
+        return submit(req_id, encode_request<MID>(req_id, payload, m_options.client_id), std::move(on_done));
+    }
+
+    // any thread: the result JSON, or an RpcError
+    template<MethodID MID>
+    std::future<std::string> call(const Payload<MID>& payload)
+    {
+        auto pPromise = std::make_shared<std::promise<std::string>>();
+        std::future<std::string> result = pPromise->get_future();
+        call<MID>(payload, [pPromise](const RpcResponse& r) {
+            if (r.ok()) pPromise->set_value(std::string(r.result));
+            else pPromise->set_exception(std::make_exception_ptr(RpcError(r.error_code, std::string(r.result))));
+        });
+        return result;
+    }
+
+    // any thread: completes req_id with CANCELLED; a late reply is ignored
+    void cancel(TReqID req_id);
+
+    // the ack (send to ack) and result (send to result) latencies; safe from any thread
+    metrics::HistogramSnapshot ack_latency() const;
+    metrics::HistogramSnapshot result_latency() const;
+    Stats stats() const noexcept;
+
+    // parses a reply frame as the dispatcher writes it (response_writer.hpp); false for notifications
+    enum class ReplyKind : uint8_t { Ack, Result, Error };
+    static bool parse_reply(std::string_view frame, ReplyKind& kind, RpcResponse& response) noexcept;
+
+private:
+    struct Slot;
+    struct Command
+    {
+        enum class Kind : uint8_t { Send, Cancel } kind;
+        TReqID req_id;
+    };
+
+    TReqID next_id() noexcept;
+    Slot& slot_of(TReqID req_id) noexcept;
+    TReqID submit(TReqID req_id, zmq::message_t&& frame, Callback&& on_done);
+
+    // IO thread
+    void run();
+    void run_commands();
+    void send(Slot& slot);
+    void on_reply(std::string_view frame);
+    void on_ack_timeout(TReqID req_id);
+    void on_result_overdue(TReqID req_id);
+    void complete(Slot& slot, int error_code, std::string_view result);
+    void fail_all(int error_code, std::string_view message);
+
+    const Options m_options;
+    NotificationCallback m_onNotification;
+    zmq::socket_t m_publisher;
+    zmq::socket_t m_subscriber;
+
+    std::unique_ptr<Slot[]> m_pSlots;
+    size_t m_nSlotMask;
+    const TReqID m_idPrefix;            // random high half: the replies to other clients do not match our ids
+    std::atomic<uint32_t> m_nNextSeq { 0 };
+
+    MpscQueue<Command> m_commands;
+    Doorbell m_commandBell;
+    TimerWheel m_timers;                // IO thread only
+    std::atomic<bool> m_bStop { false };
+
+    metrics::Histogram m_ackLatency;    // written by the IO thread only
+    metrics::Histogram m_resultLatency;
+    struct Counters
+    {
+        std::atomic<uint64_t> sent { 0 }, retransmits { 0 }, resends { 0 }, acks { 0 }, results { 0 }, errors { 0 },
+            timeouts { 0 }, send_drops { 0 }, unexpected { 0 };
+    } m_counters;
+
+    std::thread m_ioThread;             // last: starts once everything above exists
+};
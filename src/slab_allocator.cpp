@@ -0,0 +1,23 @@
+#include "headers.hpp"
+#include "slab_allocator.hpp"
+
+SlabAllocator& SlabAllocator::instance()
+{
+    static SlabAllocator* pInstance = new SlabAllocator();
+    return *pInstance;
+}
+
+void SlabBuffer::grow(size_t min_capacity)
+{
+    const size_t capacity = SlabAllocator::capacity_for(std::max(min_capacity, m_nCapacity * 2));
+    char* pData = static_cast<char*>(SlabAllocator::instance().allocate(capacity));
+    if (m_nSize) std::memcpy(pData, m_pData, m_nSize);
+    free();
+    m_pData = pData;
+    m_nCapacity = capacity;
+}
+
+void SlabBuffer::free_message(void* data, void* hint) noexcept
+{
+    SlabAllocator::instance().deallocate(data, reinterpret_cast<size_t>(hint));
+}
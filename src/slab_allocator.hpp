@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <fmt/format.h>
+#include <zmq.hpp>
+
+#include "lockfree_object_pool.hpp"
+
+namespace slab_detail
+{
+    inline constexpr size_t MIN_CLASS_SHIFT = 6;     // 64 B
+    inline constexpr size_t MAX_CLASS_SHIFT = 20;    // 1 MiB
+    inline constexpr size_t NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+
+    // ~256 KiB preallocated per class, thread caches bounded to ~64 KiB
+    constexpr size_t class_size(size_t cls) noexcept { return size_t(1) << (MIN_CLASS_SHIFT + cls); }
+    constexpr size_t prealloc_for(size_t cls) noexcept { return std::max<size_t>(2, (256 * 1024) / class_size(cls)); }
+    constexpr size_t thread_cache_for(size_t cls) noexcept { return std::clamp<size_t>((64 * 1024) / class_size(cls), 2, 64); }
+
+    template<size_t N>
+    struct Chunk
+    {
+        alignas(std::max_align_t) std::byte bytes[N];
+        Chunk() noexcept { } // leave the bytes uninitialized
+    };
+
+    template<size_t I>
+    using ChunkOf = Chunk<class_size(I)>;
+
+    template<size_t I>
+    struct ClassPool
+    {
+        LockFreeObjectPool<ChunkOf<I>> pool { prealloc_for(I), thread_cache_for(I) };
+    };
+
+    template<typename Seq> struct PoolsFor;
+    template<size_t... I>
+    struct PoolsFor<std::index_sequence<I...>> : ClassPool<I>... { };
+    using Pools = PoolsFor<std::make_index_sequence<NUM_CLASSES>>;
+
+    template<size_t I>
+    void* acquire_from(Pools& pools) { return static_cast<ClassPool<I>&>(pools).pool.acquire()->bytes; }
+
+    template<size_t I>
+    void release_to(Pools& pools, void* p) noexcept { static_cast<ClassPool<I>&>(pools).pool.release(reinterpret_cast<ChunkOf<I>*>(p)); }
+
+    // per class entry points, indexed by size class
+    inline constexpr auto acquire_table = []<size_t... I>(std::index_sequence<I...>) {
+        return std::array<void* (*)(Pools&), NUM_CLASSES> { &acquire_from<I>... };
+    }(std::make_index_sequence<NUM_CLASSES> {});
+    inline constexpr auto release_table = []<size_t... I>(std::index_sequence<I...>) {
+        return std::array<void (*)(Pools&, void*) noexcept, NUM_CLASSES> { &release_to<I>... };
+    }(std::make_index_sequence<NUM_CLASSES> {});
+}
+
+/**
+* Power-of-two size class allocator for variable length buffers (acks, JSON
+* results, stream chunks). Each class is a LockFreeObjectPool of raw chunks,
+* so it inherits the per-thread magazines and the lock-free global lists.
+* Requests above the largest class go to the heap.
+*/
+class SlabAllocator
+{
+public:
+    static constexpr size_t MIN_CLASS_SIZE = slab_detail::class_size(0);
+    static constexpr size_t MAX_CLASS_SIZE = slab_detail::class_size(slab_detail::NUM_CLASSES - 1);
+
+    // process wide instance; never destroyed, since buffers may still be freed
+    // by the ZMQ IO thread while static destructors run
+    static SlabAllocator& instance();
+
+    // capacity of the chunk that serves a request of `bytes`
+    static constexpr size_t capacity_for(size_t bytes) noexcept
+    {
+        return bytes <= MIN_CLASS_SIZE ? MIN_CLASS_SIZE : std::bit_ceil(bytes);
+    }
+
+    // allocates capacity_for(bytes) bytes
+    void* allocate(size_t bytes)
+    {
+        const size_t capacity = capacity_for(bytes);
+        if (capacity > MAX_CLASS_SIZE) [[unlikely]]
+            return ::operator new(capacity);
+        return slab_detail::acquire_table[class_of(capacity)](m_pools);
+    }
+
+    // `capacity` must be the value capacity_for() returned for the allocation
+    void deallocate(void* p, size_t capacity) noexcept
+    {
+        if (capacity > MAX_CLASS_SIZE) [[unlikely]]
+            return ::operator delete(p);
+        slab_detail::release_table[class_of(capacity)](m_pools, p);
+    }
+
+    // summed over all size classes
+    ObjectPoolStats stats() const noexcept
+    {
+        return [this]<size_t... I>(std::index_sequence<I...>) {
+            ObjectPoolStats st;
+            ((st += static_cast<const slab_detail::ClassPool<I>&>(m_pools).pool.stats()), ...);
+            return st;
+        }(std::make_index_sequence<slab_detail::NUM_CLASSES> {});
+    }
+
+private:
+    SlabAllocator() = default;
+
+    static constexpr size_t class_of(size_t capacity) noexcept
+    {
+        return std::countr_zero(capacity) - slab_detail::MIN_CLASS_SHIFT;
+    }
+
+    slab_detail::Pools m_pools;
+};
+
+/**
+* Growable char buffer whose storage comes from the SlabAllocator. Usable as
+* a fmt output (fmt::format_to(std::back_inserter(buf), ...)) and handed to
+* ZMQ via to_message(): replies that fit inside zmq_msg_t (up to
+* MAX_INLINE_SIZE bytes) are copied there and need no allocation at all;
+* larger ones are handed over without a copy and freed back into the slab
+* once ZMQ is done sending. Those still cost libzmq's malloc of its
+* reference counted content_t (zmq_msg_init_data), which mimalloc serves
+* from the thread's free list (BM_ToMessage measures both paths).
+*/
+class SlabBuffer
+{
+public:
+    using value_type = char;
+
+    // libzmq's very small message (VSM) capacity on 64 bit targets: the bytes live in zmq_msg_t
+    static constexpr size_t MAX_INLINE_SIZE = 33;
+
+    SlabBuffer() noexcept = default;
+    explicit SlabBuffer(size_t capacity) { reserve(capacity); }
+    ~SlabBuffer() { free(); }
+
+    SlabBuffer(SlabBuffer&& other) noexcept
+        : m_pData(std::exchange(other.m_pData, nullptr)),
+        m_nSize(std::exchange(other.m_nSize, 0)),
+        m_nCapacity(std::exchange(other.m_nCapacity, 0))
+    { }
+
+    SlabBuffer& operator=(SlabBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            free();
+            m_pData = std::exchange(other.m_pData, nullptr);
+            m_nSize = std::exchange(other.m_nSize, 0);
+            m_nCapacity = std::exchange(other.m_nCapacity, 0);
+        }
+        return *this;
+    }
+
+    SlabBuffer(const SlabBuffer&) = delete;
+    SlabBuffer& operator=(const SlabBuffer&) = delete;
+
+    char* data() noexcept { return m_pData; }
+    const char* data() const noexcept { return m_pData; }
+    size_t size() const noexcept { return m_nSize; }
+    size_t capacity() const noexcept { return m_nCapacity; }
+    bool empty() const noexcept { return m_nSize == 0; }
+    std::string_view view() const noexcept { return { m_pData, m_nSize }; }
+
+    char& operator[](size_t i) noexcept { return m_pData[i]; }
+    const char& operator[](size_t i) const noexcept { return m_pData[i]; }
+
+    void clear() noexcept { m_nSize = 0; }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity > m_nCapacity) grow(capacity);
+    }
+
+    void resize(size_t size)
+    {
+        reserve(size);
+        m_nSize = size;
+    }
+
+    void push_back(char c)
+    {
+        if (m_nSize == m_nCapacity) [[unlikely]] grow(m_nSize + 1);
+        m_pData[m_nSize++] = c;
+    }
+
+    void append(std::string_view sv)
+    {
+        reserve(m_nSize + sv.size());
+        std::memcpy(m_pData + m_nSize, sv.data(), sv.size());
+        m_nSize += sv.size();
+    }
+
+    // Copies bytes into a slab backed message. Unlike small received frames,
+    // whose bytes live inside zmq_msg_t, its data does not move with the
+    // message. `padding` extra bytes (zeroed) are readable past the end.
+    static zmq::message_t copy_to_message(std::string_view bytes, size_t padding = 0)
+    {
+        SlabBuffer buf(bytes.size() + padding);
+        buf.append(bytes);
+        std::memset(buf.data() + buf.size(), 0, padding);
+        return std::move(buf).to_external_message();
+    }
+
+    // Hands the bytes over to ZMQ, inline when they fit, otherwise without a
+    // copy; the buffer is empty afterwards.
+    zmq::message_t to_message() &&
+    {
+        if (m_nSize > MAX_INLINE_SIZE) return std::move(*this).to_external_message();
+        zmq::message_t msg(m_pData, m_nSize);
+        free();
+        m_pData = nullptr;
+        m_nSize = m_nCapacity = 0;
+        return msg;
+    }
+
+    // Zero-copy hand over to ZMQ, whatever the size: the data stays where it is
+    // (views into it survive moving the message); the buffer is empty afterwards.
+    zmq::message_t to_external_message() &&
+    {
+        if (!m_pData) return zmq::message_t();
+        // the hint carries the capacity so the free callback finds the size class
+        zmq::message_t msg(std::exchange(m_pData, nullptr), std::exchange(m_nSize, 0),
+            &SlabBuffer::free_message, reinterpret_cast<void*>(std::exchange(m_nCapacity, 0)));
+        return msg;
+    }
+
+private:
+    void grow(size_t min_capacity);
+
+    void free() noexcept
+    {
+        if (m_pData) SlabAllocator::instance().deallocate(m_pData, m_nCapacity);
+    }
+
+    // called by ZMQ (typically on its IO thread) once the message is sent
+    static void free_message(void* data, void* hint) noexcept;
+
+    char* m_pData = nullptr;
+    size_t m_nSize = 0;
+    size_t m_nCapacity = 0;
+};
+
+template<>
+struct fmt::is_contiguous<SlabBuffer> : std::true_type { };
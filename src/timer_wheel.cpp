@@ -0,0 +1,175 @@
+#include "headers.hpp"
+#include "timer_wheel.hpp"
+
+#include <bit>
+
+TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point start)
+    : m_tick(std::max<Clock::duration>(tick, Clock::duration(1))), m_start(start)
+{
+    m_heads.fill(NIL);
+}
+
+uint64_t TimerWheel::tick_of(Clock::time_point t) const noexcept
+{
+    // rounded up: a timer never fires before its deadline
+    if (t <= m_start) return 0;
+    return (uint64_t)((t - m_start + m_tick - Clock::duration(1)) / m_tick);
+}
+
+TimerWheel::TimerId TimerWheel::schedule_at(Clock::time_point due, Callback fn)
+{
+    uint32_t idx;
+    if (!m_free.empty())
+    {
+        idx = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        idx = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    Node& node = m_nodes[idx];
+    node.fn = std::move(fn);
+    // the current tick was processed already
+    node.due_tick = std::max(tick_of(due), m_nNow + 1);
+    insert(idx);
+    ++m_nActive;
+    return (uint64_t(node.generation) << 32) | (idx + 1);
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    const uint32_t idx = (uint32_t)id - 1;
+    if (id == 0 || idx >= m_nodes.size()) return false;
+    Node& node = m_nodes[idx];
+    if (node.list == NIL || node.generation != (uint32_t)(id >> 32)) return false;
+    unlink(idx);
+    release(idx);
+    return true;
+}
+
+void TimerWheel::insert(uint32_t idx)
+{
+    Node& node = m_nodes[idx];
+    const uint64_t diff = node.due_tick ^ m_nNow;
+    const unsigned level = diff ? (63 - std::countl_zero(diff)) / SLOT_BITS : 0;
+    if (level < LEVELS)
+    {
+        const unsigned slot = (node.due_tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+        node.list = level * SLOTS + slot;
+        m_occupied[level] |= uint64_t(1) << slot;
+    }
+    else node.list = OVERFLOW_LIST;
+
+    node.prev = NIL;
+    node.next = m_heads[node.list];
+    if (node.next != NIL) m_nodes[node.next].prev = idx;
+    m_heads[node.list] = idx;
+}
+
+void TimerWheel::unlink(uint32_t idx)
+{
+    Node& node = m_nodes[idx];
+    if (node.prev != NIL) m_nodes[node.prev].next = node.next;
+    else m_heads[node.list] = node.next;
+    if (node.next != NIL) m_nodes[node.next].prev = node.prev;
+
+    if (m_heads[node.list] == NIL && node.list != OVERFLOW_LIST)
+        m_occupied[node.list / SLOTS] &= ~(uint64_t(1) << (node.list % SLOTS));
+}
+
+void TimerWheel::release(uint32_t idx)
+{
+    Node& node = m_nodes[idx];
+    node.fn = nullptr;
+    node.list = NIL;
+    ++node.generation;
+    m_free.push_back(idx);
+    --m_nActive;
+}
+
+void TimerWheel::cascade(unsigned level, unsigned slot)
+{
+    const unsigned list = level < LEVELS ? level * SLOTS + slot : OVERFLOW_LIST;
+    uint32_t idx = std::exchange(m_heads[list], NIL);
+    if (level < LEVELS) m_occupied[level] &= ~(uint64_t(1) << slot);
+    while (idx != NIL)
+    {
+        const uint32_t next = m_nodes[idx].next;
+        insert(idx);    // relative to m_nNow: one level down at least
+        idx = next;
+    }
+}
+
+void TimerWheel::expire_slot(unsigned slot, std::vector<Callback>& expired)
+{
+    uint32_t idx = std::exchange(m_heads[slot], NIL);
+    m_occupied[0] &= ~(uint64_t(1) << slot);
+    while (idx != NIL)
+    {
+        const uint32_t next = m_nodes[idx].next;
+        expired.push_back(std::move(m_nodes[idx].fn));
+        release(idx);
+        idx = next;
+    }
+}
+
+uint64_t TimerWheel::next_event_tick() const noexcept
+{
+    // per level, the first occupied slot past the current one: an expiry at level 0, a cascade above
+    uint64_t best = UINT64_MAX;
+    for (unsigned level = 0; level < LEVELS; ++level)
+    {
+        const unsigned shift = level * SLOT_BITS;
+        const unsigned current = (m_nNow >> shift) & (SLOTS - 1);
+        const uint64_t ahead = current + 1 < SLOTS ? m_occupied[level] & (~uint64_t(0) << (current + 1)) : 0;
+        if (!ahead) continue;
+        const uint64_t base = m_nNow & ~((uint64_t(1) << (shift + SLOT_BITS)) - 1);
+        best = std::min(best, base + (uint64_t(std::countr_zero(ahead)) << shift));
+    }
+    if (m_heads[OVERFLOW_LIST] != NIL)
+        best = std::min(best, (m_nNow | ((uint64_t(1) << (LEVELS * SLOT_BITS)) - 1)) + 1);
+    return best;
+}
+
+size_t TimerWheel::advance(Clock::time_point now, std::vector<Callback>& expired)
+{
+    const size_t nBefore = expired.size();
+    const uint64_t target = now <= m_start ? 0 : (uint64_t)((now - m_start) / m_tick);
+    while (m_nActive && m_nNow < target)
+    {
+        const uint64_t tick = next_event_tick();
+        if (tick > target) break;
+        m_nNow = tick;
+        // higher levels first; each cascade only moves timers down
+        for (unsigned level = LEVELS; level > 0; --level)
+        {
+            if (tick & ((uint64_t(1) << (level * SLOT_BITS)) - 1)) continue;
+            cascade(level, (tick >> (level * SLOT_BITS)) & (SLOTS - 1));
+        }
+        expire_slot(tick & (SLOTS - 1), expired);
+    }
+    m_nNow = std::max(m_nNow, target);
+    return expired.size() - nBefore;
+}
+
+size_t TimerWheel::drain(std::vector<Callback>& pending)
+{
+    const size_t nBefore = pending.size();
+    for (uint32_t idx = 0; idx < m_nodes.size(); ++idx)
+    {
+        if (m_nodes[idx].list == NIL) continue;
+        pending.push_back(std::move(m_nodes[idx].fn));
+        release(idx);
+    }
+    m_heads.fill(NIL);
+    m_occupied.fill(0);
+    return pending.size() - nBefore;
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::next_expiry() const noexcept
+{
+    if (m_nActive == 0) return std::nullopt;
+    return time_of(next_event_tick());
+}
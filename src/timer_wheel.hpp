@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/**
+* Hierarchical timing wheel: LEVELS levels of 64 slots, level l slots being
+* 64^l ticks wide (1 ms ticks cover ~4.6 hours before the overflow list).
+* Scheduling and cancelling are O(1): a timer is linked into the slot of the
+* highest 6 bit tick group in which its deadline differs from the current
+* tick, and unlinked by id. advance() expires level 0 slots in batches and
+* cascades a higher level slot down when the lower levels wrap; per-level
+* occupancy bitmaps let it jump over empty stretches instead of visiting
+* every tick.
+*
+* Not thread-safe: the owner serializes access (see coro::Scheduler).
+* Deadlines are rounded up to the next tick, so a timer never fires early.
+*/
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::move_only_function<void()>;
+    using TimerId = uint64_t;   // 0 is never a valid id
+
+    static constexpr unsigned LEVELS = 4;
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS = 1u << SLOT_BITS;
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1), Clock::time_point start = Clock::now());
+
+    TimerId schedule_at(Clock::time_point due, Callback fn);
+    TimerId schedule_after(Clock::duration delay, Callback fn) { return schedule_at(Clock::now() + delay, std::move(fn)); }
+
+    // false when the timer already expired or was cancelled
+    bool cancel(TimerId id);
+
+    // moves the callbacks of every timer due by now to expired, in deadline (tick) order
+    size_t advance(Clock::time_point now, std::vector<Callback>& expired);
+
+    // moves out every pending callback, e.g. to run them early at shutdown
+    size_t drain(std::vector<Callback>& pending);
+
+    // earliest time advance() can have something to do; empty when no timer is pending
+    std::optional<Clock::time_point> next_expiry() const noexcept;
+
+    size_t size() const noexcept { return m_nActive; }
+    bool empty() const noexcept { return m_nActive == 0; }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr unsigned OVERFLOW_LIST = LEVELS * SLOTS;  // timers beyond the top level
+
+    struct Node
+    {
+        Callback fn;
+        uint64_t due_tick = 0;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint32_t list = NIL;        // level * SLOTS + slot, OVERFLOW_LIST, or NIL when free
+        uint32_t generation = 0;    // bumped on release: stale ids do not cancel a reused node
+    };
+
+    uint64_t tick_of(Clock::time_point t) const noexcept;
+    Clock::time_point time_of(uint64_t tick) const noexcept { return m_start + m_tick * tick; }
+
+    void insert(uint32_t idx);
+    void unlink(uint32_t idx);
+    void release(uint32_t idx);
+    void cascade(unsigned level, unsigned slot);
+    void expire_slot(unsigned slot, std::vector<Callback>& expired);
+    // the next tick after m_nNow with work: an occupied level 0 slot, or a higher level slot to cascade
+    uint64_t next_event_tick() const noexcept;
+
+    const Clock::duration m_tick;
+    const Clock::time_point m_start;
+    uint64_t m_nNow = 0;    // last processed tick
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_free;
+    std::array<uint32_t, LEVELS * SLOTS + 1> m_heads;
+    std::array<uint64_t, LEVELS> m_occupied {};    // bit s: level slot s is non-empty
+    size_t m_nActive = 0;
+};
@@ -1,11 +1,34 @@
 #pragma once
 
+/**
+* Thin wrappers over the Tracy client API. Everything expands to nothing (or
+* to the plain type for lockables) unless built with ENABLE_TRACY.
+*
+* Tracy has no cross-thread flow events, so a request is followed by its id:
+* every request scoped zone carries req_id as its zone value (TRACY_ZONE_FLOW),
+* and "Find Zone" / the zone value filter lines up ingress, executor and
+* publish zones of the same request across threads.
+*/
 #ifdef ENABLE_TRACY
 #include <tracy/Tracy.hpp>
 
-#define TRACY_ZONE			ZoneScoped
-#define TRACY_ZONE_NAMED(x)	ZoneScopedN(x)
+#define TRACY_ZONE			        ZoneScoped
+#define TRACY_ZONE_NAMED(x)	        ZoneScopedN(x)
+#define TRACY_ZONE_NAME(sv)         ZoneName((sv).data(), (sv).size())
+#define TRACY_ZONE_TEXT(sv)         ZoneText((sv).data(), (sv).size())
+#define TRACY_ZONE_FLOW(req_id)     ZoneValue((uint64_t)(req_id))
+#define TRACY_PLOT(name, value)     TracyPlot(name, (int64_t)(value))
+#define TRACY_THREAD_NAME(name)     tracy::SetThreadName(name)
+#define TRACY_LOCKABLE(type, var, desc) TracyLockableN(type, var, desc)
+#define TRACY_LOCKABLE_BASE(type)   LockableBase(type)
 #else
-#define TRACY_ZONE 
+#define TRACY_ZONE
 #define TRACY_ZONE_NAMED(x)
-#endif
\ No newline at end of file
+#define TRACY_ZONE_NAME(sv)
+#define TRACY_ZONE_TEXT(sv)
+#define TRACY_ZONE_FLOW(req_id)
+#define TRACY_PLOT(name, value)
+#define TRACY_THREAD_NAME(name)
+#define TRACY_LOCKABLE(type, var, desc) type var
+#define TRACY_LOCKABLE_BASE(type)   type
+#endif
@@ -2,22 +2,61 @@
 #include <zmq.hpp>
 #include <functional>
 #include <chrono>
+#include <charconv>
+#include <string_view>
 #include <thread>
+#include <vector>
+
+#include "coro_task.hpp"
 
 namespace utils
 {
+    // parses Linux style id lists such as "0-3,8,10-11" (cpulist, numa node list)
+    inline std::vector<unsigned> parse_id_list(std::string_view list)
+    {
+        std::vector<unsigned> ids;
+        while (!list.empty())
+        {
+            const size_t comma = list.find(',');
+            std::string_view range = list.substr(0, comma);
+            list = comma == std::string_view::npos ? std::string_view {} : list.substr(comma + 1);
+
+            unsigned first = 0, last = 0;
+            auto [p, ec] = std::from_chars(range.data(), range.data() + range.size(), first);
+            if (ec != std::errc {}) continue;
+            last = first;
+            if (p != range.data() + range.size() && *p == '-')
+                std::from_chars(p + 1, range.data() + range.size(), last);
+            for (unsigned id = first; id <= last; ++id)
+                ids.push_back(id);
+        }
+        return ids;
+    }
+
+    // true for very small messages (VSM, up to 33 bytes), whose data is stored
+    // inside the zmq_msg_t itself: pointers into it do not survive a move
+    inline bool is_inline_message(const zmq::message_t& msg) noexcept
+    {
+        const char* pData = static_cast<const char*>(msg.data());
+        const char* pMsg = reinterpret_cast<const char*>(msg.handle());
+        return pData >= pMsg && pData < pMsg + sizeof(zmq_msg_t);
+    }
+
     inline void publish_message(zmq::socket_t& socket, const std::string& data)
     {
         zmq::message_t msg(data);
         socket.send(msg, zmq::send_flags::none);
     }
 
+    inline constexpr int retry_max_attempts = 3;
+
+    // exponential backoff after a failed attempt: 1ms, 2ms, 4ms...
+    constexpr std::chrono::milliseconds retry_delay(int attempt) noexcept { return std::chrono::milliseconds(1) * (1 << (attempt - 1)); }
+
     template <typename Func>
     std::optional<std::string> retry(Func&& func, const std::function<void(const std::string&)>& log_error)
     {
-        constexpr int max_attempts = 3;
-        constexpr std::chrono::milliseconds base_delay(1);
-        for (int attempt = 1; attempt <= max_attempts; ++attempt)
+        for (int attempt = 1; attempt <= retry_max_attempts; ++attempt)
         {
             if (auto result = func())
             {
@@ -27,14 +66,48 @@ namespace utils
             {
                 std::string error = result.value_or("Unknown error");
                 log_error("Attempt " + std::to_string(attempt) + " failed: " + error);
-                if (attempt == max_attempts)
+                if (attempt == retry_max_attempts)
                 {
                     return std::nullopt;
                 }
-                auto delay = base_delay * (1 << (attempt - 1)); // Exponential backoff
-                std::this_thread::sleep_for(delay);
+                std::this_thread::sleep_for(retry_delay(attempt));
             }
         }
         return std::nullopt;
     }
+
+    // retry() without parking a worker for the backoff: the next attempt is a
+    // timer on the scheduler, run on the pool; on_done gets the result, or
+    // nullopt once every attempt failed
+    template <typename Func, typename Done>
+    void retry_async(coro::Scheduler& scheduler, Func func, std::function<void(const std::string&)> log_error, Done on_done, int attempt = 1)
+    {
+        if (auto result = func())
+            return on_done(std::move(result));
+
+        log_error("Attempt " + std::to_string(attempt) + " failed: Unknown error");
+        if (attempt == retry_max_attempts)
+            return on_done(std::nullopt);
+
+        scheduler.post_after(retry_delay(attempt),
+            [&scheduler, func = std::move(func), log_error = std::move(log_error), on_done = std::move(on_done), attempt]() mutable {
+                retry_async(scheduler, std::move(func), std::move(log_error), std::move(on_done), attempt + 1);
+            });
+    }
+
+    // the same in a coroutine handler: co_await utils::retry_async(func, log_error)
+    template <typename Func>
+    coro::Task<std::optional<std::string>> retry_async(Func func, std::function<void(const std::string&)> log_error)
+    {
+        for (int attempt = 1; ; ++attempt)
+        {
+            if (auto result = func())
+                co_return result;
+
+            log_error("Attempt " + std::to_string(attempt) + " failed: Unknown error");
+            if (attempt == retry_max_attempts)
+                co_return std::nullopt;
+            co_await coro::sleep_for(retry_delay(attempt));
+        }
+    }
 }
\ No newline at end of file
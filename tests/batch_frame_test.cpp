@@ -0,0 +1,149 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+    constexpr TReqID BATCH_ID = 100;
+
+    void append(std::string& out, const auto& value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    // ParamsBase { BATCH_ID, RPC_Batch } | count, without records
+    std::string batch_header(TBatchCount count)
+    {
+        std::string frame;
+        append(frame, ParamsBase { BATCH_ID, (TMethodID)MethodID::RPC_Batch });
+        append(frame, count);
+        return frame;
+    }
+
+    // a well formed batch of the given records
+    std::string batch(std::initializer_list<std::string_view> records)
+    {
+        std::string frame = batch_header((TBatchCount)records.size());
+        for (std::string_view record : records)
+        {
+            append(frame, (TRecordSize)record.size());
+            frame += record;
+        }
+        return frame;
+    }
+
+    template<MethodID MID>
+    std::string record(TReqID req_id, const Payload<MID>& payload, TClientID client_id = 0, bool timed = false)
+    {
+        return std::string(encode_request<MID>(req_id, payload, client_id, timed).to_string_view());
+    }
+
+    bool inside(std::string_view view, std::string_view frame)
+    {
+        return view.data() >= frame.data() && view.data() + view.size() <= frame.data() + frame.size();
+    }
+}
+
+TEST(BatchFrame, SplitsRecordsIntoViewsOfTheFrame)
+{
+    const std::string start = record<MethodID::GStreamer_Pipeline_Start>(1, { "videotestsrc ! fakesink" });
+    const std::string stop = record<MethodID::GStreamer_Pipeline_Stop>(2, { 7 }, 42, true);
+    const std::string list = record<MethodID::GStreamer_Pipeline_List>(3, {});
+    const std::string frame = batch({ start, stop, list });
+
+    std::vector<std::string_view> records;
+    ASSERT_TRUE(decode_batch(frame, records));
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0], start);
+    EXPECT_EQ(records[1], stop);
+    EXPECT_EQ(records[2], list);
+    for (std::string_view r : records) EXPECT_TRUE(inside(r, frame));
+
+    // each record carries its own header and flags
+    RequestHeader header;
+    ASSERT_TRUE(read_header(records[1], header));
+    EXPECT_EQ(header.base.req_id, 2u);
+    EXPECT_EQ(header.method(), MethodID::GStreamer_Pipeline_Stop);
+    EXPECT_EQ(header.client_id, 42u);
+    EXPECT_TRUE(header.timed);
+    EXPECT_EQ(Payload<MethodID::GStreamer_Pipeline_Stop>::decode(records[1].substr(header.size)).pipeline_id, 7u);
+
+    ASSERT_TRUE(read_header(records[0], header));
+    EXPECT_EQ(header.client_id, 0u);
+    EXPECT_EQ(Payload<MethodID::GStreamer_Pipeline_Start>::decode(records[0].substr(header.size)).pipeline_config, "videotestsrc ! fakesink");
+}
+
+TEST(BatchFrame, AcceptsAnEmptyBatch)
+{
+    std::vector<std::string_view> records { "stale" };
+    EXPECT_TRUE(decode_batch(batch_header(0), records));
+    EXPECT_TRUE(records.empty());
+}
+
+TEST(BatchFrame, RejectsATruncatedHeader)
+{
+    const std::string frame = batch_header(0);
+    std::vector<std::string_view> records;
+    for (size_t len = 0; len < frame.size(); ++len)
+        EXPECT_FALSE(decode_batch(std::string_view(frame).substr(0, len), records)) << len;
+}
+
+TEST(BatchFrame, RejectsACountTheFrameCannotHold)
+{
+    const std::string list = record<MethodID::GStreamer_Pipeline_List>(1, {});
+    std::string frame = batch({ list, list });
+    std::vector<std::string_view> records;
+    ASSERT_TRUE(decode_batch(frame, records));
+
+    // one more than there are records, and one no frame can hold: rejected before anything is reserved
+    for (TBatchCount count : { TBatchCount(3), TBatchCount(UINT32_MAX) })
+    {
+        std::memcpy(frame.data() + sizeof(ParamsBase), &count, sizeof(count));
+        EXPECT_FALSE(decode_batch(frame, records)) << count;
+    }
+}
+
+TEST(BatchFrame, RejectsTruncatedRecords)
+{
+    const std::string frame = batch({ record<MethodID::GStreamer_Pipeline_Start>(1, { "a ! b" }),
+                                      record<MethodID::GStreamer_Pipeline_Stop>(2, { 3 }) });
+    std::vector<std::string_view> records;
+    ASSERT_TRUE(decode_batch(frame, records));
+
+    // every cut, whether inside a size field or a record, breaks the layout
+    for (size_t len = batch_header(0).size(); len < frame.size(); ++len)
+        EXPECT_FALSE(decode_batch(std::string_view(frame).substr(0, len), records)) << len;
+}
+
+TEST(BatchFrame, RejectsOversizedAndUndersizedRecords)
+{
+    const std::string stop = record<MethodID::GStreamer_Pipeline_Stop>(1, { 3 });
+    std::vector<std::string_view> records;
+
+    // a size running past the end of the frame
+    std::string frame = batch({ stop });
+    const TRecordSize oversized = TRecordSize(stop.size() + 1);
+    std::memcpy(frame.data() + batch_header(0).size(), &oversized, sizeof(oversized));
+    EXPECT_FALSE(decode_batch(frame, records));
+
+    const TRecordSize huge = UINT32_MAX;
+    std::memcpy(frame.data() + batch_header(0).size(), &huge, sizeof(huge));
+    EXPECT_FALSE(decode_batch(frame, records));
+
+    // a record too short for its ParamsBase
+    EXPECT_FALSE(decode_batch(batch({ std::string_view(stop).substr(0, sizeof(ParamsBase) - 1) }), records));
+    EXPECT_FALSE(decode_batch(batch({ stop, "" }), records));
+    EXPECT_TRUE(decode_batch(batch({ std::string_view(stop).substr(0, sizeof(ParamsBase)) }), records));
+}
+
+TEST(BatchFrame, RejectsTrailingBytes)
+{
+    const std::string stop = record<MethodID::GStreamer_Pipeline_Stop>(1, { 3 });
+    std::vector<std::string_view> records;
+    EXPECT_FALSE(decode_batch(batch({ stop }) + '\0', records));
+
+    // a record the count leaves out
+    std::string frame = batch({ stop, stop });
+    const TBatchCount one = 1;
+    std::memcpy(frame.data() + sizeof(ParamsBase), &one, sizeof(one));
+    EXPECT_FALSE(decode_batch(frame, records));
+}
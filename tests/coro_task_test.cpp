@@ -0,0 +1,195 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    // the pool a handler's coroutine runs on, and the scheduler that resumes it there
+    struct Executor
+    {
+        BS::thread_pool<> pool { 2 };
+        coro::Scheduler scheduler { pool };
+    };
+
+    // runs task to completion as the dispatcher does, from a top-level coroutine, and hands out its result
+    template<typename T>
+    coro::Detached complete(coro::Task<T> task, std::promise<T>& result)
+    {
+        try
+        {
+            result.set_value(co_await std::move(task));
+        }
+        catch (...)
+        {
+            result.set_exception(std::current_exception());
+        }
+    }
+
+    template<typename T>
+    std::future<T> start(Executor& executor, coro::Task<T> task, std::promise<T>& result)
+    {
+        std::future<T> future = result.get_future();
+        complete(std::move(task), result).start(executor.scheduler);
+        return future;
+    }
+
+    bool on_pool() { return BS::this_thread::get_index().has_value(); }
+
+    coro::Task<bool> sleep_then_report(coro::Clock::duration delay)
+    {
+        co_await coro::sleep_for(delay);
+        co_return on_pool();
+    }
+
+    coro::Task<int> add(int a, int b)
+    {
+        co_await coro::yield();
+        co_return a + b;
+    }
+
+    coro::Task<int> sum_of_three()
+    {
+        const int ab = co_await add(1, 2);
+        co_return co_await add(ab, 3);
+    }
+
+    coro::Task<int> fails()
+    {
+        co_await coro::yield();
+        throw std::runtime_error("handler failed");
+    }
+
+    coro::Task<bool> wait_for_capacity()
+    {
+        co_await coro::outgoing_capacity();
+        co_return true;
+    }
+}
+
+TEST(CoroTask, SleepResumesOnThePoolAfterTheDelay)
+{
+    Executor executor;
+    std::promise<bool> result;
+    const auto started = coro::Clock::now();
+    auto future = start(executor, sleep_then_report(20ms), result);
+
+    ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+    EXPECT_GE(coro::Clock::now() - started, 20ms);
+    EXPECT_TRUE(future.get());
+    EXPECT_EQ(executor.scheduler.pending_timers(), 0u);
+}
+
+TEST(CoroTask, ReturnsValuesThroughNestedTasks)
+{
+    Executor executor;
+    std::promise<int> result;
+    auto future = start(executor, sum_of_three(), result);
+    ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(future.get(), 6);
+}
+
+TEST(CoroTask, RethrowsIntoTheAwaiter)
+{
+    Executor executor;
+    std::promise<int> result;
+    auto future = start(executor, fails(), result);
+    ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+
+TEST(CoroTask, ManySuspendedCoroutinesHoldNoThread)
+{
+    // frames come from the slab and are freed on whichever worker finishes them
+    constexpr int COROUTINES = 1000;
+    Executor executor;
+    std::vector<std::promise<bool>> results(COROUTINES);
+    std::vector<std::future<bool>> futures;
+    for (auto& result : results) futures.push_back(start(executor, sleep_then_report(10ms), result));
+
+    for (auto& future : futures)
+    {
+        ASSERT_EQ(future.wait_for(10s), std::future_status::ready);
+        EXPECT_TRUE(future.get());
+    }
+}
+
+TEST(CoroTask, CancelledTimerDoesNotFire)
+{
+    Executor executor;
+    std::atomic<bool> bFired = false;
+    const auto id = executor.scheduler.post_after(10ms, [&bFired] { bFired = true; });
+    EXPECT_TRUE(executor.scheduler.cancel(id));
+    EXPECT_FALSE(executor.scheduler.cancel(id));
+    EXPECT_EQ(executor.scheduler.pending_timers(), 0u);
+    std::this_thread::sleep_for(30ms);
+    executor.pool.wait();
+    EXPECT_FALSE(bFired);
+}
+
+TEST(CoroTask, WaitsForOutgoingCapacityUntilTheBacklogDrains)
+{
+    Executor executor;
+    std::atomic<size_t> nDepth = 5;
+    executor.scheduler.set_backlog([&nDepth] { return nDepth.load(); }, 2);
+
+    std::promise<bool> result;
+    auto future = start(executor, wait_for_capacity(), result);
+    EXPECT_EQ(future.wait_for(50ms), std::future_status::timeout);
+
+    // drained, but not below the limit yet
+    nDepth = 2;
+    executor.scheduler.on_backlog_drained();
+    EXPECT_EQ(future.wait_for(50ms), std::future_status::timeout);
+
+    nDepth = 1;
+    executor.scheduler.on_backlog_drained();
+    ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+    EXPECT_TRUE(future.get());
+
+    // with room, the awaiter does not suspend at all
+    std::promise<bool> immediate;
+    EXPECT_EQ(start(executor, wait_for_capacity(), immediate).wait_for(0s), std::future_status::ready);
+}
+
+TEST(CoroTask, ShutdownFiresPendingTimersAtOnce)
+{
+    Executor executor;
+    std::promise<bool> result;
+    auto future = start(executor, sleep_then_report(1h), result);
+    EXPECT_EQ(future.wait_for(20ms), std::future_status::timeout);
+    EXPECT_EQ(executor.scheduler.pending_timers(), 1u);
+
+    executor.scheduler.shutdown();
+    EXPECT_TRUE(executor.scheduler.stopping());
+    EXPECT_EQ(executor.scheduler.pending_timers(), 0u);
+    ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+    EXPECT_TRUE(future.get());
+
+    // and timers scheduled afterwards are posted right away
+    std::promise<bool> late;
+    auto lateFuture = start(executor, sleep_then_report(1h), late);
+    ASSERT_EQ(lateFuture.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(executor.scheduler.pending_timers(), 0u);
+}
+
+TEST(CoroTask, ShutdownReleasesTheCapacityWaiters)
+{
+    Executor executor;
+    executor.scheduler.set_backlog([] { return size_t(100); }, 1);
+
+    std::promise<bool> result;
+    auto future = start(executor, wait_for_capacity(), result);
+    EXPECT_EQ(future.wait_for(20ms), std::future_status::timeout);
+
+    // nobody drains the backlog any more: the waiters go on, and no new ones wait
+    executor.scheduler.shutdown();
+    ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+    std::promise<bool> after;
+    EXPECT_EQ(start(executor, wait_for_capacity(), after).wait_for(0s), std::future_status::ready);
+}
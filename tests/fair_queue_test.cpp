@@ -0,0 +1,166 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <latch>
+#include <optional>
+#include <vector>
+
+namespace
+{
+    // holds the window: a task blocked until open() is called
+    struct Gate
+    {
+        std::latch latch { 1 };
+        void open() { latch.count_down(); }
+        FairQueue::Task task() { return [this] { latch.wait(); }; }
+    };
+
+    // what pump() does on every wake, until nothing is left
+    void run_all(FairQueue& queue, BS::thread_pool<>& pool)
+    {
+        while (queue.queued() || queue.in_flight())
+        {
+            pool.wait();
+            queue.pump();
+        }
+    }
+
+    FairQueue::Options options(size_t window)
+    {
+        FairQueue::Options result;
+        result.enabled = true;
+        result.window = window;
+        return result;
+    }
+}
+
+TEST(FairQueue, SharesTheWindowByWeight)
+{
+    BS::thread_pool<> pool(1);
+    Doorbell wake;
+    auto opts = options(1);
+    opts.clients[1] = { .weight = 3 };
+    FairQueue queue(pool, wake, opts);
+
+    Gate gate;
+    std::vector<TClientID> order;   // the single worker runs the tasks in send order
+    ASSERT_TRUE(queue.push(99, gate.task()));
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(queue.push(1, [&order] { order.push_back(1); }));
+        ASSERT_TRUE(queue.push(2, [&order] { order.push_back(2); }));
+    }
+    EXPECT_EQ(queue.queued(), 8u);
+    EXPECT_EQ(queue.in_flight(), 1u);
+
+    gate.open();
+    run_all(queue, pool);
+    EXPECT_EQ(order, (std::vector<TClientID> { 1, 1, 1, 2, 1, 2, 2, 2 }));
+}
+
+TEST(FairQueue, CapsAClientsRequestsInFlight)
+{
+    BS::thread_pool<> pool(4);
+    Doorbell wake;
+    auto opts = options(4);
+    opts.defaults.max_in_flight = 1;
+    FairQueue queue(pool, wake, opts);
+
+    Gate gate;
+    for (int i = 0; i < 3; ++i) ASSERT_TRUE(queue.push(1, gate.task()));
+    EXPECT_EQ(queue.in_flight(), 1u);
+    EXPECT_EQ(queue.queued(), 2u);
+
+    // a capped client does not hold the window against the others
+    ASSERT_TRUE(queue.push(2, gate.task()));
+    EXPECT_EQ(queue.in_flight(), 2u);
+    EXPECT_EQ(queue.queued(), 2u);
+
+    gate.open();
+    run_all(queue, pool);
+    EXPECT_EQ(queue.in_flight(), 0u);
+}
+
+TEST(FairQueue, RefusesBeyondAClientsQueueBound)
+{
+    BS::thread_pool<> pool(1);
+    Doorbell wake;
+    auto opts = options(1);
+    opts.max_queued = 2;
+    FairQueue queue(pool, wake, opts);
+
+    Gate gate;
+    int nRun = 0;
+    ASSERT_TRUE(queue.push(99, gate.task()));
+    EXPECT_TRUE(queue.push(1, [&nRun] { ++nRun; }));
+    EXPECT_TRUE(queue.push(1, [&nRun] { ++nRun; }));
+    EXPECT_FALSE(queue.push(1, [&nRun] { ++nRun; }));
+    EXPECT_EQ(queue.rejected(), 1u);
+    // the overload of one client only fills its own queue
+    EXPECT_TRUE(queue.push(2, [&nRun] { ++nRun; }));
+
+    gate.open();
+    run_all(queue, pool);
+    EXPECT_EQ(nRun, 3);
+}
+
+TEST(FairQueue, FlushSendsEverythingRegardlessOfTheWindow)
+{
+    BS::thread_pool<> pool(1);
+    Doorbell wake;
+    FairQueue queue(pool, wake, options(1));
+
+    Gate gate;
+    int nRun = 0;
+    ASSERT_TRUE(queue.push(99, gate.task()));
+    for (TClientID id : { 1, 2, 3 }) ASSERT_TRUE(queue.push(id, [&nRun] { ++nRun; }));
+    queue.flush();
+    EXPECT_EQ(queue.queued(), 0u);
+    EXPECT_EQ(queue.in_flight(), 4u);
+
+    gate.open();
+    pool.wait();
+    EXPECT_EQ(nRun, 3);
+    EXPECT_EQ(queue.in_flight(), 0u);
+}
+
+TEST(FairQueue, HeldSlotKeepsItsPlaceUntilDestroyed)
+{
+    BS::thread_pool<> pool(1);
+    Doorbell wake;
+    FairQueue queue(pool, wake, options(1));
+
+    std::optional<FairQueue::Slot> held;
+    ASSERT_TRUE(queue.push(1, [&held] { held.emplace(FairQueue::hold_slot()); }));
+    ASSERT_TRUE(queue.push(1, [] { }));
+    pool.wait();
+    queue.pump();
+    EXPECT_EQ(queue.in_flight(), 1u);
+    EXPECT_EQ(queue.queued(), 1u);
+
+    held.reset();
+    EXPECT_EQ(queue.in_flight(), 0u);
+    run_all(queue, pool);
+    EXPECT_EQ(queue.queued(), 0u);
+
+    // outside a task the queue started there is nothing to hold
+    FairQueue::Slot none = FairQueue::hold_slot();
+    EXPECT_EQ(queue.in_flight(), 0u);
+}
+
+TEST(FairQueue, ParsesClientLimits)
+{
+    FairQueue::Options opts;
+    EXPECT_TRUE(opts.parse_clients("1:4:8,2:1"));
+    ASSERT_EQ(opts.clients.size(), 2u);
+    EXPECT_EQ(opts.clients[1].weight, 4u);
+    EXPECT_EQ(opts.clients[1].max_in_flight, 8u);
+    EXPECT_EQ(opts.clients[2].weight, 1u);
+    EXPECT_EQ(opts.clients[2].max_in_flight, 0u);
+
+    FairQueue::Options bad;
+    EXPECT_FALSE(bad.parse_clients("3:2,x:1,4,5:"));
+    ASSERT_EQ(bad.clients.size(), 1u);
+    EXPECT_EQ(bad.clients[3].weight, 2u);
+}
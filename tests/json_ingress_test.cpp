@@ -0,0 +1,134 @@
+#include "headers.hpp"
+#include "json_ingress.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+namespace
+{
+    // what handle_incoming_json does: parses a padded copy of text and decodes "params" into payload;
+    // string params are views into frame
+    template<MethodID MID>
+    simdjson::error_code decode(std::string_view text, zmq::message_t& frame, Payload<MID>& payload)
+    {
+        thread_local simdjson::ondemand::parser parser;
+        frame = json_ingress::make_parseable(zmq::message_t(text.data(), text.size()));
+        simdjson::ondemand::document doc;
+        simdjson::ondemand::object request, params;
+        if (auto err = parser.iterate(static_cast<const char*>(frame.data()), frame.size(), frame.size() + simdjson::SIMDJSON_PADDING).get(doc)) return err;
+        if (auto err = doc.get_object().get(request)) return err;
+        if (auto err = request.find_field_unordered("params").get_object().get(params)) return err;
+        return json_ingress::decode_payload<MID>(params, payload);
+    }
+
+    std::string start_request(std::string_view quoted_config)
+    {
+        return R"({"jsonrpc":"2.0","id":1,"method":"GStreamer_Pipeline_Start","params":{"pipeline_config":)"
+            + std::string(quoted_config) + "}}";
+    }
+
+    bool inside(std::string_view view, const zmq::message_t& frame)
+    {
+        const char* begin = static_cast<const char*>(frame.data());
+        return view.data() >= begin && view.data() + view.size() <= begin + frame.size();
+    }
+}
+
+TEST(JsonIngress, ParsesACopyPaddedWithZeros)
+{
+    const std::string text = start_request(R"("a\tb")");
+    zmq::message_t received(text.data(), text.size());
+    zmq::message_t frame = json_ingress::make_parseable(std::move(received));
+
+    ASSERT_EQ(frame.size(), text.size());
+    EXPECT_NE(frame.data(), received.data());
+    EXPECT_EQ(frame.to_string_view(), text);
+    const char* pPadding = static_cast<const char*>(frame.data()) + frame.size();
+    for (size_t i = 0; i < simdjson::SIMDJSON_PADDING; ++i) ASSERT_EQ(pPadding[i], 0) << i;
+    // make_parseable() only copies from it: the received frame, which zmq may share, is left as it was
+    EXPECT_EQ(received.to_string_view(), text);
+}
+
+TEST(JsonIngress, KeepsAnUnescapedStringAsAViewIntoTheFrame)
+{
+    zmq::message_t frame;
+    Payload<MethodID::GStreamer_Pipeline_Start> payload;
+    ASSERT_EQ(decode(start_request(R"("videotestsrc ! autovideosink")"), frame, payload), simdjson::SUCCESS);
+    EXPECT_EQ(payload.pipeline_config, "videotestsrc ! autovideosink");
+    EXPECT_TRUE(inside(payload.pipeline_config, frame));
+}
+
+TEST(JsonIngress, UnescapesStringsInPlace)
+{
+    struct Case { std::string_view json; std::string_view expected; };
+    const Case cases[] = {
+        { R"("a \"quoted\" \\ path")", "a \"quoted\" \\ path" },
+        { R"("tab\there\nnewline\r\b\f\/")", "tab\there\nnewline\r\b\f/" },
+        { R"("caf\u00e9 \ud83c\udfa5")", "caf\xc3\xa9 \xf0\x9f\x8e\xa5" },
+        { R"("\"")", "\"" },
+        { R"("")", "" },
+        // whitespace between the closing quote and the next structural
+        { "\"x\\ty\"   \n ", "x\ty" },
+    };
+    for (const Case& c : cases)
+    {
+        zmq::message_t frame;
+        Payload<MethodID::GStreamer_Pipeline_Start> payload;
+        ASSERT_EQ(decode(start_request(c.json), frame, payload), simdjson::SUCCESS) << c.json;
+        EXPECT_EQ(payload.pipeline_config, c.expected) << c.json;
+        EXPECT_TRUE(inside(payload.pipeline_config, frame)) << c.json;
+    }
+}
+
+TEST(JsonIngress, UnescapesLongStringsAcrossParserBlocks)
+{
+    // escapes scattered over several of simdjson's 64 byte blocks
+    std::string json = "\"", expected;
+    for (int i = 0; i < 300; ++i)
+    {
+        if (i % 37 == 0) { json += R"(\")"; expected += '"'; }
+        else if (i % 53 == 0) { json += R"(\\)"; expected += '\\'; }
+        else if (i % 61 == 0) { json += R"(\n)"; expected += '\n'; }
+        else { json += char('a' + i % 26); expected += char('a' + i % 26); }
+    }
+    json += '"';
+
+    zmq::message_t frame;
+    Payload<MethodID::GStreamer_Pipeline_Start> payload;
+    ASSERT_EQ(decode(start_request(json), frame, payload), simdjson::SUCCESS);
+    EXPECT_EQ(payload.pipeline_config, expected);
+    EXPECT_TRUE(inside(payload.pipeline_config, frame));
+}
+
+TEST(JsonIngress, DecodesPipelineIdsInRange)
+{
+    auto decode_id = [](std::string_view id, TPipelineID& out) {
+        zmq::message_t frame;
+        Payload<MethodID::GStreamer_Pipeline_Stop> payload {};
+        const auto err = decode(R"({"jsonrpc":"2.0","id":2,"method":"GStreamer_Pipeline_Stop","params":{"pipeline_id":)" + std::string(id) + "}}", frame, payload);
+        out = payload.pipeline_id;
+        return err;
+    };
+    TPipelineID id = 0;
+    EXPECT_EQ(decode_id("3", id), simdjson::SUCCESS);
+    EXPECT_EQ(id, 3u);
+    EXPECT_EQ(decode_id("4294967295", id), simdjson::SUCCESS);
+    EXPECT_EQ(id, UINT32_MAX);
+    EXPECT_EQ(decode_id("4294967296", id), simdjson::NUMBER_OUT_OF_RANGE);
+    EXPECT_NE(decode_id("-1", id), simdjson::SUCCESS);
+    EXPECT_NE(decode_id("\"3\"", id), simdjson::SUCCESS);
+    EXPECT_NE(decode_id("1.5", id), simdjson::SUCCESS);
+}
+
+TEST(JsonIngress, DecodesResendIdsAndReportsMissingParams)
+{
+    zmq::message_t frame;
+    Payload<MethodID::RPC_Resend> resend {};
+    ASSERT_EQ(decode(R"({"jsonrpc":"2.0","id":3,"method":"rpc.resend","params":{"req_id":18446744073709551615}})", frame, resend), simdjson::SUCCESS);
+    EXPECT_EQ(resend.req_id, UINT64_MAX);
+
+    Payload<MethodID::GStreamer_Pipeline_Status> status {};
+    EXPECT_EQ(decode(R"({"jsonrpc":"2.0","id":4,"method":"GStreamer_Pipeline_Status","params":{"pipeline":1}})", frame, status), simdjson::NO_SUCH_FIELD);
+}
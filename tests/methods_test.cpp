@@ -0,0 +1,82 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+// the pipeline handlers share the process wide pipeline table: every test stops what it starts
+namespace
+{
+    template<MethodID MID>
+    auto call(TPipelineID pipeline_id)
+    {
+        MethodParams<MID> params {};
+        params.pipeline_id = pipeline_id;
+        return handleMethod<MID>(params);
+    }
+
+    TPipelineID start()
+    {
+        MethodParams<MethodID::GStreamer_Pipeline_Start> params {};
+        return handleMethod<MethodID::GStreamer_Pipeline_Start>(params).pipeline_id;
+    }
+
+    PipelineState state_of(TPipelineID pipeline_id)
+    {
+        return call<MethodID::GStreamer_Pipeline_Status>(pipeline_id).state;
+    }
+
+    bool listed(TPipelineID pipeline_id)
+    {
+        MethodParams<MethodID::GStreamer_Pipeline_List> params {};
+        const auto result = handleMethod<MethodID::GStreamer_Pipeline_List>(params);
+        return std::ranges::any_of(result.pipelines, [pipeline_id](const auto& item) { return item.first == pipeline_id; });
+    }
+
+    // the JSON-RPC code a handler answered with, 0 when it returned a result
+    template<MethodID MID>
+    int error_of(TPipelineID pipeline_id)
+    {
+        try
+        {
+            call<MID>(pipeline_id);
+            return 0;
+        }
+        catch (const MethodError& e)
+        {
+            return e.code;
+        }
+    }
+}
+
+TEST(PipelineMethods, PauseAndResumeChangeARunningPipeline)
+{
+    const TPipelineID pipeline_id = start();
+    EXPECT_EQ(state_of(pipeline_id), PipelineState::Running);
+
+    EXPECT_EQ(error_of<MethodID::GStreamer_Pipeline_Pause>(pipeline_id), 0);
+    EXPECT_EQ(state_of(pipeline_id), PipelineState::Paused);
+    EXPECT_EQ(error_of<MethodID::GStreamer_Pipeline_Resume>(pipeline_id), 0);
+    EXPECT_EQ(state_of(pipeline_id), PipelineState::Running);
+
+    call<MethodID::GStreamer_Pipeline_Stop>(pipeline_id);
+    EXPECT_EQ(state_of(pipeline_id), PipelineState::Unknown);
+    EXPECT_FALSE(listed(pipeline_id));
+}
+
+TEST(PipelineMethods, PauseAndResumeOfAnUnknownPipelineAddNoGhost)
+{
+    const TPipelineID stopped = start();
+    call<MethodID::GStreamer_Pipeline_Stop>(stopped);
+    const TPipelineID never = stopped ^ PIPELINE_SEQUENCE_MASK;
+    const size_t nBefore = pipeline_count();
+
+    for (TPipelineID pipeline_id : { stopped, never })
+    {
+        EXPECT_EQ(error_of<MethodID::GStreamer_Pipeline_Pause>(pipeline_id), jsonrpc::NO_PIPELINE);
+        EXPECT_EQ(error_of<MethodID::GStreamer_Pipeline_Resume>(pipeline_id), jsonrpc::NO_PIPELINE);
+        EXPECT_EQ(state_of(pipeline_id), PipelineState::Unknown);
+        EXPECT_FALSE(listed(pipeline_id));
+    }
+    EXPECT_EQ(pipeline_count(), nBefore);
+}
@@ -0,0 +1,131 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+    // four CPUs fully usable by the pipelines: 4 cores of budget
+    PipelineBudget::Options four_cores(size_t max_queued = 16)
+    {
+        PipelineBudget::Options options;
+        options.cpus = { 0, 1, 2, 3 };
+        options.max_utilization = 1.0;
+        options.max_queued = max_queued;
+        return options;
+    }
+
+    using Admission = PipelineBudget::Admission;
+}
+
+TEST(PipelineBudget, AdmitsWhileItFitsThenQueuesThenRejects)
+{
+    PipelineBudget budget(four_cores(1));
+    for (const char* id : { "a", "b", "c", "d" }) EXPECT_EQ(budget.admit(id), Admission::Admitted) << id;
+    EXPECT_EQ(budget.admit("e"), Admission::Queued);
+    EXPECT_EQ(budget.admit("f"), Admission::Rejected);
+
+    const auto st = budget.stats();
+    EXPECT_DOUBLE_EQ(st.capacity, 4.0);
+    EXPECT_DOUBLE_EQ(st.committed, 4.0);
+    EXPECT_EQ(st.running, 4u);
+    EXPECT_EQ(st.queued, 1u);
+    EXPECT_EQ(st.admitted, 4u);
+    EXPECT_EQ(st.rejected, 1u);
+
+    // admitting a running pipeline again charges nothing more
+    EXPECT_EQ(budget.admit("a"), Admission::Admitted);
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 4.0);
+}
+
+TEST(PipelineBudget, RejectsAStartLargerThanTheHostEvenWithQueueRoom)
+{
+    PipelineBudget budget(four_cores());
+    EXPECT_EQ(budget.admit("huge", 5.0), Admission::Rejected);
+    EXPECT_EQ(budget.stats().queued, 0u);
+}
+
+TEST(PipelineBudget, AdmitsQueuedStartsInOrderOnRelease)
+{
+    PipelineBudget budget(four_cores());
+    for (const char* id : { "a", "b", "c" }) ASSERT_EQ(budget.admit(id), Admission::Admitted);
+    EXPECT_EQ(budget.admit("x", 2.0), Admission::Queued);
+    // fits, but does not overtake x
+    EXPECT_EQ(budget.admit("y", 1.0), Admission::Queued);
+
+    EXPECT_EQ(budget.release("a"), (std::vector<std::string> { "x" }));
+    EXPECT_EQ(budget.stats().queued, 1u);
+    EXPECT_EQ(budget.release("b"), (std::vector<std::string> { "y" }));
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 4.0);
+}
+
+TEST(PipelineBudget, ReleaseDropsAQueuedStart)
+{
+    PipelineBudget budget(four_cores());
+    ASSERT_EQ(budget.admit("a", 4.0), Admission::Admitted);
+    ASSERT_EQ(budget.admit("q"), Admission::Queued);
+    EXPECT_TRUE(budget.release("q").empty());
+    EXPECT_EQ(budget.stats().queued, 0u);
+    EXPECT_TRUE(budget.release("a").empty());
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 0.0);
+}
+
+TEST(PipelineBudget, MeasuredCostReplacesTheEstimate)
+{
+    PipelineBudget budget(four_cores());
+    ASSERT_EQ(budget.admit("a", 3.0), Admission::Admitted);
+    EXPECT_EQ(budget.admit("b", 2.0), Admission::Queued);
+
+    // measured lighter than estimated: the queued Start fits now
+    budget.report_cpu("a", 0.5);
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 0.5);
+    EXPECT_EQ(budget.admit_queued(), (std::vector<std::string> { "b" }));
+
+    // later measurements are smoothed (0.3 of the new one)
+    budget.report_cpu("a", 1.5);
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 2.0 + 0.3 * 1.5 + 0.7 * 0.5);
+    // running late scales the cost up by the QoS proportion
+    budget.report_qos("a", 2.0);
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 2.0 + 2 * 0.8);
+
+    budget.release("a");
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 2.0);
+    // reports for pipelines that do not run are ignored
+    budget.report_cpu("a", 3.0);
+    EXPECT_DOUBLE_EQ(budget.stats().committed, 2.0);
+}
+
+TEST(PipelineBudget, PlacesPipelinesOnTheLeastLoadedCpus)
+{
+    PipelineBudget budget(four_cores());
+    ASSERT_EQ(budget.admit("a"), Admission::Admitted);
+    ASSERT_EQ(budget.admit("b"), Admission::Admitted);
+
+    std::vector<unsigned> a = budget.placement("a"), b = budget.placement("b");
+    ASSERT_FALSE(a.empty());
+    ASSERT_FALSE(b.empty());
+    std::ranges::sort(a);
+    std::ranges::sort(b);
+    std::vector<unsigned> shared;
+    std::ranges::set_intersection(a, b, std::back_inserter(shared));
+    EXPECT_TRUE(shared.empty());
+
+    budget.release("a");
+    EXPECT_TRUE(budget.placement("a").empty());
+}
+
+TEST(ThreadCpuMeter, MeasuresTheCpuTimeOfItsThreads)
+{
+    ThreadCpuMeter meter;
+    meter.add_current_thread();
+    EXPECT_EQ(meter.sample(), 0.0);
+
+    const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(30);
+    while (std::chrono::steady_clock::now() < until) { }
+    const double cores = meter.sample();
+    EXPECT_GT(cores, 0.1);
+    EXPECT_LT(cores, 1.5);
+    meter.remove_current_thread();
+}
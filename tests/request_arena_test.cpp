@@ -0,0 +1,84 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace
+{
+    bool aligned(const void* p, size_t alignment) { return reinterpret_cast<uintptr_t>(p) % alignment == 0; }
+}
+
+TEST(RequestArena, RewindsToTheSameMemoryOnRelease)
+{
+    RequestArena arena;
+    void* pFirst = arena.allocate(100);
+    void* pSecond = arena.allocate(100);
+    EXPECT_NE(pFirst, pSecond);
+
+    arena.release();
+    EXPECT_EQ(arena.allocate(100), pFirst);
+    EXPECT_EQ(arena.allocate(100), pSecond);
+}
+
+TEST(RequestArena, KeepsGrownBlocksForTheNextRequest)
+{
+    RequestArena arena;
+    (void)arena.allocate(RequestArena::FIRST_BLOCK_SIZE / 2);
+    void* pLarge = arena.allocate(4 * RequestArena::FIRST_BLOCK_SIZE);
+
+    arena.release();
+    (void)arena.allocate(RequestArena::FIRST_BLOCK_SIZE / 2);
+    EXPECT_EQ(arena.allocate(4 * RequestArena::FIRST_BLOCK_SIZE), pLarge);
+}
+
+TEST(RequestArena, HonoursTheRequestedAlignment)
+{
+    RequestArena arena;
+    for (size_t alignment : { 1, 2, 8, 16, 64, 256 })
+    {
+        (void)arena.allocate(1, 1);
+        EXPECT_TRUE(aligned(arena.allocate(24, alignment), alignment)) << alignment;
+    }
+    // a fresh block for an over-aligned request larger than the rest of the current one
+    EXPECT_TRUE(aligned(arena.allocate(RequestArena::FIRST_BLOCK_SIZE, 4096), 4096));
+}
+
+TEST(RequestArena, ServesAllocatorAwareContainers)
+{
+    RequestArena arena;
+    {
+        std::pmr::vector<uint64_t> values(&arena);
+        for (uint64_t i = 0; i < 100'000; ++i) values.push_back(i);
+        EXPECT_EQ(values.size(), 100'000u);
+        EXPECT_EQ(values.back(), 99'999u);
+    }
+
+    // past MAX_RETAINED the arena gives its extra blocks back, and still serves the next request
+    arena.release();
+    std::pmr::string text(4096, 'x', &arena);
+    EXPECT_EQ(text.size(), 4096u);
+}
+
+TEST(RequestArena, LeaseReturnsTheArenaToTheThreadCache)
+{
+    RequestArena* pArena = nullptr;
+    void* pFirst = nullptr;
+    {
+        RequestArena::Lease lease = RequestArena::acquire();
+        pArena = lease.get();
+        ASSERT_NE(pArena, nullptr);
+        pFirst = pArena->allocate(64);
+        (void)pArena->allocate(512);
+    }
+    RequestArena::Lease lease = RequestArena::acquire();
+    EXPECT_EQ(lease.get(), pArena);
+    // released when the last lease ended
+    EXPECT_EQ(lease.get()->allocate(64), pFirst);
+
+    // while it is leased, another request gets an arena of its own
+    RequestArena::Lease other = RequestArena::acquire();
+    EXPECT_NE(other.get(), lease.get());
+}
@@ -0,0 +1,92 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+    class RequestJournalTest : public ::testing::Test
+    {
+    protected:
+        void TearDown() override { std::filesystem::remove(m_path); }
+
+        std::string m_path = (std::filesystem::temp_directory_path()
+            / ("request_journal_test." + std::to_string(::getpid()) + ".journal")).string();
+    };
+}
+
+TEST_F(RequestJournalTest, ReplaysFramesInOrderWithChannelAndTime)
+{
+    const std::string binary("\x01\x00\x00\x00\x00\x00\x00\x00\x03", 9);
+    const std::string json = R"({"jsonrpc":"2.0","id":7,"method":"GStreamer_Pipeline_List"})";
+    {
+        RequestJournal capture(m_path, 1 << 20);
+        EXPECT_TRUE(capture.append(journal::Channel::Binary, binary.data(), binary.size(), 100));
+        EXPECT_TRUE(capture.append(journal::Channel::Json, json.data(), json.size(), 250));
+        EXPECT_TRUE(capture.append(journal::Channel::Binary, "", 0, 300));
+        EXPECT_EQ(capture.count(), 3u);
+        EXPECT_EQ(capture.dropped(), 0u);
+    }
+
+    JournalReader replay(m_path);
+    ASSERT_EQ(replay.size(), 3u);
+    EXPECT_EQ(replay[0].received_at, 100u);
+    EXPECT_EQ(replay[0].channel, journal::Channel::Binary);
+    EXPECT_EQ(replay[0].frame, binary);
+    EXPECT_EQ(replay[1].received_at, 250u);
+    EXPECT_EQ(replay[1].channel, journal::Channel::Json);
+    EXPECT_EQ(replay[1].frame, json);
+    EXPECT_EQ(replay[2].frame.size(), 0u);
+}
+
+TEST_F(RequestJournalTest, HeaderRecordsTheEightByteAlignedLayout)
+{
+    {
+        RequestJournal capture(m_path, 1 << 20);
+        capture.append(journal::Channel::Binary, "123456789", 9, 1);     // padded to 16
+        capture.append(journal::Channel::Json, "12345678", 8, 2);        // exactly 8
+    }
+
+    journal::Header header {};
+    std::ifstream file(m_path, std::ios::binary);
+    ASSERT_TRUE(file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+    EXPECT_EQ(header.magic, journal::Header::MAGIC);
+    EXPECT_EQ(header.version, journal::Header::VERSION);
+    EXPECT_EQ(header.header_size, sizeof(journal::Header));
+    EXPECT_EQ(header.capacity, std::filesystem::file_size(m_path));
+    EXPECT_EQ(header.count, 2u);
+    EXPECT_EQ(header.data_end, sizeof(journal::Header) + 16 + 8);
+}
+
+TEST_F(RequestJournalTest, StaysFullAfterTheFirstFrameThatDoesNotFit)
+{
+    const std::string large(1000, 'x');
+    RequestJournal capture(m_path, 64 * 1024);
+    while (capture.append(journal::Channel::Binary, large.data(), large.size(), 1)) { }
+    const uint64_t nCaptured = capture.count();
+    EXPECT_GT(nCaptured, 0u);
+    EXPECT_TRUE(capture.full());
+
+    // a small frame would still fit, but a replay must not skip the large one before it
+    EXPECT_FALSE(capture.append(journal::Channel::Json, "{}", 2, 2));
+    EXPECT_EQ(capture.count(), nCaptured);
+    EXPECT_EQ(capture.dropped(), 2u);
+
+    capture.sync();
+    JournalReader replay(m_path);
+    EXPECT_EQ(replay.size(), nCaptured);
+    EXPECT_EQ(replay[nCaptured - 1].frame, large);
+}
+
+TEST_F(RequestJournalTest, ReaderRejectsFilesThatAreNoJournal)
+{
+    {
+        std::ofstream file(m_path, std::ios::binary);
+        file << std::string(4096, 'j');
+    }
+    EXPECT_THROW(JournalReader { m_path }, std::runtime_error);
+}
@@ -0,0 +1,78 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+// ResponseCache is a process wide singleton: every test starts by invalidating the methods it uses
+namespace
+{
+    constexpr TMethodID STATUS = (TMethodID)MethodID::GStreamer_Pipeline_Status;
+    constexpr TMethodID LIST = (TMethodID)MethodID::GStreamer_Pipeline_List;
+    constexpr std::string_view MISS = "<miss>";
+
+    std::string cached(TMethodID method_id, uint64_t key, uint64_t now_ns)
+    {
+        SlabBuffer out;
+        if (!ResponseCache::instance().append_to(method_id, key, now_ns, out)) return std::string(MISS);
+        return std::string(out.view());
+    }
+}
+
+TEST(ResponseCache, ServesStoredResultUntilItExpires)
+{
+    ResponseCache& cache = ResponseCache::instance();
+    cache.invalidate(STATUS);
+    cache.store(STATUS, 7, cache.epoch(STATUS), R"({"state":"Running"})", 1000);
+
+    EXPECT_EQ(cached(STATUS, 7, 999), R"({"state":"Running"})");
+    EXPECT_EQ(cached(STATUS, 8, 999), MISS);
+    EXPECT_EQ(cached(STATUS, 7, 1000), MISS);
+    // the expired entry was dropped, not only skipped
+    EXPECT_EQ(cached(STATUS, 7, 0), MISS);
+}
+
+TEST(ResponseCache, DropsResultComputedBeforeAnInvalidation)
+{
+    ResponseCache& cache = ResponseCache::instance();
+    cache.invalidate(STATUS);
+    const uint64_t epoch = cache.epoch(STATUS);     // read at dispatch
+
+    // a handler changed pipeline 3 while the request ran
+    cache.invalidate(STATUS, 3);
+    EXPECT_NE(cache.epoch(STATUS), epoch);
+    cache.store(STATUS, 3, epoch, "stale", UINT64_MAX);
+    EXPECT_EQ(cached(STATUS, 3, 0), MISS);
+
+    cache.store(STATUS, 3, cache.epoch(STATUS), "fresh", UINT64_MAX);
+    EXPECT_EQ(cached(STATUS, 3, 0), "fresh");
+}
+
+TEST(ResponseCache, InvalidatesPerMethodAndPerKey)
+{
+    ResponseCache& cache = ResponseCache::instance();
+    cache.invalidate(STATUS);
+    cache.invalidate(LIST);
+    cache.store(STATUS, 1, cache.epoch(STATUS), "one", UINT64_MAX);
+    cache.store(STATUS, 2, cache.epoch(STATUS), "two", UINT64_MAX);
+    cache.store(LIST, 0, cache.epoch(LIST), "list", UINT64_MAX);
+
+    const uint64_t statusEpoch = cache.epoch(STATUS);
+    cache.invalidate(LIST);
+    EXPECT_EQ(cache.epoch(STATUS), statusEpoch);
+    EXPECT_EQ(cached(LIST, 0, 0), MISS);
+    EXPECT_EQ(cached(STATUS, 1, 0), "one");
+
+    cache.invalidate(STATUS, 2);
+    EXPECT_EQ(cached(STATUS, 1, 0), "one");
+    EXPECT_EQ(cached(STATUS, 2, 0), MISS);
+}
+
+TEST(ResponseCache, IgnoresMethodsOutOfRange)
+{
+    ResponseCache& cache = ResponseCache::instance();
+    const TMethodID unknown = (TMethodID)MethodID::Unknown;
+    EXPECT_EQ(cache.epoch(unknown), 0u);
+    cache.invalidate(unknown);
+    EXPECT_EQ(cache.epoch(unknown), 0u);
+}
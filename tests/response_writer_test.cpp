@@ -0,0 +1,137 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace
+{
+    // the escaping JSON requires, one byte at a time
+    std::string reference_escape(std::string_view s)
+    {
+        std::string out;
+        for (unsigned char c : s)
+        {
+            switch (c)
+            {
+                case '"':  out += R"(\")"; break;
+                case '\\': out += R"(\\)"; break;
+                case '\n': out += R"(\n)"; break;
+                case '\r': out += R"(\r)"; break;
+                case '\t': out += R"(\t)"; break;
+                case '\b': out += R"(\b)"; break;
+                case '\f': out += R"(\f)"; break;
+                default:
+                    if (c < 0x20) out += fmt::format("\\u{:04x}", c);
+                    else out += char(c);
+            }
+        }
+        return out;
+    }
+
+    std::string escaped(std::string_view s)
+    {
+        SlabBuffer out;
+        JsonWriter::append_escaped(out, s);
+        return std::string(out.view());
+    }
+
+    std::string u64(uint64_t v)
+    {
+        SlabBuffer out;
+        JsonWriter(out).u64(v);
+        return std::string(out.view());
+    }
+
+    std::string i64(int64_t v)
+    {
+        SlabBuffer out;
+        JsonWriter(out).i64(v);
+        return std::string(out.view());
+    }
+}
+
+TEST(JsonWriter, EscapesEverySpecialByteAtEveryChunkPosition)
+{
+    // every byte that needs escaping, at every offset around the 16 byte SIMD chunks and the scalar tail
+    std::string specials = "\"\\";
+    for (char c = 0; c < 0x20; ++c) specials += c;
+    for (size_t length : { 1, 15, 16, 17, 31, 32, 33, 47 })
+        for (size_t pos = 0; pos < length; ++pos)
+            for (char c : specials)
+            {
+                std::string s(length, 'a');
+                s[pos] = c;
+                ASSERT_EQ(escaped(s), reference_escape(s)) << "length " << length << ", byte " << int(c) << " at " << pos;
+            }
+}
+
+TEST(JsonWriter, EscapesRunsOfSpecialBytes)
+{
+    std::string s;
+    for (int i = 0; i < 64; ++i) s += (i % 3 == 0) ? '"' : (i % 3 == 1) ? '\\' : char(i % 0x20);
+    EXPECT_EQ(escaped(s), reference_escape(s));
+    EXPECT_EQ(escaped(std::string(40, '\\')), reference_escape(std::string(40, '\\')));
+}
+
+TEST(JsonWriter, CopiesCleanAndNonAsciiBytesVerbatim)
+{
+    EXPECT_EQ(escaped(""), "");
+    const std::string clean = "GStreamer pipeline: videotestsrc ! autovideosink, 0123456789 ~\x7f";
+    EXPECT_EQ(escaped(clean), clean);
+    // bytes >= 0x80 are not control characters, also not to a signed comparison
+    const std::string utf8 = "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x8e\xa5 \xff\x80\x90\xa0\xb0\xc0\xd0\xe0\xf0";
+    EXPECT_EQ(escaped(utf8), utf8);
+    EXPECT_EQ(escaped(utf8 + "\n" + utf8), utf8 + "\\n" + utf8);
+}
+
+TEST(JsonWriter, WritesUnsignedIntegers)
+{
+    EXPECT_EQ(u64(0), "0");
+    EXPECT_EQ(u64(std::numeric_limits<uint64_t>::max()), "18446744073709551615");
+    // every digit count, at its edges (unsigned wrap-around above 10^19 is fine: any value will do)
+    uint64_t p = 1;
+    for (unsigned nDigits = 1; nDigits <= JsonWriter::MAX_U64_DIGITS; ++nDigits, p *= 10)
+        for (uint64_t v : { p - 1, p, p + 1, 2 * p - 1, 9 * p, 9 * p + p / 2 })
+        {
+            ASSERT_EQ(u64(v), std::to_string(v));
+            ASSERT_EQ(JsonWriter::digits10(v), std::to_string(v).size()) << v;
+        }
+}
+
+TEST(JsonWriter, WritesSignedIntegers)
+{
+    EXPECT_EQ(i64(0), "0");
+    EXPECT_EQ(i64(-1), "-1");
+    EXPECT_EQ(i64(-32602), "-32602");
+    EXPECT_EQ(i64(std::numeric_limits<int64_t>::max()), "9223372036854775807");
+    EXPECT_EQ(i64(std::numeric_limits<int64_t>::min()), "-9223372036854775808");
+}
+
+TEST(JsonRpcFrames, WritesAcksErrorsAndResults)
+{
+    SlabBuffer ack;
+    jsonrpc::write_ack(ack, std::numeric_limits<TReqID>::max());
+    EXPECT_EQ(ack.view(), R"({"jsonrpc":"2.0","ack":1,"id":18446744073709551615})");
+
+    SlabBuffer error;
+    jsonrpc::write_error(error, 7, jsonrpc::INVALID_PARAMS, "bad \"pipeline\"\n");
+    EXPECT_EQ(error.view(), R"({"jsonrpc":"2.0","id":7,"error":{"code":-32602,"message":"bad \"pipeline\"\n"}})");
+
+    SlabBuffer result;
+    jsonrpc::write_result<MethodID::GStreamer_Pipeline_Status>(result, 0, { 42, PipelineState::Paused });
+    EXPECT_EQ(result.view(), R"({"jsonrpc":"2.0","id":0,"result":{"pipeline_id":42,"state":"paused"}})");
+}
+
+TEST(JsonRpcFrames, FillsInThePublishTimeRightAligned)
+{
+    SlabBuffer out;
+    const jsonrpc::RequestTiming timing { 1, 20, 300, 4000 };
+    const size_t offset = jsonrpc::write_result<MethodID::GStreamer_Pipeline_Stop>(out, 5, {}, &timing);
+    ASSERT_NE(offset, 0u);
+    jsonrpc::set_published(out.data() + offset, 50000);
+    EXPECT_EQ(out.view(), std::string(R"({"jsonrpc":"2.0","id":5,"result":null,"timing":{"received":1,"dispatched":20,"started":300,"finished":4000,"published":)")
+        + std::string(jsonrpc::PUBLISHED_WIDTH - 5, ' ') + "50000}}");
+}
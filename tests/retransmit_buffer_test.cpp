@@ -0,0 +1,101 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+    void store(RetransmitBuffer& buffer, size_t shard, TReqID req_id, const std::string& data)
+    {
+        zmq::message_t frame(data.data(), data.size());
+        buffer.store(shard, req_id, frame);
+    }
+
+    // the held frame of req_id, empty when it is not held
+    std::string fetched(RetransmitBuffer& buffer, TReqID req_id)
+    {
+        zmq::message_t out;
+        return buffer.fetch(req_id, out) ? out.to_string() : std::string {};
+    }
+}
+
+TEST(RetransmitBuffer, EvictsTheOldestBeyondMaxResults)
+{
+    RetransmitBuffer buffer({ .max_bytes = 1 << 20, .max_results = 3 });
+    for (TReqID id = 1; id <= 5; ++id) store(buffer, 0, id, "result " + std::to_string(id));
+
+    EXPECT_EQ(fetched(buffer, 1), "");
+    EXPECT_EQ(fetched(buffer, 2), "");
+    EXPECT_EQ(fetched(buffer, 3), "result 3");
+    EXPECT_EQ(fetched(buffer, 5), "result 5");
+
+    const auto st = buffer.stats();
+    EXPECT_EQ(st.results, 3u);
+    EXPECT_EQ(st.evicted, 2u);
+    EXPECT_EQ(st.resent, 2u);
+    EXPECT_EQ(st.misses, 2u);
+}
+
+TEST(RetransmitBuffer, EvictsTheOldestBeyondMaxBytes)
+{
+    RetransmitBuffer buffer({ .max_bytes = 100, .max_results = 100 });
+    for (TReqID id = 1; id <= 4; ++id) store(buffer, 0, id, std::string(40, char('0' + id)));
+
+    EXPECT_EQ(fetched(buffer, 2), "");
+    EXPECT_EQ(fetched(buffer, 3), std::string(40, '3'));
+    EXPECT_EQ(buffer.stats().bytes, 80u);
+
+    // a frame over the limit is not kept, and does not push the others out
+    store(buffer, 0, 5, std::string(101, 'x'));
+    EXPECT_EQ(fetched(buffer, 5), "");
+    EXPECT_EQ(fetched(buffer, 4), std::string(40, '4'));
+}
+
+TEST(RetransmitBuffer, AnswersWithTheLatestResultOfARequest)
+{
+    RetransmitBuffer buffer({ .max_bytes = 1 << 20, .max_results = 3 });
+    store(buffer, 0, 7, "first run");
+    store(buffer, 0, 7, "second run");
+    EXPECT_EQ(fetched(buffer, 7), "second run");
+
+    // evicting the first frame keeps the index of the second
+    store(buffer, 0, 8, "other");
+    store(buffer, 0, 9, "other");
+    EXPECT_EQ(buffer.stats().evicted, 1u);
+    EXPECT_EQ(fetched(buffer, 7), "second run");
+}
+
+TEST(RetransmitBuffer, SplitsTheLimitsAcrossShards)
+{
+    RetransmitBuffer buffer({ .max_bytes = 1 << 20, .max_results = 4 }, 2);
+    EXPECT_EQ(buffer.shard_count(), 2u);
+    for (TReqID id = 1; id <= 3; ++id) store(buffer, 0, id, "worker 0");
+    store(buffer, 1, 10, "worker 1");
+
+    // shard 0 holds its two, shard 1 is not touched by its evictions
+    EXPECT_EQ(fetched(buffer, 1), "");
+    EXPECT_EQ(fetched(buffer, 3), "worker 0");
+    EXPECT_EQ(fetched(buffer, 10), "worker 1");
+    EXPECT_EQ(buffer.stats().results, 3u);
+}
+
+TEST(RetransmitBuffer, PrefersTheLatestFrameAcrossShards)
+{
+    RetransmitBuffer buffer({}, 2);
+    store(buffer, 1, 42, "stale");
+    store(buffer, 0, 42, "fresh");
+    EXPECT_EQ(fetched(buffer, 42), "fresh");
+}
+
+TEST(RetransmitBuffer, KeepsNothingWhenALimitIsZero)
+{
+    for (RetransmitBuffer::Options options : { RetransmitBuffer::Options { .max_bytes = 0 }, RetransmitBuffer::Options { .max_results = 0 } })
+    {
+        RetransmitBuffer buffer(options);
+        EXPECT_FALSE(buffer.enabled());
+        store(buffer, 0, 1, "result");
+        EXPECT_EQ(fetched(buffer, 1), "");
+        EXPECT_EQ(buffer.stats().results, 0u);
+    }
+}
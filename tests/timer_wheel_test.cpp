@@ -0,0 +1,128 @@
+#include "headers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    const TimerWheel::Clock::time_point T0 {};
+
+    // runs the callbacks advance() expired and returns how many there were
+    size_t run_until(TimerWheel& wheel, TimerWheel::Clock::time_point now)
+    {
+        std::vector<TimerWheel::Callback> expired;
+        wheel.advance(now, expired);
+        for (auto& fn : expired) fn();
+        return expired.size();
+    }
+}
+
+TEST(TimerWheel, NeverFiresBeforeTheDeadline)
+{
+    TimerWheel wheel(1ms, T0);
+    wheel.schedule_at(T0 + 5ms, [] { });
+    wheel.schedule_at(T0 + 2500us, [] { });     // rounded up to tick 3
+
+    EXPECT_EQ(run_until(wheel, T0 + 2ms), 0u);
+    EXPECT_EQ(run_until(wheel, T0 + 3ms), 1u);
+    EXPECT_EQ(run_until(wheel, T0 + 4999us), 0u);
+    EXPECT_EQ(run_until(wheel, T0 + 5ms), 1u);
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, ExpiresAcrossLevelsInDeadlineOrder)
+{
+    TimerWheel wheel(1ms, T0);
+    std::vector<int> fired;
+    for (int ms : { 4100, 5, 70, 262'200, 64 })     // levels 2, 0, 1, 3, 1
+        wheel.schedule_at(T0 + std::chrono::milliseconds(ms), [&fired, ms] { fired.push_back(ms); });
+    ASSERT_EQ(wheel.size(), 5u);
+
+    EXPECT_EQ(run_until(wheel, T0 + 300s), 5u);
+    EXPECT_EQ(fired, (std::vector<int> { 5, 64, 70, 4100, 262'200 }));
+}
+
+TEST(TimerWheel, CascadesDoNotFireEarly)
+{
+    TimerWheel wheel(1ms, T0);
+    wheel.schedule_at(T0 + 4100ms, [] { });
+    // every cascade tick up to the deadline
+    for (auto now = T0; now < T0 + 4100ms; now += 64ms)
+        EXPECT_EQ(run_until(wheel, now), 0u);
+    EXPECT_EQ(run_until(wheel, T0 + 4099ms), 0u);
+    EXPECT_EQ(run_until(wheel, T0 + 4100ms), 1u);
+}
+
+TEST(TimerWheel, KeepsTimersBeyondTheTopLevelOnTheOverflowList)
+{
+    TimerWheel wheel(1ms, T0);
+    wheel.schedule_at(T0 + 5h, [] { });
+    EXPECT_EQ(run_until(wheel, T0 + 5h - 1ms), 0u);
+    EXPECT_EQ(run_until(wheel, T0 + 5h), 1u);
+}
+
+TEST(TimerWheel, CancelsByIdOnlyOnce)
+{
+    TimerWheel wheel(1ms, T0);
+    bool bFired = false;
+    const auto id = wheel.schedule_at(T0 + 10ms, [&bFired] { bFired = true; });
+    EXPECT_NE(id, 0u);
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_FALSE(wheel.cancel(id));
+    EXPECT_FALSE(wheel.cancel(0));
+    EXPECT_EQ(run_until(wheel, T0 + 20ms), 0u);
+    EXPECT_FALSE(bFired);
+}
+
+TEST(TimerWheel, StaleIdDoesNotCancelAReusedTimer)
+{
+    TimerWheel wheel(1ms, T0);
+    const auto first = wheel.schedule_at(T0 + 1ms, [] { });
+    EXPECT_EQ(run_until(wheel, T0 + 1ms), 1u);
+
+    const auto second = wheel.schedule_at(T0 + 2ms, [] { });
+    EXPECT_NE(first, second);
+    EXPECT_FALSE(wheel.cancel(first));
+    EXPECT_EQ(wheel.size(), 1u);
+    EXPECT_EQ(run_until(wheel, T0 + 2ms), 1u);
+}
+
+TEST(TimerWheel, SchedulesInThePastForTheNextTick)
+{
+    TimerWheel wheel(1ms, T0);
+    run_until(wheel, T0 + 10ms);
+    wheel.schedule_at(T0 + 3ms, [] { });
+    EXPECT_EQ(run_until(wheel, T0 + 10ms), 0u);
+    EXPECT_EQ(run_until(wheel, T0 + 11ms), 1u);
+}
+
+TEST(TimerWheel, NextExpiryIsNoLaterThanTheEarliestDeadline)
+{
+    TimerWheel wheel(1ms, T0);
+    EXPECT_FALSE(wheel.next_expiry());
+
+    wheel.schedule_at(T0 + 200ms, [] { });
+    ASSERT_TRUE(wheel.next_expiry());
+    EXPECT_LE(*wheel.next_expiry(), T0 + 200ms);
+
+    wheel.schedule_at(T0 + 7ms, [] { });
+    EXPECT_EQ(wheel.next_expiry(), T0 + 7ms);
+}
+
+TEST(TimerWheel, DrainsEveryPendingCallback)
+{
+    TimerWheel wheel(1ms, T0);
+    int nRun = 0;
+    for (auto due : { 1ms, 100ms, 10'000ms })
+        wheel.schedule_at(T0 + due, [&nRun] { ++nRun; });
+
+    std::vector<TimerWheel::Callback> pending;
+    EXPECT_EQ(wheel.drain(pending), 3u);
+    for (auto& fn : pending) fn();
+    EXPECT_EQ(nRun, 3);
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_FALSE(wheel.next_expiry());
+}